@@ -2,18 +2,20 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
-#include <sys/stat.h>
+#include "aot.h"
 #include "chip8.h"
+#include "decode.h"
+#include "engine.h"
+#include "idle.h"
+#include "jit.h"
+#include "ops.h"
+#include "profile.h"
+#include "quirks.h"
+#include "trace.h"
 
 // This file is for recreating the Chip 8 system. It includes all "parts" and all of the opcode instructions.
 // It will get called through the main.c file
 
-#define debug_print(fmt, ...)                         \
-    do {                                              \
-        if (DEBUG) fprintf(stderr, fmt, __VA_ARGS__); \
-    } while (0)
-
 int DEBUG = 1;
 extern int errno;
 
@@ -37,82 +39,250 @@ unsigned char fontset[80] = {
         0xF0, 0x80, 0xF0, 0x80, 0x80   // F
 };
 
-//memory
-unsigned char memory[4096] = {0};
+// Initializing the CPU. Everything is zeroed, the PC starts at 0x200 and the font set is loaded into memory.
+// The random generator starts from CHIP8_DEFAULT_SEED, so two machines that see the same input do the same thing.
+void chip8_init(chip8_t* c) {
+    memset(c, 0, sizeof *c);
+    c->pc = 0x200;
+    c->planes = 1;
+    c->engine = CHIP8_ENGINE_THREADED;
+    chip8_seed(c, CHIP8_DEFAULT_SEED);
 
-/* -16 general purpose 8-bit registers, sometimes called Vx where "x" is a hexadecimal digit -
-   -A char is 8-bits, so we store 16 of them */
-unsigned char V[16] = {0};
+    // the table driven engines need the decode table, this only builds it the first time
+    chip8_decode_init();
+    chip8_icache_flush(c);
 
-// There is a special 16-bit register called I that is used to store memory addresses
-unsigned short I = 0;
+    // loading font set into memory
+    memcpy(c->memory, fontset, sizeof (fontset));
+}
 
-// The PC is the program counter which will point to the current instruction in memory. It is a pseudo-register and is 16 bits
-unsigned short pc = 0x200;
+void chip8_seed(chip8_t* c, uint64_t seed) {
+    // splitmix64 so that nearby seeds (0, 1, 2...) still start far apart, and xorshift never gets the all zero state
+    uint64_t z = seed + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
 
-// The stack pointer pseudo-register will point to the top of the stack. It is 8 bits
-unsigned char sp = 0;
+    c->rng = z ? z : 0x9E3779B97F4A7C15ULL;
+}
 
-// The stack: An array of 16 16-bit values, used to store the address that the interpreter should return when finished with a subroutine
-unsigned short stack[16] = {0};
+void chip8_display_unpack(const chip8_t* c, unsigned char* pixels) {
+    unsigned int width = chip8_display_width(c);
+    unsigned int height = chip8_display_height(c);
 
-// keypad
-unsigned char keypad[16] = {0};
+    for (unsigned int y = 0; y < height; y++)
+        for (unsigned int x = 0; x < width; x++)
+            pixels[y * width + x] = chip8_pixel(c, 0, x, y) | chip8_pixel(c, 1, x, y) << 1;
+}
 
-// Display: 64x32 monochrome display
-unsigned char display[64 * 32] = {0};
+void chip8_destroy(chip8_t* c) {
+    chip8_jit_free(c->jit);
+    c->jit = NULL;
+}
 
-// delay timer
-unsigned char delayTimer = 0;
+// Copies an already loaded rom image into memory at 0x200, handy when many machines run the same rom
+int chip8_load_rom_data(chip8_t* c, const unsigned char* data, size_t size) {
+    if (size > sizeof(c->memory) - 0x200) return -1;
 
-// Sound Timer
-unsigned char soundTimer = 0;
+    memcpy(c->memory + 0x200, data, size);
+    chip8_icache_flush(c);
 
-//update display flag
-unsigned char draw_flag = 0;
+    return 0;
+}
 
-// Play a sound flag
-unsigned char sound_flag = 0;
+int chip8_read_rom(const char* filename, unsigned char* data, size_t* size) {
+    FILE* fp = fopen(filename, "rb");
 
+    if (fp == NULL) return errno;
 
+    *size = fread(data, 1, CHIP8_MAX_ROM_SIZE, fp);
+    // anything left over doesn't fit, rather than running a rom with its end cut off
+    int too_big = *size == CHIP8_MAX_ROM_SIZE && fgetc(fp) != EOF;
+    int failed = ferror(fp);
 
-// Initializing the CPU. We will be loading the font set into memory
-void initialize_cpu(void) {
-    srand((unsigned int)time(NULL));
+    fclose(fp);
 
-    // loading font set into memory
-    memcpy(memory, fontset, sizeof (fontset));
+    if (failed) return EIO;
+    if (too_big) return -1;
+    return 0;
 }
 
-// Needs further studying tbh
-int load_rom(char * filename) {
-    FILE* fp = fopen(filename, "rb");
+int chip8_load_rom(chip8_t* c, const char* filename) {
+    unsigned char data[CHIP8_MAX_ROM_SIZE];
+    size_t size;
 
-    if (fp == NULL) return errno;
+    int status = chip8_read_rom(filename, data, &size);
+    if (status != 0) return status;
+
+    if (DEBUG) printf("bytes read: %zu\n", size);
+
+    return chip8_load_rom_data(c, data, size);
+}
+
+// Runs n instructions. draw_flag and sound_flag are cleared first, so afterwards they tell whether any of the n
+// instructions drew to the screen or had the sound timer running
+void chip8_step(chip8_t* c, unsigned long n) {
+    c->draw_flag = 0;
+    c->sound_flag = 0;
+
+    switch (c->engine) {
+        case CHIP8_ENGINE_TABLE:
+            chip8_run_table(c, n);
+            break;
+        case CHIP8_ENGINE_THREADED:
+            chip8_run_threaded(c, n);
+            break;
+        case CHIP8_ENGINE_CACHED:
+            chip8_run_cached(c, n);
+            break;
+        case CHIP8_ENGINE_JIT:
+            chip8_run_jit(c, n);
+            break;
+        case CHIP8_ENGINE_AOT:
+            chip8_run_aot(c, n);
+            break;
+        default:
+            chip8_run_switch(c, n);
+            break;
+    }
+}
 
-    struct stat st;
-    stat(filename, &st);
-    size_t fsize = st.st_size;
+void chip8_tick_timers(chip8_t* c) {
+    if (c->delayTimer > 0)
+        --c->delayTimer;
 
-    size_t bytes_read = fread(memory + 0x200, 1, sizeof(memory) - 0x200, fp);
+    if (c->soundTimer > 0) {
+        c->sound_flag = 1;
+        --c->soundTimer;
+    }
+}
 
-    printf("file size: %zu\nbytes read: %zu\n", fsize, bytes_read);
+unsigned long chip8_run_frame(chip8_t* c, unsigned long n) {
+    unsigned long run = chip8_idle_probe(c, n);
+
+    chip8_step(c, run);
+    chip8_tick_timers(c);
+    c->frame_count++;
+    return run;
+}
 
-    if (bytes_read != fsize) {
-        return -1;
+void chip8_icache_flush(chip8_t* c) {
+    for (int i = 0; i < 4096; i++)
+        c->icache[i].op = CHIP8_OP_COUNT;
+
+    if (c->jit)
+        chip8_jit_flush(c->jit);
+
+    // whatever got written may be (or no longer be) a rom there is a program for
+    chip8_aot_attach(c);
+}
+
+static const char* engine_names[CHIP8_ENGINE_COUNT] = {
+        "switch",
+        "table",
+        "threaded",
+        "cached",
+        "jit",
+        "aot"
+};
+
+const char* chip8_engine_name(chip8_engine_t engine) {
+    return engine < CHIP8_ENGINE_COUNT ? engine_names[engine] : "?";
+}
+
+int chip8_engine_from_name(const char* name) {
+    for (int i = 0; i < CHIP8_ENGINE_COUNT; i++) {
+        if (strcmp(name, engine_names[i]) == 0)
+            return i;
     }
+    return -1;
+}
 
-    fclose(fp);
+// FNV-1a over everything that makes up the machine state. Fields are hashed one by one so struct padding never
+// leaks into the result
+static unsigned long long fnv1a(unsigned long long h, const void* data, size_t size) {
+    const unsigned char* p = data;
+    for (size_t i = 0; i < size; i++) {
+        h ^= p[i];
+        h *= 0x100000001B3ULL;
+    }
+    return h;
+}
+
+static int uses_extended_display(const chip8_t* c) {
+    if (c->hires || c->planes != 1)
+        return 1;
 
+    const uint64_t* words = &c->display[0][0][0];
+    for (size_t i = 32; i < sizeof c->display / sizeof *words; i++)
+        if (words[i])
+            return 1;
     return 0;
 }
 
-void emulate_cycle(void) {
-    draw_flag = 0;
-    sound_flag = 0;
+unsigned long long chip8_state_hash(const chip8_t* c) {
+    unsigned long long h = 0xCBF29CE484222325ULL;
+
+    h = fnv1a(h, c->memory, sizeof c->memory);
+    h = fnv1a(h, c->V, sizeof c->V);
+    h = fnv1a(h, &c->I, sizeof c->I);
+    h = fnv1a(h, &c->pc, sizeof c->pc);
+    h = fnv1a(h, &c->sp, sizeof c->sp);
+    h = fnv1a(h, c->stack, sizeof c->stack);
+    // the lo-res screen first, where the whole display used to be, so plain CHIP-8 hashes stay what they were
+    h = fnv1a(h, c->display[0][0], 32 * sizeof c->display[0][0][0]);
+    h = fnv1a(h, &c->delayTimer, sizeof c->delayTimer);
+    h = fnv1a(h, &c->soundTimer, sizeof c->soundTimer);
+    h = fnv1a(h, &c->rng, sizeof c->rng);
+    // the VIP timing carry, only there when it is running (timing.h), so other hashes stay what they were
+    if (c->cycles != 0)
+        h = fnv1a(h, &c->cycles, sizeof c->cycles);
+
+    // and the rest only once hi-res or the second plane got used
+    if (uses_extended_display(c)) {
+        h = fnv1a(h, &c->hires, sizeof c->hires);
+        h = fnv1a(h, &c->planes, sizeof c->planes);
+        h = fnv1a(h, c->display, sizeof c->display);
+    }
+
+    return h;
+}
+
+// Moves the selected planes dx pixels right and dy pixels down (negative goes the other way), a pixel at a time.
+// What scrolls in is blank, what scrolls off is gone.
+static void scroll_display(chip8_t* c, int dx, int dy) {
+    int width = chip8_display_width(c);
+    int height = chip8_display_height(c);
+
+    for (int plane = 0; plane < CHIP8_PLANES; plane++) {
+        if (!(c->planes & (1 << plane)))
+            continue;
+
+        uint64_t before[2][CHIP8_MAX_HEIGHT];
+        memcpy(before, c->display[plane], sizeof before);
+        memset(c->display[plane], 0, sizeof c->display[plane]);
+
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                int fromX = x - dx;
+                int fromY = y - dy;
+                if (fromX < 0 || fromX >= width || fromY < 0 || fromY >= height)
+                    continue;
+                if (before[fromX / 64][fromY] & CHIP8_PIXEL_MASK(fromX))
+                    c->display[plane][x / 64][y] |= CHIP8_PIXEL_MASK(x);
+            }
+        }
+    }
+    c->dirty_rows = UINT64_MAX;
+    c->draw_flag = 1;
+}
 
-    // fetching the opcode
-    unsigned short opcode = memory[pc] << 8 | memory[pc + 1];
+void emulate_cycle(chip8_t* c) {
+    // fetching the opcode. Like on the VIP the address wraps at 4K, a pc BNNN took past 0xFFF runs from the bottom
+    unsigned short opcode = c->memory[c->pc & 0xFFF] << 8 | c->memory[(c->pc + 1) & 0xFFF];
+#ifdef CHIP8_HOOK_PC
+    unsigned short op_pc = c->pc;
+#endif
 
     // increment the PC before execution
     //pc += 2;
@@ -123,6 +293,9 @@ void emulate_cycle(void) {
     // Vy  register
     unsigned short y = (opcode & 0x00F0) >> 4;
 
+    // the few instructions that differ between platforms check these (see quirks.h)
+    unsigned int quirks = chip8_platform_quirks[c->platform];
+
     // For summing registers on case 0x8000:0x4000
     //unsigned short sum = 0;
 
@@ -137,156 +310,171 @@ void emulate_cycle(void) {
         case 0x0000:
             switch(opcode & 0x00FF) {
                 case 0x00E0:
-                    // clear screen
-                    debug_print("[OK] 0x%X: 00E0\n", opcode);
-                    memset(display, 0, sizeof display);
-                    pc += 2;
+                    // clear screen, the selected planes of it
+                    for (int plane = 0; plane < CHIP8_PLANES; plane++)
+                        if (c->planes & (1 << plane))
+                            memset(c->display[plane], 0, sizeof c->display[plane]);
+                    c->dirty_rows = UINT64_MAX;
+                    c->pc += 2;
                     break;
                 case 0x00EE:
                     // return from subroutine
-                    debug_print("[OK] 0x%X: 00EE\n", opcode);
-                    pc = stack[sp];
-                    sp--;
-                    pc += 2;
+                    c->pc = c->stack[c->sp];
+                    c->sp = (c->sp - 1) & 0xF;
+                    c->pc += 2;
+                    break;
+                case 0x00FB:
+                    // SUPER-CHIP: scroll right 4 pixels
+                    scroll_display(c, 4, 0);
+                    c->pc += 2;
+                    break;
+                case 0x00FC:
+                    // SUPER-CHIP: scroll left 4 pixels
+                    scroll_display(c, -4, 0);
+                    c->pc += 2;
+                    break;
+                case 0x00FE:
+                case 0x00FF:
+                    // SUPER-CHIP: lo-res / hi-res. Switching clears the screen, all planes of it
+                    c->hires = opcode & 1;
+                    memset(c->display, 0, sizeof c->display);
+                    c->dirty_rows = UINT64_MAX;
+                    c->draw_flag = 1;
+                    c->pc += 2;
                     break;
                 default:
-                    debug_print("[FAILED] Unknown opcode: 0x%X\n", opcode);
+                    if ((opcode & 0x00F0) == 0x00C0 || (opcode & 0x00F0) == 0x00D0) {
+                        // SUPER-CHIP 00CN: scroll down N rows, XO-CHIP 00DN: scroll up N rows
+                        int rows = opcode & 0x000F;
+                        scroll_display(c, 0, (opcode & 0x00F0) == 0x00C0 ? rows : -rows);
+                        c->pc += 2;
+                        break;
+                    }
+                    printf("[FAILED] Unknown opcode: 0x%X\n", opcode);
                     break;
             }
             break;
         case 0x1000:
             // 1NNN jump to location nnn.
-            debug_print("[OK] 0x%X: 1NNN\n", opcode);
-            pc = opcode & 0x0FFF;
+            c->pc = opcode & 0x0FFF;
             break;
         case 0x2000:
             // 2NNN: call subroutine at nnn.
-            debug_print("[OK] 0x%X: 2NNN\n", opcode);
-            ++sp;
-            stack[sp] = pc;
-            pc = opcode & 0x0FFF;
+            // the stack wraps instead of running off the end of stack[] into the rest of the machine
+            c->sp = (c->sp + 1) & 0xF;
+            c->stack[c->sp] = c->pc;
+            c->pc = opcode & 0x0FFF;
             break;
         case 0x3000:
             // Skip next instruction if Vx = kk.
-            debug_print("[OK] 0x%X: 3XNN\n", opcode);
-
-            if (V[x] == (opcode & 0x00FF)) {
-                pc += 2;
+            if (c->V[x] == (opcode & 0x00FF)) {
+                c->pc += 2;
             }
-            pc += 2;
+            c->pc += 2;
             break;
         case 0x4000:
             // 4xkk - SNE Vx, byte
             // skip next instruction if Vx != kk.
-            debug_print("[OK] 0x%X: 4XNN\n", opcode);
-
-            if (V[x] != (opcode & 0x00FF)) {
-                pc += 2;
+            if (c->V[x] != (opcode & 0x00FF)) {
+                c->pc += 2;
             }
-            pc += 2;
+            c->pc += 2;
             break;
         case 0x5000:
             // 5xy0 - SE Vx, Vy
             // skip next instruction if Vx = Vy
-            debug_print("[OK] 0x%X: 5XY0\n", opcode);
-
-            if (V[x] == V[y]) {
-                pc += 2;
+            if (c->V[x] == c->V[y]) {
+                c->pc += 2;
             }
-            pc += 2;
+            c->pc += 2;
             break;
         case 0x6000:
             // 6xkk - LD Vx, byte
             // set Vx = kk
-            debug_print("[OK] 0x%X: 6XNN\n", opcode);
-            V[x] = opcode & 0x00FF;
-            pc += 2;
+            c->V[x] = opcode & 0x00FF;
+            c->pc += 2;
             break;
         case 0x7000:
-            debug_print("[OK] 0x%X: 7XNN\n", opcode);
-            V[x] += opcode & 0x00FF;
-            pc += 2;
+            c->V[x] += opcode & 0x00FF;
+            c->pc += 2;
             break;
 
         case 0x8000:
             //adding nested switch for cases 8xy0-E
             switch(opcode & 0x000F) {
                 case 0x0000:
-                    debug_print("[OK] 0x%X: 8XY0\n", opcode);
                     // set Vx = Vy
-                    V[x] = V[y];
-                    pc += 2;
+                    c->V[x] = c->V[y];
+                    c->pc += 2;
                     break;
                 case 0x0001:
                     // Set Vx = Vx OR Vy
-                    debug_print("[OK] 0x%X: 8XY1\n", opcode);
-                    V[x] |= V[y];
-                    pc += 2;
+                    c->V[x] |= c->V[y];
+                    if (quirks & CHIP8_QUIRK_VF_RESET)
+                        c->V[0xF] = 0;
+                    c->pc += 2;
                     break;
                 case 0x0002:
                     // Set Vx = Vx AND Vy
-                    debug_print("[OK] 0x%X: 8XY2\n", opcode);
-                    V[x] &= V[y];
-                    pc += 2;
+                    c->V[x] &= c->V[y];
+                    if (quirks & CHIP8_QUIRK_VF_RESET)
+                        c->V[0xF] = 0;
+                    c->pc += 2;
                     break;
                 case 0x0003:
                     // Set Vx = Vx XOR Vy
-                    debug_print("[OK] 0x%X: 8XY3\n", opcode);
-                    V[x] ^= V[y];
-                    pc += 2;
+                    c->V[x] ^= c->V[y];
+                    if (quirks & CHIP8_QUIRK_VF_RESET)
+                        c->V[0xF] = 0;
+                    c->pc += 2;
                     break;
                 case 0x0004:
                     // set Vx = Vx + Vy and VF = carry
                     //The values of Vx and Vy are added together. If the result is greater than 8 bits (i.e., > 255,) VF is set to 1,
                     // otherwise 0. Only the lowest 8 bits of the result are kept, and stored in Vx.
-                    debug_print("[OK] 0x%X: 8XY4\n", opcode);
-
-                    if ((V[x] + V[y]) > 0xFF)
-                        V[0xF] = 1;
+                    if ((c->V[x] + c->V[y]) > 0xFF)
+                        c->V[0xF] = 1;
                     else
-                        V[0xF] = 0;
-                    V[x] += V[y];
+                        c->V[0xF] = 0;
+                    c->V[x] += c->V[y];
 
-                    pc += 2;
+                    c->pc += 2;
                     break;
                 case 0x0005:
                     //8xy5 - SUB Vx, Vy
                     //Set Vx = Vx - Vy, set VF = NOT borrow.
                     //If Vx > Vy, then VF is set to 1, otherwise 0. Then Vy is subtracted from Vx, and the results stored in Vx.
-                    debug_print("[OK] 0x%X: 8XY5\n", opcode);
-
-                    if (V[x] > V[y])
-                        V[0xF] = 1;
+                    if (c->V[x] > c->V[y])
+                        c->V[0xF] = 1;
                     else
-                        V[0xF] = 0;
+                        c->V[0xF] = 0;
 
-                    V[x] -= V[y];
-                    pc += 2;
+                    c->V[x] -= c->V[y];
+                    c->pc += 2;
                     break;
                 case 0x0006:
                     //8xy6 - SHR Vx {, Vy}
                     //Set Vx = Vx SHR 1.
                     //If the least-significant bit of Vx is 1, then VF is set to 1, otherwise 0. Then Vx is divided by 2.
-                    debug_print("[OK] 0x%X: 8XY6\n", opcode);
-
-                    V[0xF] = V[x] & 0x1;
-                    V[x] = V[x] >> 1;
+                    // the VIP shifts Vy into Vx
+                    if (quirks & CHIP8_QUIRK_SHIFT_VY)
+                        c->V[x] = c->V[y];
+                    c->V[0xF] = c->V[x] & 0x1;
+                    c->V[x] = c->V[x] >> 1;
 
-                    pc += 2;
+                    c->pc += 2;
                     break;
                 case 0x0007:
                     //8xy7 - SUBN Vx, Vy
                     //Set Vx = Vy - Vx, set VF = NOT borrow.
                     //If Vy > Vx, then VF is set to 1, otherwise 0. Then Vx is subtracted from Vy, and the results stored in Vx.
-                    debug_print("[OK] 0x%X: 8XY7\n", opcode);
-
-                    if (V[y] > V[x])
-                        V[0xF] = 1;
+                    if (c->V[y] > c->V[x])
+                        c->V[0xF] = 1;
                     else
-                        V[0xF] = 0;
-                    V[x] = V[y] - V[x];
+                        c->V[0xF] = 0;
+                    c->V[x] = c->V[y] - c->V[x];
 
-                    pc += 2;
+                    c->pc += 2;
                     break;
                 case 0x000E:
                     //8xyE - SHL Vx {, Vy}
@@ -295,11 +483,11 @@ void emulate_cycle(void) {
 
                     // Upon research it seems as though this instruction is outdated and for emulation something different is required
                     // I assigned the MSB into the VF register and shifted Vx left 1 which is the equivalent of multiplication by 2
-                    debug_print("[OK] 0x%X: 8XYE\n", opcode);
-
-                    V[0xF] = (V[x] >> 7) & 0x1;
-                    V[x] <<= 1;
-                    pc += 2;
+                    if (quirks & CHIP8_QUIRK_SHIFT_VY)
+                        c->V[x] = c->V[y];
+                    c->V[0xF] = (c->V[x] >> 7) & 0x1;
+                    c->V[x] <<= 1;
+                    c->pc += 2;
                     break;
                 default:
                     printf("[FAILED] Unknown op: 0x%X\n", opcode);
@@ -310,37 +498,31 @@ void emulate_cycle(void) {
                 case 0x9000:
                     //Skip next instruction if Vx != Vy.
                     //The values of Vx and Vy are compared, and if they are not equal, the program counter is increased by 2.
-                    debug_print("[OK] 0x%X: 9XY0\n", opcode);
-
-                    if (V[x] != V[y])
-                        pc += 2;
-                    pc += 2;
+                    if (c->V[x] != c->V[y])
+                        c->pc += 2;
+                    c->pc += 2;
                     break;
                 case 0xA000:
                     //Annn - LD I, addr
                     //Set I = nnn.
                     //The value of register I is set to nnn.
-                    debug_print("[OK] 0x%X: ANNN\n", opcode);
-
-                    I = opcode & 0x0FFF;
-                    pc += 2;
+                    c->I = opcode & 0x0FFF;
+                    c->pc += 2;
                     break;
                 case 0xB000:
                     //Bnnn - JP V0, addr
                     //Jump to location nnn + V0.
                     //The program counter is set to nnn plus the value of V0.
-                    debug_print("[OK] 0x%X: BNNN\n", opcode);
-
-                    pc = V[0] + (opcode & 0x0FFF);
+                    //CHIP-48 and SUPER-CHIP got this wrong, BXNN jumps to XNN + Vx
+                    c->pc = c->V[quirks & CHIP8_QUIRK_JUMP_VX ? x : 0] + (opcode & 0x0FFF);
                     break;
                 case 0xC000:
                     //Cxkk - RND Vx, byte
                     //Set Vx = random byte AND kk.
                     //The interpreter generates a random number from 0 to 255, which is then ANDed with the value kk.
                     // The results are stored in Vx.
-                    debug_print("[OK] 0x%X: CXNN\n", opcode);
-                    V[x] = (rand() % 256) & (opcode & 0x00FF);
-                    pc += 2;
+                    c->V[x] = chip8_rand(c) & (opcode & 0x00FF);
+                    c->pc += 2;
                     break;
                 case 0xD000:
                 {
@@ -353,39 +535,64 @@ void emulate_cycle(void) {
                        outside the coordinates of the display, it wraps around to the opposite side of the screen.
                        See instruction 8xy3 for more information on XOR, and section 2.4, Display, for more information on
                        the Chip-8 screen and sprites. */
-                    debug_print("[OK] 0x%X: DXYN\n", opcode);
-
                     unsigned short height = opcode & 0x000F;
                     unsigned short pixel;
 
-                    unsigned int xCoord = V[x] % 64;
-                    unsigned int yCoords = V[y] % 32;
+                    // SUPER-CHIP: DXY0 draws a 16x16 sprite, two bytes a row
+                    unsigned int rows = height ? height : 16;
+                    unsigned int cols = height ? 8 : 16;
+                    unsigned int screenWidth = chip8_display_width(c);
+                    unsigned int screenHeight = chip8_display_height(c);
+                    unsigned int xCoord = c->V[x] % screenWidth;
+                    unsigned int yCoords = c->V[y] % screenHeight;
+                    unsigned int spriteAddr = c->I;
 
                     // setting collision flag to 0
-                    V[0xF] = 0;
-
-                    // iterating over n rows
-                    for (int yline = 0; yline < height; yline++) {
-                        // getting pixel value for memory location starting at I
-                        pixel = memory[I + yline];
-
-                        // for each of the 8 pixels in this sprite row
-                        for (int xline = 0; xline < 8; xline++) {
-
-                            unsigned int spritePixel = pixel & (0x80 >> xline);
-                            unsigned char* screenPixel = &display[(yCoords + yline) * 64 + (xCoord + xline)];
+                    c->V[0xF] = 0;
+
+                    // XO-CHIP: every selected plane gets a sprite of its own, they follow each other in memory
+                    for (int plane = 0; plane < CHIP8_PLANES; plane++) {
+                        if (!(c->planes & (1 << plane)))
+                            continue;
+
+                        // iterating over n rows
+                        for (unsigned int yline = 0; yline < rows; yline++) {
+                            // clipping stops at the bottom instead of wrapping around to the top
+                            if ((quirks & CHIP8_QUIRK_CLIP) && yCoords + yline >= screenHeight)
+                                break;
+
+                            // getting pixel value for memory location starting at I, wrapping round at the end of memory
+                            if (cols == 8)
+                                pixel = c->memory[(spriteAddr + yline) & 0xFFF];
+                            else
+                                pixel = c->memory[(spriteAddr + 2 * yline) & 0xFFF] << 8 |
+                                        c->memory[(spriteAddr + 2 * yline + 1) & 0xFFF];
+                            c->dirty_rows |= 1ULL << ((yCoords + yline) % screenHeight);
+
+                            // for each of the pixels in this sprite row. This stays a pixel at a time on purpose, it is
+                            // what the word-wide versions in ops.h and display.c get checked against
+                            for (unsigned int xline = 0; xline < cols; xline++) {
+
+                                unsigned int spritePixel = pixel & ((1u << (cols - 1)) >> xline);
+                                unsigned int screenX = (xCoord + xline) % screenWidth;
+                                unsigned int screenY = (yCoords + yline) % screenHeight;
+
+                                if ((quirks & CHIP8_QUIRK_CLIP) && xCoord + xline >= screenWidth)
+                                    break;
 
-                            if (spritePixel != 0) {
-                                if (*screenPixel == 1) {
-                                    V[0xF] = 1;
+                                if (spritePixel != 0) {
+                                    if (chip8_pixel(c, plane, screenX, screenY)) {
+                                        c->V[0xF] = 1;
+                                    }
+                                    // set the pixel value using a XOR
+                                    c->display[plane][screenX / 64][screenY] ^= CHIP8_PIXEL_MASK(screenX);
                                 }
-                                // set the pixel value using a XOR
-                                *screenPixel ^= 0xFFFFFFFF;
                             }
                         }
+                        spriteAddr += rows * cols / 8;
                     }
-                    draw_flag = 1;
-                    pc += 2;
+                    c->draw_flag = 1;
+                    c->pc += 2;
                 }
                     break;
 
@@ -395,22 +602,19 @@ void emulate_cycle(void) {
                             //Ex9E - SKP Vx
                             //Skip next instruction if key with the value of Vx is pressed.
                             //Checks the keyboard, and if the key corresponding to the value of Vx is currently in the down position, PC is increased by 2.
-                            debug_print("[OK] 0x%X: EX9E\n", opcode);
-
-                            if (keypad[V[x]]) {
-                                pc += 2;
+                            //Only the low nibble of Vx picks the key, so values above F don't read past the keypad.
+                            if (c->keypad[c->V[x] & 0xF]) {
+                                c->pc += 2;
                             }
-                            pc += 2;
+                            c->pc += 2;
                             break;
                         case 0x0A1:
                             //ExA1 - SKNP Vx
                             //Skip next instruction if key with the value of Vx is not pressed.
                             //Checks the keyboard, and if the key corresponding to the value of Vx is currently in the up position, PC is increased by 2.
-                            debug_print("[OK] 0x%X: EXA1\n", opcode);
-
-                            if (!keypad[V[x]])
-                                pc += 2;
-                            pc += 2;
+                            if (!c->keypad[c->V[x] & 0xF])
+                                c->pc += 2;
+                            c->pc += 2;
                             break;
                         default:
                             printf("[FAILED] Unknown op: 0x%X", opcode);
@@ -421,25 +625,28 @@ void emulate_cycle(void) {
                 case 0xF000:
                     switch(opcode & 0x00FF)
                     {
+                        case 0x0001:
+                            //XO-CHIP FN01 - PLANE N
+                            //Select the bit planes drawing, clearing and scrolling work on.
+                            c->planes = x & 3;
+                            c->pc += 2;
+                            break;
                         case 0x0007:
                             //Fx07 - LD Vx, DT
                             //Set Vx = delay timer value.
                             //The value of DT is placed into Vx.
-                            debug_print("[OK] 0x%X: FX07\n", opcode);
-                            V[x] = delayTimer;
+                            c->V[x] = c->delayTimer;
 
-                            pc += 2;
+                            c->pc += 2;
                             break;
                         case 0x000A:
                             //Fx0A - LD Vx, K
                             //Wait for a key press, store the value of the key in Vx.
                             //All execution stops until a key is pressed, then the value of that key is stored in Vx.
-                            debug_print("[OK] 0x%X: FX0A\n", opcode);
-
                             for (int i = 0; i < 16; i++) {
-                                if (keypad[i]) {
-                                    V[x] = i;
-                                    pc += 2;
+                                if (c->keypad[i]) {
+                                    c->V[x] = i;
+                                    c->pc += 2;
                                     break;
                                 }
                             }
@@ -448,67 +655,67 @@ void emulate_cycle(void) {
                             //Fx15 - LD DT, Vx
                             //Set delay timer = Vx.
                             //DT is set equal to the value of Vx.
-                            debug_print("[OK] 0x%X: FX15\n", opcode);
-                            delayTimer = V[x];
-                            pc += 2;
+                            c->delayTimer = c->V[x];
+                            c->pc += 2;
                             break;
                         case 0x0018:
                             //Fx18 - LD ST, Vx
                             //Set sound timer = Vx.
                             //ST is set equal to the value of Vx.
-                            debug_print("[OK] 0x%X: FX18\n", opcode);
-                            soundTimer = V[x];
-                            pc += 2;
+                            c->soundTimer = c->V[x];
+                            c->pc += 2;
                             break;
                         case 0x001E:
                             //Fx1E - ADD I, Vx
                             //Set I = I + Vx.
                             //The values of I and Vx are added, and the results are stored in I.
-                            debug_print("[OK] 0x%X: FX1E\n", opcode);
-                            I = I + V[x];
-                            pc += 2;
+                            c->I = c->I + c->V[x];
+                            c->pc += 2;
                             break;
                         case 0x0029:
                             //Fx29 - LD F, Vx
                             //Set I = location of sprite for digit Vx.
                             //The value of I is set to the location for the hexadecimal sprite corresponding to the value of Vx.
-                            debug_print("[OK] 0x%X: FX29\n", opcode);
-                            I = V[x] * 5;
-                            pc += 2;
+                            c->I = c->V[x] * 5;
+                            c->pc += 2;
                             break;
                         case 0x0033:
                             //Fx33 - LD B, Vx
                             //Store BCD representation of Vx in memory locations I, I+1, and I+2.
                             //The interpreter takes the decimal value of Vx, and places the hundreds digit in memory at location in I,
                             // the tens digit at location I+1, and the ones digit at location I+2.
-                            debug_print("[OK] 0x%X: FX33\n", opcode);
+                            c->memory[c->I & 0xFFF] = (c->V[x] % 1000) / 100; // getting hundreds place
+                            c->memory[(c->I + 1) & 0xFFF] = (c->V[x] % 100) / 10; // getting the tens place
+                            c->memory[(c->I + 2) & 0xFFF] = c->V[x] % 10; // getting the ones place
+                            chip8_icache_invalidate(c, c->I, 3);
 
-                            memory[I] = (V[x] % 1000) / 100; // getting hundreds place
-                            memory[I + 1] = (V[x] % 100) / 10; // getting the tens place
-                            memory[I + 2] = V[x] % 10; // getting the ones place
-
-                            pc += 2;
+                            c->pc += 2;
                             break;
                         case 0x0055:
                             //Fx55 - LD [I], Vx
                             //Store registers V0 through Vx in memory starting at location I.
                             //The interpreter copies the values of registers V0 through Vx into memory, starting at the address in I.
-                            debug_print("[OK] 0x%X: FX55\n", opcode);
-
                             for (int i = 0; i <= x; i++)
-                                memory[I + i] = V[i];
-                            pc += 2;
+                                c->memory[(c->I + i) & 0xFFF] = c->V[i];
+                            chip8_icache_invalidate(c, c->I, x + 1);
+                            if (quirks & CHIP8_QUIRK_MEM_INC_X1)
+                                c->I = (c->I + x + 1) & 0xFFF;
+                            else if (quirks & CHIP8_QUIRK_MEM_INC_X)
+                                c->I = (c->I + x) & 0xFFF;
+                            c->pc += 2;
                             break;
                         case 0x0065:
                             //Fx65 - LD Vx, [I]
                             //Read registers V0 through Vx from memory starting at location I.
                             //The interpreter reads values from memory starting at location I into registers V0 through Vx.
-                            debug_print("[OK] 0x%X: FX65\n", opcode);
-
                             for (int i = 0; i<= x; i++)
-                                V[i] = memory[I + i];
+                                c->V[i] = c->memory[(c->I + i) & 0xFFF];
+                            if (quirks & CHIP8_QUIRK_MEM_INC_X1)
+                                c->I = (c->I + x + 1) & 0xFFF;
+                            else if (quirks & CHIP8_QUIRK_MEM_INC_X)
+                                c->I = (c->I + x) & 0xFFF;
 
-                            pc += 2;
+                            c->pc += 2;
                             break;
 
                     default:
@@ -519,13 +726,6 @@ void emulate_cycle(void) {
         break;
     }
 
-    // updating delay timer and sound timer
-    if (delayTimer > 0)
-        --delayTimer;
-
-    if (soundTimer > 0 ) {
-        sound_flag = 1;
-        printf("BEEP!\n");
-        --soundTimer;
-    }
+    chip8_trace_op(c, op_pc, opcode);
+    chip8_profile_op(c, op_pc, opcode);
 }
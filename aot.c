@@ -0,0 +1,58 @@
+#include "aot.h"
+#include "engine.h"
+
+static int is_code(const chip8_aot_program_t* p, unsigned int addr) {
+    return (p->code[addr / 8] >> (addr % 8)) & 1;
+}
+
+// Whether every translated byte still holds what it was translated from
+static int code_intact(const chip8_t* c, const chip8_aot_program_t* p) {
+    for (size_t i = 0; i < p->size; i++)
+        if (is_code(p, 0x200 + i) && c->memory[0x200 + i] != p->image[i])
+            return 0;
+    return 1;
+}
+
+// A program fits the machine when its code is in memory, whatever the data around it looks like by now (games
+// keep scores and such in their own image)
+void chip8_aot_attach(chip8_t* c) {
+    c->aot = NULL;
+    c->aot_valid = 0;
+
+    for (const chip8_aot_program_t* const* p = chip8_aot_programs; *p; p++) {
+        if ((*p)->platform == c->platform && code_intact(c, *p)) {
+            c->aot = *p;
+            c->aot_valid = 1;
+            return;
+        }
+    }
+}
+
+void chip8_aot_check(chip8_t* c, unsigned int addr, unsigned int len) {
+    const chip8_aot_program_t* p = c->aot;
+
+    // self-modifying code is rare, a write that misses the code costs one bit test per byte
+    for (unsigned int i = 0; i < len; i++) {
+        if (is_code(p, (addr + i) & 0xFFF)) {
+            c->aot_valid = code_intact(c, p);
+            return;
+        }
+    }
+}
+
+void chip8_run_aot(chip8_t* c, unsigned long n) {
+#ifndef CHIP8_HOOK_PC
+    while (n && c->aot && c->aot_valid) {
+        n = c->aot->run(c, n);
+        if (n == 0)
+            return;
+
+        // the pc left translated code (or the code under it was overwritten): one instruction on the interpreter,
+        // then see whether it is back
+        chip8_run_cached(c, 1);
+        n--;
+    }
+#endif
+    // the generated code has no per-instruction hooks, so tracing and profiling builds stay on the interpreter
+    chip8_run_cached(c, n);
+}
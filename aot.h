@@ -0,0 +1,53 @@
+//
+// Ahead-of-time recompiled roms. chip8-aot (recompiler.c) translates everything reachable from 0x200 into one C
+// function per rom; roms listed in CHIP8_AOT_ROMS at configure time are recompiled and built into libchip8. A
+// machine that loads one of them gets its program attached, and the aot engine runs it natively. Whatever the
+// translation doesn't cover (code reached through RET or BNNN targets it didn't find, code in RAM, code the rom
+// overwrote) runs on the cached engine, an instruction at a time, until the pc is back in translated code.
+//
+
+#ifndef CHIP8_EMU_AOT_H
+#define CHIP8_EMU_AOT_H
+
+#include <stddef.h>
+
+#include "chip8.h"
+
+typedef struct chip8_aot_program {
+    const char* name;
+    // the rom it was translated from, as loaded at 0x200
+    const unsigned char* image;
+    size_t size;
+    // bit a (code[a / 8] >> a % 8) is set when memory byte a is part of a translated instruction
+    const unsigned char* code;
+    // Runs up to n instructions, returns how many of them are left when the pc leaves translated code
+    unsigned long (*run)(chip8_t* chip8, unsigned long n);
+    // the platform it was translated for (a chip8_platform_t), it only attaches to machines running that one
+    unsigned char platform;
+} chip8_aot_program_t;
+
+// Every program built in, NULL terminated (aot_programs.c, generated by cmake)
+extern const chip8_aot_program_t* const chip8_aot_programs[];
+
+// Generated code: starts the instruction at addr. Stops when the budget is used up, and keeps the pc in step so
+// the op bodies from ops.h work unchanged (the compiler folds the store into theirs).
+#define CHIP8_AOT_INSN(addr)        \
+    do {                            \
+        c->pc = (addr);             \
+        if (n == 0)                 \
+            return 0;               \
+        n--;                        \
+    } while (0)
+
+// Looks for a built in program whose code is in memory and whose platform is the machine's, and attaches it (or
+// detaches, if there is none)
+void chip8_aot_attach(chip8_t* chip8);
+
+// The guest wrote len bytes at addr: if that touched translated code, the program is only used while the code
+// is back to what it was translated from
+void chip8_aot_check(chip8_t* chip8, unsigned int addr, unsigned int len);
+
+// Runs n instructions on the attached program, the cached engine where there is none
+void chip8_run_aot(chip8_t* chip8, unsigned long n);
+
+#endif //CHIP8_EMU_AOT_H
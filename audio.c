@@ -0,0 +1,69 @@
+#include <string.h>
+
+#include "audio.h"
+#include "chip8.h"
+
+void chip8_audio_init(chip8_audio_t* a, unsigned int rate, int null_sink) {
+    memset(a->ring, 0, sizeof a->ring);
+    atomic_init(&a->head, 0);
+    atomic_init(&a->tail, 0);
+    a->rate = rate ? rate : CHIP8_AUDIO_RATE;
+    a->null_sink = null_sink;
+    a->frame = 0;
+    a->phase = 0;
+    atomic_init(&a->overruns, 0);
+    atomic_init(&a->underruns, 0);
+}
+
+void chip8_audio_frame(chip8_audio_t* a, int on) {
+    // rate / 60 isn't always whole, so some frames get one sample more, adding up to exactly rate a second
+    unsigned long long f = a->frame % CHIP8_FRAME_HZ;
+    size_t n = (size_t)((f + 1) * a->rate / CHIP8_FRAME_HZ - f * a->rate / CHIP8_FRAME_HZ);
+    a->frame++;
+
+    if (a->null_sink)
+        return;
+
+    size_t head = atomic_load_explicit(&a->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&a->tail, memory_order_acquire);
+    size_t room = CHIP8_AUDIO_RING - (head - tail);
+    if (n > room) {
+        atomic_fetch_add_explicit(&a->overruns, n - room, memory_order_relaxed);
+        n = room;
+    }
+
+    // half a period high, half low
+    unsigned long long half = a->rate / (2 * CHIP8_AUDIO_TONE_HZ);
+    for (size_t i = 0; i < n; i++) {
+        int16_t sample = 0;
+        if (on) {
+            sample = (a->phase / half) & 1 ? -CHIP8_AUDIO_VOLUME : CHIP8_AUDIO_VOLUME;
+            a->phase++;
+        }
+        a->ring[(head + i) & (CHIP8_AUDIO_RING - 1)] = sample;
+    }
+    // a silent frame restarts the wave, so every beep starts the same way
+    if (!on)
+        a->phase = 0;
+
+    // release: the consumer that sees the new head sees the samples
+    atomic_store_explicit(&a->head, head + n, memory_order_release);
+}
+
+void chip8_audio_pull(chip8_audio_t* a, int16_t* out, size_t n) {
+    size_t tail = atomic_load_explicit(&a->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&a->head, memory_order_acquire);
+    size_t have = head - tail;
+    if (have > n)
+        have = n;
+
+    for (size_t i = 0; i < have; i++)
+        out[i] = a->ring[(tail + i) & (CHIP8_AUDIO_RING - 1)];
+    if (have < n) {
+        memset(out + have, 0, (n - have) * sizeof *out);
+        atomic_fetch_add_explicit(&a->underruns, n - have, memory_order_relaxed);
+    }
+
+    // release: the producer only reuses the slots once they're read
+    atomic_store_explicit(&a->tail, tail + have, memory_order_release);
+}
@@ -0,0 +1,49 @@
+//
+// Sound: a square wave while the sound timer runs. The emulation thread synthesizes one 60 Hz frame of samples at
+// a time into a single producer / single consumer ring, and whatever plays them (the SDL audio callback) pulls
+// them out on its own thread. Neither side locks or waits: a full ring drops the new samples, an empty one plays
+// silence. Without a device the null sink throws every frame away as soon as it is made.
+//
+
+#ifndef CHIP8_EMU_AUDIO_H
+#define CHIP8_EMU_AUDIO_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CHIP8_AUDIO_RATE 48000
+#define CHIP8_AUDIO_TONE_HZ 440
+#define CHIP8_AUDIO_VOLUME 3000
+// ring size in samples, a power of two. 4096 is a bit over 5 frames at 48 kHz, the most sound can lag behind.
+#define CHIP8_AUDIO_RING 4096
+
+typedef struct chip8_audio {
+    int16_t ring[CHIP8_AUDIO_RING];
+    // free running sample counts, head only written by the producer and tail only by the consumer
+    atomic_size_t head;
+    atomic_size_t tail;
+
+    unsigned int rate;
+    int null_sink;
+
+    // producer side: frames synthesized (spreads rate over 60 frames like the scheduler does ips) and where in
+    // the square wave the last one stopped, so the tone doesn't click between frames
+    unsigned long long frame;
+    unsigned long long phase;
+
+    // samples dropped because the ring was full / padded with silence because it was empty
+    atomic_ulong overruns;
+    atomic_ulong underruns;
+} chip8_audio_t;
+
+// rate 0 means CHIP8_AUDIO_RATE. With null_sink set nothing is kept for a consumer.
+void chip8_audio_init(chip8_audio_t* audio, unsigned int rate, int null_sink);
+
+// Producer: one 60 Hz frame of samples, the tone if on, silence otherwise
+void chip8_audio_frame(chip8_audio_t* audio, int on);
+
+// Consumer: fills out with n samples, silence where the ring runs dry
+void chip8_audio_pull(chip8_audio_t* audio, int16_t* out, size_t n);
+
+#endif //CHIP8_EMU_AUDIO_H
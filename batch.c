@@ -0,0 +1,323 @@
+//
+// Batch runner: runs thousands of independent machines in one process, spread over a work-stealing thread pool.
+// Every instance gets its own chip8_t, so nothing is shared between them but the rom image. With -l the instances
+// of a rom run in groups of lanes on the lockstep engine instead (see lockstep.h), one group per job.
+//
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "chip8.h"
+#include "lockstep.h"
+#include "pool.h"
+#include "sched.h"
+
+typedef struct rom_image {
+    const char* filename;
+    unsigned char data[CHIP8_MAX_ROM_SIZE];
+    size_t size;
+} rom_image_t;
+
+typedef struct batch_job {
+    const rom_image_t* rom;
+    chip8_engine_t engine;
+    unsigned long cycles;
+    unsigned long ips;
+    // which instance of the rom this is, and whether it gets a seed and input of its own
+    unsigned long instance;
+    int seeded;
+    int random_keys;
+    // lockstep: this job runs lanes instances, itself and the jobs right after it
+    size_t lanes;
+    // instructions that actually ran, cycles minus the idle loop passes chip8_run_frame() skipped
+    unsigned long long executed;
+    unsigned long long hash;
+    int failed;
+} batch_job_t;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+
+// With -r every instance mashes its own keys: a new random keypad every frame, the same one in either mode so the
+// hashes can be compared. Roughly two keys down at a time.
+static uint16_t random_keys(unsigned long instance, unsigned long long frame) {
+    uint64_t z = (uint64_t)instance * 0x9E3779B97F4A7C15ULL + frame * 0xBF58476D1CE4E5B9ULL + 1;
+    z = (z ^ (z >> 31)) * 0x94D049BB133111EBULL;
+    z ^= z >> 29;
+    return (uint16_t)(z & (z >> 16) & (z >> 32));
+}
+
+// Sets up a fresh machine for job, 0 or -1
+static int start_machine(const batch_job_t* job, chip8_t* chip8) {
+    chip8_init(chip8);
+    chip8->engine = job->engine;
+    if (chip8_load_rom_data(chip8, job->rom->data, job->rom->size) != 0)
+        return -1;
+    if (job->seeded)
+        chip8_seed(chip8, job->instance);
+    return 0;
+}
+
+// Runs one instance start to finish. The machine lives on the heap only for the duration of the job so
+// memory use stays at (threads * sizeof(chip8_t)) no matter how many instances are queued.
+static void run_job(void* arg) {
+    batch_job_t* job = arg;
+    chip8_t* chip8 = malloc(sizeof *chip8);
+
+    if (chip8 == NULL) {
+        job->failed = 1;
+        return;
+    }
+
+    if (start_machine(job, chip8) != 0) {
+        job->failed = 1;
+        free(chip8);
+        return;
+    }
+
+    // frame by frame like the frontend, minus the sleeping, so the timers run at the same rate against the cpu
+    chip8_sched_t sched;
+    chip8_sched_init(&sched, job->ips);
+
+    for (unsigned long left = job->cycles; left > 0; chip8_sched_advance(&sched)) {
+        unsigned long n = chip8_sched_instructions(&sched);
+        if (n > left)
+            n = left;
+        if (job->random_keys) {
+            uint16_t keys = random_keys(job->instance, chip8->frame_count);
+            for (int k = 0; k < 16; k++)
+                chip8->keypad[k] = (keys >> k) & 1;
+        }
+        job->executed += chip8_run_frame(chip8, n);
+        left -= n;
+    }
+
+    job->hash = chip8_state_hash(chip8);
+    chip8_destroy(chip8);
+    free(chip8);
+}
+
+// Runs job and the job->lanes - 1 jobs after it (same rom, consecutive instances) as lanes of one lockstep batch.
+// The chip8_t is only used to set up and hash the lanes.
+static void run_lockstep_job(void* arg) {
+    batch_job_t* jobs = arg;
+    size_t lanes = jobs[0].lanes;
+    chip8_t* chip8 = malloc(sizeof *chip8);
+    unsigned char* keys = calloc(lanes, 16);
+    chip8_lockstep_t ls;
+
+    if (chip8 == NULL || keys == NULL || start_machine(&jobs[0], chip8) != 0 ||
+        chip8_lockstep_init(&ls, lanes, chip8) != 0) {
+        for (size_t l = 0; l < lanes; l++)
+            jobs[l].failed = 1;
+        free(chip8);
+        free(keys);
+        return;
+    }
+    for (size_t l = 1; l < lanes && jobs[0].seeded; l++) {
+        chip8_seed(chip8, jobs[l].instance);
+        chip8_lockstep_load(&ls, l, chip8);
+    }
+
+    chip8_sched_t sched;
+    chip8_sched_init(&sched, jobs[0].ips);
+
+    for (unsigned long left = jobs[0].cycles; left > 0; chip8_sched_advance(&sched)) {
+        unsigned long n = chip8_sched_instructions(&sched);
+        if (n > left)
+            n = left;
+        if (jobs[0].random_keys) {
+            for (size_t l = 0; l < lanes; l++) {
+                uint16_t mask = random_keys(jobs[l].instance, ls.frame_count);
+                for (int k = 0; k < 16; k++)
+                    keys[l * 16 + k] = (mask >> k) & 1;
+            }
+            chip8_lockstep_set_keys(&ls, keys);
+        }
+        chip8_lockstep_run_frame(&ls, n);
+        left -= n;
+    }
+
+    for (size_t l = 0; l < lanes; l++) {
+        chip8_lockstep_store(&ls, l, chip8);
+        jobs[l].hash = chip8_state_hash(chip8);
+        // the lanes don't skip idle loops, every instruction runs
+        jobs[l].executed = jobs[0].cycles;
+    }
+
+    chip8_lockstep_free(&ls);
+    chip8_destroy(chip8);
+    free(chip8);
+    free(keys);
+}
+
+static void usage(void) {
+    printf("usage: chip8-batch [-j threads] [-n instances] [-c cycles] [-i ips] [-e engine | -l lanes] [-s] [-r] [-v]\n");
+    printf("                   rom.ch8 [rom.ch8 ...]\n");
+    printf("  -j N   worker threads (default: one per core)\n");
+    printf("  -n N   instances per rom (default 1000)\n");
+    printf("  -c N   instructions per instance (default 100000)\n");
+    printf("  -i N   instructions per second of emulated time, the timers tick every ips / 60 (default %d)\n",
+           CHIP8_DEFAULT_IPS);
+    printf("  -e E   engine to run (switch, table, threaded, cached, jit, aot), default threaded\n");
+    printf("  -l N   run the instances of a rom N at a time on the lockstep SIMD engine instead\n");
+    printf("  -s     seed instance k with k instead of giving them all the same seed\n");
+    printf("  -r     give every instance its own random input, a new keypad every frame\n");
+    printf("  -v     print the end state hash of every instance\n");
+}
+
+int main(int argc, char** argv) {
+    int threads = 0;
+    unsigned long instances = 1000;
+    unsigned long cycles = 100000;
+    unsigned long ips = CHIP8_DEFAULT_IPS;
+    int engine = CHIP8_ENGINE_THREADED;
+    int verbose = 0;
+    unsigned long lanes = 0;
+    int seeded = 0;
+    int random_input = 0;
+    int first_rom = 1;
+
+    for (; first_rom < argc && argv[first_rom][0] == '-'; first_rom++) {
+        const char* opt = argv[first_rom];
+
+        if (strcmp(opt, "-v") == 0) {
+            verbose = 1;
+        } else if (strcmp(opt, "-s") == 0) {
+            seeded = 1;
+        } else if (strcmp(opt, "-r") == 0) {
+            random_input = 1;
+        } else if (first_rom + 1 < argc && strcmp(opt, "-l") == 0) {
+            lanes = strtoul(argv[++first_rom], NULL, 10);
+            if (lanes == 0) {
+                usage();
+                return 1;
+            }
+        } else if (first_rom + 1 < argc && strcmp(opt, "-j") == 0) {
+            threads = atoi(argv[++first_rom]);
+        } else if (first_rom + 1 < argc && strcmp(opt, "-n") == 0) {
+            instances = strtoul(argv[++first_rom], NULL, 10);
+        } else if (first_rom + 1 < argc && strcmp(opt, "-c") == 0) {
+            cycles = strtoul(argv[++first_rom], NULL, 10);
+        } else if (first_rom + 1 < argc && strcmp(opt, "-i") == 0) {
+            ips = strtoul(argv[++first_rom], NULL, 10);
+        } else if (first_rom + 1 < argc && strcmp(opt, "-e") == 0) {
+            engine = chip8_engine_from_name(argv[++first_rom]);
+            if (engine < 0) {
+                usage();
+                return 1;
+            }
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    int rom_count = argc - first_rom;
+    if (rom_count <= 0 || instances == 0 || ips == 0) {
+        usage();
+        return 1;
+    }
+
+    DEBUG = 0;
+
+    rom_image_t* roms = calloc(rom_count, sizeof *roms);
+    size_t job_count = (size_t)rom_count * instances;
+    batch_job_t* jobs = calloc(job_count, sizeof *jobs);
+    if (roms == NULL || jobs == NULL) {
+        printf("[FAILED] out of memory\n");
+        return 1;
+    }
+
+    for (int r = 0; r < rom_count; r++) {
+        const char* filename = argv[first_rom + r];
+        int status = chip8_read_rom(filename, roms[r].data, &roms[r].size);
+        if (status != 0) {
+            printf("[FAILED] %s: %s\n", filename, status == -1 ? "too big for memory" : strerror(status));
+            return 1;
+        }
+        roms[r].filename = filename;
+    }
+
+    pool_t* pool = pool_create(threads);
+    if (pool == NULL) {
+        printf("[FAILED] couldn't start the thread pool\n");
+        return 1;
+    }
+    if (lanes)
+        printf("[OK] %d roms x %lu instances, %lu lanes to a job, on %d threads\n", rom_count, instances, lanes,
+               pool_threads(pool));
+    else
+        printf("[OK] %d roms x %lu instances on %d threads\n", rom_count, instances, pool_threads(pool));
+
+    double start = now_seconds();
+
+    for (size_t j = 0; j < job_count; j++) {
+        jobs[j].rom = &roms[j / instances];
+        jobs[j].engine = (chip8_engine_t)engine;
+        jobs[j].cycles = cycles;
+        jobs[j].ips = ips;
+        jobs[j].instance = j % instances;
+        jobs[j].seeded = seeded;
+        jobs[j].random_keys = random_input;
+    }
+    int queued = 1;
+    for (size_t j = 0; j < job_count && queued; j++) {
+        if (!lanes) {
+            queued = pool_submit(pool, run_job, &jobs[j]) == 0;
+            continue;
+        }
+        // a lockstep job takes up to lanes instances, never running into the next rom's
+        if (jobs[j].instance % lanes == 0) {
+            unsigned long left = instances - jobs[j].instance;
+            jobs[j].lanes = left < lanes ? left : lanes;
+            queued = pool_submit(pool, run_lockstep_job, &jobs[j]) == 0;
+        }
+    }
+    pool_wait(pool);
+
+    if (!queued) {
+        printf("[FAILED] out of memory queueing the instances\n");
+        pool_destroy(pool);
+        return 1;
+    }
+
+    double elapsed = now_seconds() - start;
+    if (elapsed <= 0)
+        elapsed = 1e-9;
+
+    pool_destroy(pool);
+
+    size_t failed = 0;
+    double executed = 0;
+
+    for (size_t j = 0; j < job_count; j++) {
+        if (jobs[j].failed) {
+            failed++;
+            continue;
+        }
+        executed += (double)jobs[j].executed;
+        if (verbose)
+            printf("%s #%zu: hash %016llx\n", jobs[j].rom->filename, j % instances, jobs[j].hash);
+    }
+
+    double total_cycles = (double)(job_count - failed) * (double)cycles;
+
+    printf("instances:    %zu (%zu failed)\n", job_count, failed);
+    printf("instructions: %.0f\n", executed);
+    printf("idle skipped: %.0f\n", total_cycles - executed);
+    printf("wall time:    %.3f s\n", elapsed);
+    printf("instr/sec:    %.0f\n", executed / elapsed);
+
+    free(jobs);
+    free(roms);
+    return failed != 0;
+}
@@ -0,0 +1,295 @@
+//
+// Headless benchmark runner. Runs a rom as fast as possible (no frame pacing, no SDL)
+// and reports how many instructions and frames per second the core manages, for every engine.
+// With a movie the input is replayed too, so the runs are reproducible bit for bit and the end state hashes of
+// all the engines have to match.
+//
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "chip8.h"
+#include "movie.h"
+#include "profile.h"
+#include "quirks.h"
+#include "sched.h"
+#include "timing.h"
+#include "trace.h"
+
+typedef struct bench_result {
+    // instructions emulated, and how many of them actually ran: the rest were idle loop passes chip8_run_frame()
+    // skipped because they couldn't change anything
+    unsigned long long cycles;
+    unsigned long long executed;
+    unsigned long long frames;
+    unsigned long long hash;
+    double elapsed;
+} bench_result_t;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void usage(void) {
+    printf("usage: chip8-bench rom.ch8 [-c cycles | -f frames | -m movie] [-i ips | -T] [-e engine]\n");
+    printf("                   [-q platform]\n");
+    printf("  -c N   run N instructions (default 10000000)\n");
+    printf("  -f N   run N 60 Hz frames\n");
+    printf("  -m F   replay the movie F (its frames, input, seed, ips and platform) and check the engines end up the\n");
+    printf("         same\n");
+    printf("  -i N   instructions per second of emulated time, a frame runs ips / 60 of them (default %d)\n",
+           CHIP8_DEFAULT_IPS);
+    printf("  -T     pace the frames by the COSMAC VIP timing model instead (see timing.h)\n");
+    printf("  -e E   only run engine E (switch, table, threaded, cached, jit, aot), default is all of them\n");
+    printf("  -q P   quirks of platform P (default, vip, chip48, schip, xochip), default is default\n");
+#ifdef CHIP8_TRACE
+    printf("  -t F   trace the last 1M instructions into F (read it with chip8-tracedump)\n");
+#endif
+#ifdef CHIP8_PROFILE
+    printf("  -p F   write a profile report to F and folded call stacks (for flamegraph.pl) to F.folded\n");
+#endif
+}
+
+// Same frame loop as the frontend without the sleep. Pass a large ips to measure the engines rather than the
+// per-frame overhead. ips 0 runs the frames on the VIP timing model, -c then stops at the first frame that gets there.
+static int run_bench(chip8_t* chip8, unsigned long ips, unsigned long long max_cycles, unsigned long long max_frames,
+                     const chip8_movie_t* movie, bench_result_t* out) {
+    unsigned long long cycles = 0;
+    unsigned long long executed = 0;
+    chip8_sched_t sched;
+
+    chip8_sched_init(&sched, ips);
+    double start = now_seconds();
+
+    while (max_frames ? chip8->frame_count < max_frames : cycles < max_cycles) {
+        if (ips == 0) {
+            if (movie)
+                chip8_movie_play(movie, chip8);
+            unsigned long ran = chip8_run_timed_frame(chip8);
+            cycles += ran;
+            executed += ran;
+            continue;
+        }
+
+        unsigned long long n = chip8_sched_instructions(&sched);
+        if (!max_frames && n > max_cycles - cycles)
+            n = max_cycles - cycles;
+        if (movie)
+            chip8_movie_play(movie, chip8);
+        executed += chip8_run_frame(chip8, (unsigned long)n);
+        chip8_sched_advance(&sched);
+        cycles += n;
+    }
+
+    out->elapsed = now_seconds() - start;
+    if (out->elapsed <= 0)
+        out->elapsed = 1e-9;
+    out->cycles = cycles;
+    out->executed = executed;
+    out->frames = chip8->frame_count;
+    out->hash = chip8_state_hash(chip8);
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    unsigned long long max_cycles = 10000000ULL;
+    unsigned long long max_frames = 0;
+    unsigned long ips = CHIP8_DEFAULT_IPS;
+    int only_engine = -1;
+    int platform = CHIP8_PLATFORM_DEFAULT;
+    const char* trace_file = NULL;
+    const char* movie_file = NULL;
+    const char* profile_file = NULL;
+
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            max_cycles = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            max_frames = strtoull(argv[++i], NULL, 10);
+            max_cycles = 0;
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            movie_file = argv[++i];
+        } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            ips = strtoul(argv[++i], NULL, 10);
+            if (ips == 0) {
+                usage();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-T") == 0) {
+            ips = 0;
+        } else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            only_engine = chip8_engine_from_name(argv[++i]);
+            if (only_engine < 0) {
+                usage();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+            platform = chip8_platform_from_name(argv[++i]);
+            if (platform < 0) {
+                usage();
+                return 1;
+            }
+#ifdef CHIP8_TRACE
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            trace_file = argv[++i];
+#endif
+#ifdef CHIP8_PROFILE
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            profile_file = argv[++i];
+#endif
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    // no loader chatter in the middle of the report
+    DEBUG = 0;
+
+#ifdef CHIP8_TRACE
+    chip8_trace_t trace;
+    if (trace_file && chip8_trace_open(&trace, 1 << 20) != 0) {
+        printf("[FAILED] could not allocate the trace buffer\n");
+        return 1;
+    }
+#endif
+#ifdef CHIP8_PROFILE
+    chip8_profile_t profile;
+    if (profile_file && chip8_profile_open(&profile) != 0) {
+        printf("[FAILED] could not allocate the profile\n");
+        return 1;
+    }
+#endif
+
+    chip8_movie_t movie;
+    if (movie_file) {
+        int status = chip8_movie_read(&movie, movie_file);
+        if (status != 0) {
+            if (status == -1)
+                printf("[FAILED] %s is not a movie\n", movie_file);
+            else
+                perror(movie_file);
+            return 1;
+        }
+        ips = movie.ips;
+        platform = movie.platform;
+        max_frames = movie.frames;
+        max_cycles = 0;
+    }
+
+    static chip8_t chip8;
+    unsigned long long first_hash = 0;
+    int mismatch = 0;
+
+    // instr/sec only counts the instructions that ran, not the idle ones skipped
+    printf("%-10s %14s %14s %12s %10s %14s %12s %18s\n", "engine", "instructions", "idle skipped", "frames", "wall (s)",
+           "instr/sec", "frames/sec", "state hash");
+
+    for (int engine = 0; engine < CHIP8_ENGINE_COUNT; engine++) {
+        if (only_engine >= 0 && engine != only_engine)
+            continue;
+
+        chip8_init(&chip8);
+        chip8.engine = (chip8_engine_t)engine;
+
+        int status = chip8_load_rom(&chip8, argv[1]);
+        if (status == -1) {
+            printf("[FAILED] the rom is too big for memory.\n");
+            return 1;
+        }
+        else if (status != 0) {
+            perror("Error while loading rom");
+            return 1;
+        }
+
+        if (movie_file) {
+            if (chip8_movie_rom_hash(&chip8) != movie.rom_hash) {
+                printf("[FAILED] %s was recorded on a different rom\n", movie_file);
+                return 1;
+            }
+            chip8_seed(&chip8, movie.seed);
+        }
+        chip8_set_platform(&chip8, (chip8_platform_t)platform);
+
+#ifdef CHIP8_TRACE
+        // the trace ends up holding the last engine that ran
+        if (trace_file) {
+            trace.count = 0;
+            chip8.trace = &trace;
+        }
+#endif
+#ifdef CHIP8_PROFILE
+        // same for the profile
+        if (profile_file) {
+            chip8_profile_reset(&profile);
+            chip8.profile = &profile;
+        }
+#endif
+
+        bench_result_t r;
+        run_bench(&chip8, ips, max_cycles, max_frames, movie_file ? &movie : NULL, &r);
+
+        printf("%-10s %14llu %14llu %12llu %10.3f %14.0f %12.0f   %016llx\n", chip8_engine_name(chip8.engine),
+               r.executed, r.cycles - r.executed, r.frames, r.elapsed, (double)r.executed / r.elapsed,
+               (double)r.frames / r.elapsed, r.hash);
+
+        if (first_hash == 0)
+            first_hash = r.hash;
+        else if (r.hash != first_hash)
+            mismatch = 1;
+
+        chip8_destroy(&chip8);
+    }
+
+#ifdef CHIP8_TRACE
+    if (trace_file) {
+        if (chip8_trace_dump(&trace, trace_file) != 0)
+            perror(trace_file);
+        chip8_trace_close(&trace);
+    }
+#else
+    (void)trace_file;
+#endif
+#ifdef CHIP8_PROFILE
+    if (profile_file) {
+        char folded_file[4096];
+        snprintf(folded_file, sizeof folded_file, "%s.folded", profile_file);
+
+        FILE* report = fopen(profile_file, "w");
+        FILE* folded = fopen(folded_file, "w");
+        if (report == NULL || folded == NULL) {
+            perror(report == NULL ? profile_file : folded_file);
+        } else {
+            chip8_profile_report(&profile, &chip8, 32, report);
+            chip8_profile_folded(&profile, folded);
+        }
+        if (report) fclose(report);
+        if (folded) fclose(folded);
+        chip8_profile_close(&profile);
+    }
+#else
+    (void)profile_file;
+#endif
+
+    if (movie_file)
+        chip8_movie_free(&movie);
+
+    // every engine is supposed to end up in exactly the same state
+    if (mismatch) {
+        printf("[FAILED] the engines disagree on the end state\n");
+        return 1;
+    }
+    return 0;
+}
@@ -4,22 +4,213 @@
 
 #ifndef CHIP8_EMU_CHIP8_H
 #define CHIP8_EMU_CHIP8_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "decode.h"
+
+// The biggest screen (SUPER-CHIP / XO-CHIP hi-res) and XO-CHIP's bit planes
+#define CHIP8_MAX_WIDTH 128
+#define CHIP8_MAX_HEIGHT 64
+#define CHIP8_PLANES 2
+
+// How chip8_step() runs instructions. They all behave the same, the switch engine is the reference the others are
+// checked against.
+typedef enum chip8_engine {
+    CHIP8_ENGINE_SWITCH,    // emulate_cycle(): decode with the nested switch every cycle
+    CHIP8_ENGINE_TABLE,     // pre-decoded opcode table, one switch on the handler
+    CHIP8_ENGINE_THREADED,  // pre-decoded opcode table, computed goto dispatch (the table engine without GCC/Clang)
+    CHIP8_ENGINE_CACHED,    // threaded, but decoded instructions are cached per pc so hot loops skip the fetch too
+    CHIP8_ENGINE_JIT,       // basic blocks recompiled to x86-64 (see jit.c), the cached engine everywhere else
+    CHIP8_ENGINE_AOT,       // the rom recompiled ahead of time into C (see aot.h), the cached engine for other roms
+    CHIP8_ENGINE_COUNT
+} chip8_engine_t;
+
+// What chip8_run_frame() found the machine doing when the frame started (see idle.h)
+typedef enum chip8_idle {
+    CHIP8_IDLE_NONE,    // running
+    CHIP8_IDLE_TIMER,   // looping until the delay timer changes
+    CHIP8_IDLE_KEY,     // looping until the keypad changes (FX0A, key polling, or a jump to itself)
+} chip8_idle_t;
+
+// The engines only keep the pc of the instruction that is running around when a per-instruction hook wants it
+#if defined(CHIP8_TRACE) || defined(CHIP8_PROFILE)
+#define CHIP8_HOOK_PC
+#endif
+
+// All of the state for one machine. Nothing in the core is global anymore (apart from the read only font set),
+// so any number of these can run side by side, including on different threads
+typedef struct chip8 {
+    // memory
+    unsigned char memory[4096];
+
+    /* -16 general purpose 8-bit registers, sometimes called Vx where "x" is a hexadecimal digit -
+       -A char is 8-bits, so we store 16 of them */
+    unsigned char V[16];
+
+    // There is a special 16-bit register called I that is used to store memory addresses
+    unsigned short I;
+
+    // The PC is the program counter which will point to the current instruction in memory. It is a pseudo-register and is 16 bits
+    unsigned short pc;
+
+    // The stack pointer pseudo-register will point to the top of the stack. It is 8 bits
+    unsigned char sp;
+
+    // The stack: An array of 16 16-bit values, used to store the address that the interpreter should return when finished with a subroutine
+    unsigned short stack[16];
+
+    // keypad
+    unsigned char keypad[16];
+
+    // Display: bit planes of up to 128x64 pixels (SUPER-CHIP hi-res), two of them for XO-CHIP. Row y of plane p is
+    // display[p][0][y] (pixels 0-63) and display[p][1][y] (pixels 64-127), pixel x of a word is bit 63 - x % 64, so
+    // a sprite byte lines up with the top byte of the word. In lo-res the screen is the top left 64x32 corner:
+    // display[0][0] is the same 32 words, one per row, the display always was. Scrolling is a memmove of a column
+    // of words or a shift along a row.
+    uint64_t display[CHIP8_PLANES][2][CHIP8_MAX_HEIGHT];
+
+    // 128x64 after 00FF, 64x32 after 00FE (and at power on)
+    unsigned char hires;
+
+    // the planes FN01 selected, bit p for plane p. Drawing, clearing and scrolling only touch these. 1 at power on.
+    unsigned char planes;
+
+    // delay timer
+    unsigned char delayTimer;
+
+    // Sound Timer
+    unsigned char soundTimer;
+
+    //update display flag
+    unsigned char draw_flag;
+
+    // Bit y is set when display row y changed (DXYN sets the rows it drew on, 00E0, the scrolls and the resolution
+    // switches all of them). The core only ever sets bits, whoever consumes the display clears them, so a renderer
+    // only uploads rows that actually changed.
+    uint64_t dirty_rows;
+
+    // Play a sound flag
+    unsigned char sound_flag;
+
+    // 60 Hz frames run so far (chip8_run_frame() calls)
+    unsigned long long frame_count;
+
+    // a chip8_idle_t, set by every chip8_run_frame()
+    unsigned char idle;
+
+    // machine cycles chip8_run_timed_frame() carries into the next frame, negative when a frame overran (timing.h)
+    long cycles;
+
+    // xorshift64* state for CXNN, never 0. Per machine instead of libc rand(): reproducible from the seed, and
+    // no shared lock between machines running on different threads.
+    uint64_t rng;
+
+    // which interpreter chip8_step() uses, chip8_init() picks the fastest
+    chip8_engine_t engine;
+
+    // Decoded instruction cache for the cached engine, indexed by pc. An entry with op == CHIP8_OP_COUNT hasn't been
+    // decoded yet. Every engine invalidates the entries its memory writes touch, so it is never stale no matter
+    // which engine ran last. Anything else that writes memory has to call chip8_icache_flush().
+    chip8_decoded_t icache[4096];
+
+    // recompiler state for the jit engine, created on first use
+    struct chip8_jit* jit;
+
+    // the built in aot program for the rom in memory (NULL if there is none), and whether the code it was translated
+    // from is still there. chip8_icache_flush() looks the program up again.
+    const struct chip8_aot_program* aot;
+    unsigned char aot_valid;
+
+    // a chip8_platform_t (quirks.h), the platform the rom was written for, whose quirks decide which core runs it.
+    // Set it with chip8_set_platform().
+    unsigned char platform;
+
+#ifdef CHIP8_TRACE
+    // instruction trace ring, NULL when not tracing (see trace.h)
+    struct chip8_trace* trace;
+#endif
+#ifdef CHIP8_PROFILE
+    // counters, NULL when not profiling (see profile.h)
+    struct chip8_profile* profile;
+#endif
+} chip8_t;
+
 extern unsigned char fontset[80];
-extern unsigned char memory[4096];
-extern unsigned char V[16];
-extern unsigned short I;
-extern unsigned short pc;
-extern unsigned char sp;
-extern unsigned short stack[16];
-extern unsigned char keypad[16];
-extern unsigned char display[64 * 32];
-extern unsigned char delayTimer;
-extern unsigned char soundTimer;
-extern unsigned char draw_flag;
-extern unsigned char sound_flag;
-
-void initialize_cpu(void);
-int load_rom(char* filename);
-void emulate_cycle(void);
+
+// The delay and sound timers count down at 60 Hz whatever speed the CPU runs at
+#define CHIP8_FRAME_HZ 60
+// Instructions per second when nothing else is asked for, roughly what the original interpreters managed
+#define CHIP8_DEFAULT_IPS 700
+// What chip8_init() seeds the random generator with
+#define CHIP8_DEFAULT_SEED 0x43484950ULL
+
+// Next random byte (xorshift64*, the top byte of the output)
+static inline unsigned char chip8_rand(chip8_t* chip8) {
+    uint64_t x = chip8->rng;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    chip8->rng = x;
+    return (unsigned char)((x * 0x2545F4914F6CDD1DULL) >> 56);
+}
+
+// Bit for pixel x in its display word
+#define CHIP8_PIXEL_MASK(x) (0x8000000000000000ULL >> ((x) & 63))
+
+// The screen size in the current resolution
+static inline unsigned int chip8_display_width(const chip8_t* chip8) {
+    return chip8->hires ? 128 : 64;
+}
+
+static inline unsigned int chip8_display_height(const chip8_t* chip8) {
+    return chip8->hires ? 64 : 32;
+}
+
+static inline int chip8_pixel(const chip8_t* chip8, unsigned int plane, unsigned int x, unsigned int y) {
+    return (chip8->display[plane][x >> 6][y] & CHIP8_PIXEL_MASK(x)) != 0;
+}
+
+// Expands the display to one byte per pixel in the current resolution, width * height bytes row by row. A pixel
+// is 0-3, bit p set when it is lit in plane p.
+void chip8_display_unpack(const chip8_t* chip8, unsigned char* pixels);
+
+// Loader verbosity: chip8_load_rom() prints the number of bytes it read unless it is 0 (the headless runners set
+// it to 0). Instruction tracing is the CHIP8_TRACE build, see trace.h.
+extern int DEBUG;
+
+void chip8_init(chip8_t* chip8);
+// Restarts the random generator from seed, same seed and same input gives the same run
+void chip8_seed(chip8_t* chip8, uint64_t seed);
+// Frees what the engines allocated on the side (the jit's code buffer). Call it before chip8_init()-ing the same
+// machine again or freeing it.
+void chip8_destroy(chip8_t* chip8);
+// The biggest rom there is room for, from 0x200 to the end of memory
+#define CHIP8_MAX_ROM_SIZE (4096 - 0x200)
+// Reads a rom file into data (CHIP8_MAX_ROM_SIZE bytes), for tools that load the same rom into many machines. 0 on
+// success, errno if the file can't be read, -1 if it is too big for memory. chip8_load_rom() returns the same.
+int chip8_read_rom(const char* filename, unsigned char* data, size_t* size);
+int chip8_load_rom(chip8_t* chip8, const char* filename);
+int chip8_load_rom_data(chip8_t* chip8, const unsigned char* data, size_t size);
+// Runs n instructions. The timers are left alone, they only move in chip8_tick_timers().
+void chip8_step(chip8_t* chip8, unsigned long n);
+// One 60 Hz tick of the delay and sound timers. Sets sound_flag while the sound timer is running.
+void chip8_tick_timers(chip8_t* chip8);
+// One frame: n instructions in one batch, then one timer tick (see sched.h for how many instructions a frame gets).
+// When the machine is in an idle loop only as many instructions run as it takes to end up in the same state.
+// Returns how many actually ran, n minus the ones the idle loop skipped.
+unsigned long chip8_run_frame(chip8_t* chip8, unsigned long n);
+void emulate_cycle(chip8_t* chip8);
+
+// Forgets every cached decode, for after writing to memory from outside the core
+void chip8_icache_flush(chip8_t* chip8);
+
+const char* chip8_engine_name(chip8_engine_t engine);
+// -1 if there is no engine by that name
+int chip8_engine_from_name(const char* name);
+
+// 64-bit hash of the machine state (memory, registers, stack, display, timers, random generator), for comparing runs
+unsigned long long chip8_state_hash(const chip8_t* chip8);
 
 #endif //CHIP8_EMU_CHIP8_H
@@ -0,0 +1,95 @@
+#include <pthread.h>
+
+#include "decode.h"
+
+chip8_decoded_t chip8_decoded[65536];
+
+static pthread_once_t decode_once = PTHREAD_ONCE_INIT;
+
+// Same decoding as the nested switch in emulate_cycle(), just done once per opcode instead of once per cycle
+static unsigned char decode_op(unsigned short opcode) {
+    switch (opcode & 0xF000) {
+        case 0x0000:
+            switch (opcode & 0x00FF) {
+                case 0x00E0: return CHIP8_OP_CLS;
+                case 0x00EE: return CHIP8_OP_RET;
+                case 0x00FB: return CHIP8_OP_SCR;
+                case 0x00FC: return CHIP8_OP_SCL;
+                case 0x00FE: return CHIP8_OP_LOW;
+                case 0x00FF: return CHIP8_OP_HIGH;
+            }
+            switch (opcode & 0x00F0) {
+                case 0x00C0: return CHIP8_OP_SCD;
+                case 0x00D0: return CHIP8_OP_SCU;
+            }
+            break;
+        case 0x1000: return CHIP8_OP_JP;
+        case 0x2000: return CHIP8_OP_CALL;
+        case 0x3000: return CHIP8_OP_SE_VX_NN;
+        case 0x4000: return CHIP8_OP_SNE_VX_NN;
+        case 0x5000: return CHIP8_OP_SE_VX_VY;
+        case 0x6000: return CHIP8_OP_LD_VX_NN;
+        case 0x7000: return CHIP8_OP_ADD_VX_NN;
+        case 0x8000:
+            switch (opcode & 0x000F) {
+                case 0x0: return CHIP8_OP_LD_VX_VY;
+                case 0x1: return CHIP8_OP_OR;
+                case 0x2: return CHIP8_OP_AND;
+                case 0x3: return CHIP8_OP_XOR;
+                case 0x4: return CHIP8_OP_ADD_VX_VY;
+                case 0x5: return CHIP8_OP_SUB;
+                case 0x6: return CHIP8_OP_SHR;
+                case 0x7: return CHIP8_OP_SUBN;
+                case 0xE: return CHIP8_OP_SHL;
+            }
+            break;
+        case 0x9000: return CHIP8_OP_SNE_VX_VY;
+        case 0xA000: return CHIP8_OP_LD_I;
+        case 0xB000: return CHIP8_OP_JP_V0;
+        case 0xC000: return CHIP8_OP_RND;
+        case 0xD000: return CHIP8_OP_DRW;
+        case 0xE000:
+            switch (opcode & 0x00FF) {
+                case 0x9E: return CHIP8_OP_SKP;
+                case 0xA1: return CHIP8_OP_SKNP;
+            }
+            break;
+        case 0xF000:
+            switch (opcode & 0x00FF) {
+                case 0x01: return CHIP8_OP_PLANE;
+                case 0x07: return CHIP8_OP_LD_VX_DT;
+                case 0x0A: return CHIP8_OP_LD_VX_K;
+                case 0x15: return CHIP8_OP_LD_DT_VX;
+                case 0x18: return CHIP8_OP_LD_ST_VX;
+                case 0x1E: return CHIP8_OP_ADD_I_VX;
+                case 0x29: return CHIP8_OP_LD_F_VX;
+                case 0x33: return CHIP8_OP_LD_B_VX;
+                case 0x55: return CHIP8_OP_LD_MEM_VX;
+                case 0x65: return CHIP8_OP_LD_VX_MEM;
+            }
+            break;
+    }
+    return CHIP8_OP_UNKNOWN;
+}
+
+chip8_decoded_t chip8_decode(unsigned short opcode) {
+    chip8_decoded_t d;
+
+    d.op = decode_op(opcode);
+    d.x = (opcode & 0x0F00) >> 8;
+    d.y = (opcode & 0x00F0) >> 4;
+    d.n = opcode & 0x000F;
+    d.nnn = opcode & 0x0FFF;
+    d.opcode = opcode;
+
+    return d;
+}
+
+static void build_table(void) {
+    for (unsigned int opcode = 0; opcode < 65536; opcode++)
+        chip8_decoded[opcode] = chip8_decode((unsigned short)opcode);
+}
+
+void chip8_decode_init(void) {
+    pthread_once(&decode_once, build_table);
+}
@@ -0,0 +1,79 @@
+//
+// Pre-decoded instruction table. Every one of the 65536 opcodes is decoded once at startup into a handler number
+// plus its operands, so the fast engines never pick apart an opcode at run time.
+//
+
+#ifndef CHIP8_EMU_DECODE_H
+#define CHIP8_EMU_DECODE_H
+
+// Every instruction the fast engines know, as X(NAME, handler). The handler is chip8_op_<handler>() in ops.h.
+// UNKNOWN has to stay first so a zeroed entry decodes as unknown. The last few are SUPER-CHIP's scrolls and
+// resolution switches and XO-CHIP's 00DN scroll up and FN01 plane select.
+#define CHIP8_OP_LIST(X)      \
+    X(UNKNOWN, unknown)       \
+    X(CLS, cls)               \
+    X(RET, ret)               \
+    X(JP, jp)                 \
+    X(CALL, call)             \
+    X(SE_VX_NN, se_vx_nn)     \
+    X(SNE_VX_NN, sne_vx_nn)   \
+    X(SE_VX_VY, se_vx_vy)     \
+    X(LD_VX_NN, ld_vx_nn)     \
+    X(ADD_VX_NN, add_vx_nn)   \
+    X(LD_VX_VY, ld_vx_vy)     \
+    X(OR, or)                 \
+    X(AND, and)               \
+    X(XOR, xor)               \
+    X(ADD_VX_VY, add_vx_vy)   \
+    X(SUB, sub)               \
+    X(SHR, shr)               \
+    X(SUBN, subn)             \
+    X(SHL, shl)               \
+    X(SNE_VX_VY, sne_vx_vy)   \
+    X(LD_I, ld_i)             \
+    X(JP_V0, jp_v0)           \
+    X(RND, rnd)               \
+    X(DRW, drw)               \
+    X(SKP, skp)               \
+    X(SKNP, sknp)             \
+    X(LD_VX_DT, ld_vx_dt)     \
+    X(LD_VX_K, ld_vx_k)       \
+    X(LD_DT_VX, ld_dt_vx)     \
+    X(LD_ST_VX, ld_st_vx)     \
+    X(ADD_I_VX, add_i_vx)     \
+    X(LD_F_VX, ld_f_vx)       \
+    X(LD_B_VX, ld_b_vx)       \
+    X(LD_MEM_VX, ld_mem_vx)   \
+    X(LD_VX_MEM, ld_vx_mem)   \
+    X(SCD, scd)               \
+    X(SCU, scu)               \
+    X(SCR, scr)               \
+    X(SCL, scl)               \
+    X(LOW, low)               \
+    X(HIGH, high)             \
+    X(PLANE, plane)
+
+typedef enum chip8_op {
+#define CHIP8_OP_ENUM(name, handler) CHIP8_OP_##name,
+    CHIP8_OP_LIST(CHIP8_OP_ENUM)
+#undef CHIP8_OP_ENUM
+    CHIP8_OP_COUNT
+} chip8_op_t;
+
+// One decoded opcode. nn is the low byte of nnn, so it isn't stored twice.
+typedef struct chip8_decoded {
+    unsigned char op;
+    unsigned char x;
+    unsigned char y;
+    unsigned char n;
+    unsigned short nnn;
+    unsigned short opcode;
+} chip8_decoded_t;
+
+// Indexed by opcode. Filled in by chip8_decode_init(), which chip8_init() calls (it only does the work once).
+extern chip8_decoded_t chip8_decoded[65536];
+
+void chip8_decode_init(void);
+chip8_decoded_t chip8_decode(unsigned short opcode);
+
+#endif //CHIP8_EMU_DECODE_H
@@ -0,0 +1,731 @@
+//
+// Differential tester: runs a candidate engine and the reference switch engine (emulate_cycle()) side by side on
+// the same rom, seed and input, compares their state hashes every K instructions, and on a mismatch goes back to
+// the last matching state and single steps both to find the first instruction they disagree on. Roms come from
+// files or are generated at random, every rom runs on every platform and every engine, and the runs are spread
+// over the work-stealing pool, so it is meant to be left running in CI.
+//
+// The candidate can also run whole frames through chip8_run_frame(), which skips what's left of an idle loop, or
+// run as the lanes of the lockstep engine. Those are compared at the end of every frame, and a mismatch is tracked
+// down by running the frame again cut short after 1, 2, ... instructions.
+//
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "chip8.h"
+#include "disasm.h"
+#include "lockstep.h"
+#include "pool.h"
+#include "quirks.h"
+#include "sched.h"
+#include "state.h"
+
+// bytes of code in a generated rom
+#define RANDOM_ROM_SIZE 1024
+
+typedef struct rom_image {
+    const char* filename;
+    char name[48];
+    unsigned char data[CHIP8_MAX_ROM_SIZE];
+    size_t size;
+    // the machines are seeded with it, and it picks the keys pressed every frame
+    uint64_t seed;
+} rom_image_t;
+
+typedef enum diff_mode {
+    DIFF_STEP,      // the candidate steps as many instructions as the reference, compared every job->every
+    DIFF_FRAME,     // the candidate runs whole frames with chip8_run_frame()
+    DIFF_LOCKSTEP   // job->lanes lanes of the lockstep engine, each against a reference of its own
+} diff_mode_t;
+
+typedef struct diff_job {
+    const rom_image_t* rom;
+    diff_mode_t mode;
+    size_t lanes;
+    chip8_engine_t engine;
+    chip8_platform_t platform;
+    unsigned long cycles;
+    unsigned long ips;
+    unsigned long every;
+
+    // instructions run on both machines and compared, and why the run ended before cycles (NULL if it didn't)
+    unsigned long long checked;
+    const char* stopped;
+
+    // the first instruction the engines disagree on: its index in the run, pc and opcode, and what came out
+    // different. Not exact when single stepping didn't reproduce it, then it is somewhere in the every
+    // instructions from there.
+    int diverged;
+    int exact;
+    size_t lane;
+    unsigned long long at;
+    unsigned short pc;
+    unsigned short opcode;
+    char what[160];
+
+    int failed;
+} diff_job_t;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// 0, or what chip8_read_rom() failed with
+static int read_rom(const char* filename, rom_image_t* rom) {
+    int status = chip8_read_rom(filename, rom->data, &rom->size);
+    if (status != 0) return status;
+
+    rom->filename = filename;
+    snprintf(rom->name, sizeof rom->name, "%s", filename);
+    rom->seed = CHIP8_DEFAULT_SEED;
+    return 0;
+}
+
+// splitmix64, for the generated roms and the keys
+static uint64_t next_random(uint64_t* s) {
+    uint64_t z = (*s += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// A random valid instruction, every kind there is. Jumps and calls land on an instruction of the rom, I and half
+// of the BNNNs anywhere.
+static unsigned short random_opcode(uint64_t* s) {
+    uint64_t r = next_random(s);
+    unsigned int x = (r >> 8) & 0xF;
+    unsigned int y = (r >> 12) & 0xF;
+    unsigned int nn = (r >> 16) & 0xFF;
+    unsigned int target = 0x200 + (unsigned int)((r >> 24) % (RANDOM_ROM_SIZE / 2)) * 2;
+    unsigned int xy = x << 8 | y << 4;
+    static const unsigned short display_ops[] = {0x00C0, 0x00D0, 0x00FB, 0x00FC, 0x00FE, 0x00FF};
+    static const unsigned char alu_ops[] = {0x0, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7, 0xE};
+
+    switch (r % 32) {
+        case 0: return 0x00E0;
+        case 1: return 0x00EE;
+        case 2: return display_ops[nn % 6] | (nn % 6 < 2 ? y : 0);
+        case 3: return 0x1000 | target;
+        case 4: return 0x2000 | target;
+        case 5: return 0x3000 | x << 8 | nn;
+        case 6: return 0x4000 | x << 8 | nn;
+        case 7: return 0x5000 | xy;
+        case 8: return 0x9000 | xy;
+        case 9:
+        case 10: return 0x6000 | x << 8 | nn;
+        case 11:
+        case 12: return 0x7000 | x << 8 | nn;
+        case 13:
+        case 14:
+        case 15: return 0x8000 | xy | alu_ops[nn % 9];
+        case 16:
+        case 17: return 0xA000 | ((r >> 20) & 0xFFF);
+        case 18: return 0xB000 | (nn & 1 ? target : (r >> 20) & 0xFFF);    // anywhere, past 0xFFF with V0 too
+        case 19: return 0xC000 | x << 8 | nn;
+        case 20:
+        case 21: return 0xD000 | xy | (nn & 0xF);
+        case 22: return 0xE000 | x << 8 | (nn & 1 ? 0x9E : 0xA1);
+        case 23: return 0xF007 | x << 8;
+        case 24: return 0xF00A | x << 8;
+        case 25: return 0xF015 | x << 8;
+        case 26: return 0xF018 | x << 8;
+        case 27: return 0xF01E | x << 8;
+        case 28: return 0xF029 | x << 8;
+        case 29: return 0xF033 | x << 8;
+        case 30: return (nn & 1 ? 0xF055 : 0xF065) | x << 8;
+        default: return 0xF001 | (x & 3) << 8;
+    }
+}
+
+static void generate_rom(rom_image_t* rom, uint64_t seed) {
+    uint64_t s = seed;
+
+    snprintf(rom->name, sizeof rom->name, "random:%llu", (unsigned long long)seed);
+    rom->size = RANDOM_ROM_SIZE;
+    rom->seed = seed;
+    for (size_t i = 0; i < RANDOM_ROM_SIZE; i += 2) {
+        unsigned short opcode = random_opcode(&s);
+        rom->data[i] = opcode >> 8;
+        rom->data[i + 1] = opcode & 0xFF;
+    }
+}
+
+// The keypad for a frame, the candidate gets a copy. Roughly two keys down at a time.
+static void set_keys(chip8_t* chip8, uint64_t seed, unsigned long long frame) {
+    uint64_t s = seed ^ frame * 0xD1B54A32D192ED03ULL;
+    uint64_t z = next_random(&s);
+    uint16_t keys = (uint16_t)(z & (z >> 16) & (z >> 32));
+
+    for (int k = 0; k < 16; k++)
+        chip8->keypad[k] = (keys >> k) & 1;
+}
+
+static int start_machine(const diff_job_t* job, chip8_t* chip8, chip8_engine_t engine) {
+    chip8_init(chip8);
+    chip8->engine = engine;
+    chip8_set_platform(chip8, job->platform);
+    if (chip8_load_rom_data(chip8, job->rom->data, job->rom->size) != 0)
+        return -1;
+    chip8_seed(chip8, job->rom->seed);
+    return 0;
+}
+
+// The opcode at pc, wrapping at 4K like the engines' fetch
+static unsigned short opcode_at(const unsigned char* memory, unsigned int pc) {
+    return memory[pc & 0xFFF] << 8 | memory[(pc + 1) & 0xFFF];
+}
+
+// Whether lockstep lanes run op. They leave the SUPER-CHIP / XO-CHIP display instructions alone like unknown
+// opcodes.
+static int lane_runs(chip8_op_t op) {
+    switch (op) {
+        case CHIP8_OP_UNKNOWN:
+        case CHIP8_OP_SCD:
+        case CHIP8_OP_SCU:
+        case CHIP8_OP_SCR:
+        case CHIP8_OP_SCL:
+        case CHIP8_OP_LOW:
+        case CHIP8_OP_HIGH:
+        case CHIP8_OP_PLANE:
+            return 0;
+        default:
+            return 1;
+    }
+}
+
+// Up to n instructions on the reference. It stops in front of an unknown opcode: every engine stays on it, printing
+// it forever. In front of what lockstep lanes don't run too, when checking those. Returns how many ran.
+static unsigned long step_reference(const diff_job_t* job, chip8_t* ref, unsigned long n, const char** stopped) {
+    for (unsigned long i = 0; i < n; i++) {
+        chip8_op_t op = chip8_decoded[opcode_at(ref->memory, ref->pc)].op;
+        if (op == CHIP8_OP_UNKNOWN) {
+            *stopped = "unknown opcode";
+            return i;
+        }
+        if (job->mode == DIFF_LOCKSTEP && !lane_runs(op)) {
+            *stopped = "an instruction lockstep lanes don't run";
+            return i;
+        }
+        emulate_cycle(ref);
+    }
+    return n;
+}
+
+static void append(char* buf, size_t size, const char* fmt, unsigned int a, unsigned int b, unsigned int c) {
+    size_t len = strlen(buf);
+    if (len + 1 < size)
+        snprintf(buf + len, size - len, fmt, a, b, c);
+}
+
+// Lists what differs between the reference and the candidate, reference value first
+static void describe(const chip8_t* ref, const chip8_t* cand, char* buf, size_t size) {
+    buf[0] = '\0';
+
+    if (ref->pc != cand->pc)
+        append(buf, size, " pc %03X/%03X", ref->pc, cand->pc, 0);
+    if (ref->I != cand->I)
+        append(buf, size, " I %03X/%03X", ref->I, cand->I, 0);
+    for (int i = 0; i < 16; i++) {
+        if (ref->V[i] != cand->V[i])
+            append(buf, size, " V%X %02X/%02X", i, ref->V[i], cand->V[i]);
+    }
+    if (ref->sp != cand->sp || memcmp(ref->stack, cand->stack, sizeof ref->stack) != 0)
+        append(buf, size, " stack", 0, 0, 0);
+    for (int a = 0; a < 4096; a++) {
+        if (ref->memory[a] != cand->memory[a]) {
+            append(buf, size, " memory[%03X] %02X/%02X", a, ref->memory[a], cand->memory[a]);
+            break;
+        }
+    }
+    if (memcmp(ref->display, cand->display, sizeof ref->display) != 0 || ref->hires != cand->hires ||
+        ref->planes != cand->planes)
+        append(buf, size, " display", 0, 0, 0);
+    if (ref->delayTimer != cand->delayTimer || ref->soundTimer != cand->soundTimer)
+        append(buf, size, " timers", 0, 0, 0);
+    if (ref->rng != cand->rng)
+        append(buf, size, " rng", 0, 0, 0);
+    if (ref->cycles != cand->cycles)
+        append(buf, size, " cycles", 0, 0, 0);
+}
+
+// The hashes stopped matching somewhere in the n instructions after the run's instruction base: puts both
+// machines back to where they still matched and single steps them to the first instruction that makes a difference.
+static void find_divergence(diff_job_t* job, chip8_t* ref, chip8_t* cand, const chip8_state_t* before,
+                            unsigned long long base, unsigned long n) {
+    job->diverged = 1;
+    job->at = base;
+    job->pc = before->pc;
+    job->opcode = opcode_at(before->memory, before->pc);
+    describe(ref, cand, job->what, sizeof job->what);
+
+    chip8_state_load(ref, before);
+    chip8_state_load(cand, before);
+
+    for (unsigned long i = 0; i < n; i++) {
+        unsigned short pc = ref->pc;
+        unsigned short opcode = opcode_at(ref->memory, pc);
+
+        emulate_cycle(ref);
+        chip8_step(cand, 1);
+        if (chip8_state_hash(ref) != chip8_state_hash(cand)) {
+            job->exact = 1;
+            job->at = base + i;
+            job->pc = pc;
+            job->opcode = opcode;
+            describe(ref, cand, job->what, sizeof job->what);
+            return;
+        }
+    }
+}
+
+// One frame of n instructions on the candidate: chip8_run_frame(), or when lane isn't NULL the lockstep engine with
+// the candidate's state in its only lane
+static void run_candidate_frame(chip8_t* cand, chip8_lockstep_t* lane, unsigned long n) {
+    if (lane == NULL) {
+        chip8_run_frame(cand, n);
+        return;
+    }
+    chip8_lockstep_load(lane, 0, cand);
+    lane->frame_count = cand->frame_count;
+    chip8_lockstep_run_frame(lane, n);
+    chip8_lockstep_store(lane, 0, cand);
+}
+
+// A whole frame of n instructions came out different. A frame can't be single stepped, the timers tick at its end
+// and the idle skip looks at all of it, so it is run again from where both still matched cut short after 1, 2, ...
+// instructions, until the first one that makes a difference.
+static void find_frame_divergence(diff_job_t* job, chip8_t* ref, chip8_t* cand, chip8_lockstep_t* lane,
+                                  const chip8_state_t* before, unsigned long long base, unsigned long n) {
+    job->diverged = 1;
+    job->at = base;
+    job->pc = before->pc;
+    job->opcode = opcode_at(before->memory, before->pc);
+    describe(ref, cand, job->what, sizeof job->what);
+
+    for (unsigned long i = 1; i <= n; i++) {
+        const char* stopped = NULL;
+
+        chip8_state_load(ref, before);
+        chip8_state_load(cand, before);
+        step_reference(job, ref, i - 1, &stopped);
+        unsigned short pc = ref->pc;
+        unsigned short opcode = opcode_at(ref->memory, pc);
+        step_reference(job, ref, 1, &stopped);
+        chip8_tick_timers(ref);
+        ref->frame_count++;
+
+        run_candidate_frame(cand, lane, i);
+        if (chip8_state_hash(ref) != chip8_state_hash(cand)) {
+            job->exact = 1;
+            job->at = base + i - 1;
+            job->pc = pc;
+            job->opcode = opcode;
+            describe(ref, cand, job->what, sizeof job->what);
+            return;
+        }
+    }
+}
+
+// Runs one rom on one engine and the reference, frame by frame like the frontend (the keys change and the timers
+// tick between frames), comparing every job->every instructions and at the end of every frame.
+// One lane of a lockstep run: the reference it is compared with and where that stood when the frame began
+typedef struct diff_lane {
+    chip8_t ref;
+    chip8_state_t before;
+    unsigned long long checked;
+    unsigned long ran;
+    const char* stopped;
+} diff_lane_t;
+
+// Runs job->lanes lanes of one rom on the lockstep engine, each seeded and pressing keys of its own so they drift
+// apart, against a reference per lane. Compared at the end of every frame. A lane whose reference stopped in front
+// of something lanes don't run stays on it, only its timers go on, and the run ends once all of them have stopped.
+static void run_lockstep_job(diff_job_t* job) {
+    size_t lanes = job->lanes;
+    diff_lane_t* lane = calloc(lanes, sizeof *lane);
+    chip8_t* cand = malloc(sizeof *cand);
+    unsigned char* keys = malloc(lanes * 16);
+    chip8_lockstep_t ls, one;
+    size_t started = 0;
+    int ls_ready = 0, one_ready = 0, cand_ready = 0;
+
+    if (lane == NULL || cand == NULL || keys == NULL) {
+        job->failed = 1;
+        goto done;
+    }
+    while (started < lanes) {
+        chip8_t* ref = &lane[started].ref;
+        int status = start_machine(job, ref, CHIP8_ENGINE_SWITCH);
+        started++;
+        if (status != 0) {
+            job->failed = 1;
+            goto done;
+        }
+        chip8_seed(ref, job->rom->seed + started - 1);
+    }
+    // the candidate is only where a lane gets stored to be hashed
+    cand_ready = 1;
+    if (start_machine(job, cand, CHIP8_ENGINE_SWITCH) == 0)
+        ls_ready = chip8_lockstep_init(&ls, lanes, &lane[0].ref) == 0;
+    if (ls_ready)
+        one_ready = chip8_lockstep_init(&one, 1, &lane[0].ref) == 0;
+    if (!one_ready) {
+        job->failed = 1;
+        goto done;
+    }
+    for (size_t l = 0; l < lanes; l++)
+        chip8_lockstep_load(&ls, l, &lane[l].ref);
+
+    chip8_sched_t sched;
+    chip8_sched_init(&sched, job->ips);
+    size_t running = lanes;
+
+    for (unsigned long left = job->cycles; left > 0 && running > 0; chip8_sched_advance(&sched)) {
+        unsigned long n = chip8_sched_instructions(&sched);
+        if (n > left)
+            n = left;
+        left -= n;
+
+        for (size_t l = 0; l < lanes; l++) {
+            chip8_t* ref = &lane[l].ref;
+
+            set_keys(ref, job->rom->seed + l, ref->frame_count);
+            memcpy(keys + l * 16, ref->keypad, 16);
+            chip8_state_save(ref, &lane[l].before);
+            lane[l].ran = 0;
+            if (!lane[l].stopped) {
+                lane[l].ran = step_reference(job, ref, n, &lane[l].stopped);
+                if (lane[l].stopped)
+                    running--;
+            }
+            chip8_tick_timers(ref);
+            ref->frame_count++;
+        }
+        chip8_lockstep_set_keys(&ls, keys);
+        chip8_lockstep_run_frame(&ls, n);
+
+        for (size_t l = 0; l < lanes; l++) {
+            chip8_lockstep_store(&ls, l, cand);
+            if (chip8_state_hash(&lane[l].ref) != chip8_state_hash(cand)) {
+                job->lane = l;
+                find_frame_divergence(job, &lane[l].ref, cand, &one, &lane[l].before, lane[l].checked, lane[l].ran);
+                goto done;
+            }
+            lane[l].checked += lane[l].ran;
+            job->checked += lane[l].ran;
+        }
+    }
+    if (running == 0)
+        job->stopped = lane[0].stopped;
+
+done:
+    if (one_ready)
+        chip8_lockstep_free(&one);
+    if (ls_ready)
+        chip8_lockstep_free(&ls);
+    if (cand_ready)
+        chip8_destroy(cand);
+    for (size_t l = 0; l < started; l++)
+        chip8_destroy(&lane[l].ref);
+    free(lane);
+    free(cand);
+    free(keys);
+}
+
+static void run_job(void* arg) {
+    diff_job_t* job = arg;
+    if (job->mode == DIFF_LOCKSTEP) {
+        run_lockstep_job(job);
+        return;
+    }
+
+    chip8_t* ref = malloc(sizeof *ref);
+    chip8_t* cand = malloc(sizeof *cand);
+    chip8_state_t* before = malloc(sizeof *before);
+
+    if (ref == NULL || cand == NULL || before == NULL) {
+        job->failed = 1;
+        free(ref);
+        free(cand);
+        free(before);
+        return;
+    }
+    if (start_machine(job, ref, CHIP8_ENGINE_SWITCH) != 0 || start_machine(job, cand, job->engine) != 0) {
+        job->failed = 1;
+        goto done;
+    }
+
+    chip8_sched_t sched;
+    chip8_sched_init(&sched, job->ips);
+
+    for (unsigned long left = job->cycles; left > 0 && !job->stopped; chip8_sched_advance(&sched)) {
+        unsigned long n = chip8_sched_instructions(&sched);
+        if (n > left)
+            n = left;
+        left -= n;
+        set_keys(ref, job->rom->seed, ref->frame_count);
+        memcpy(cand->keypad, ref->keypad, sizeof cand->keypad);
+
+        if (job->mode == DIFF_FRAME) {
+            chip8_state_save(ref, before);
+            unsigned long ran = step_reference(job, ref, n, &job->stopped);
+            chip8_tick_timers(ref);
+            ref->frame_count++;
+
+            // the candidate would run into the unknown opcode, so the frame the reference stopped in is stepped
+            if (ran == n) {
+                chip8_run_frame(cand, n);
+            } else {
+                if (ran > 0)
+                    chip8_step(cand, ran);
+                chip8_tick_timers(cand);
+                cand->frame_count++;
+            }
+
+            if (chip8_state_hash(ref) != chip8_state_hash(cand)) {
+                find_frame_divergence(job, ref, cand, NULL, before, job->checked, ran);
+                goto done;
+            }
+            job->checked += ran;
+            continue;
+        }
+
+        while (n > 0 && !job->stopped) {
+            unsigned long piece = n < job->every ? n : job->every;
+
+            chip8_state_save(ref, before);
+            unsigned long ran = step_reference(job, ref, piece, &job->stopped);
+            if (ran > 0)
+                chip8_step(cand, ran);
+
+            if (chip8_state_hash(ref) != chip8_state_hash(cand)) {
+                find_divergence(job, ref, cand, before, job->checked, ran);
+                goto done;
+            }
+            job->checked += ran;
+            n -= piece;
+        }
+
+        chip8_tick_timers(ref);
+        chip8_tick_timers(cand);
+        ref->frame_count++;
+        cand->frame_count++;
+    }
+
+done:
+    chip8_destroy(ref);
+    chip8_destroy(cand);
+    free(ref);
+    free(cand);
+    free(before);
+}
+
+static void usage(void) {
+    printf("usage: chip8-difftest [-j threads] [-k every] [-c cycles] [-i ips] [-e engine | -f | -l lanes]\n");
+    printf("                      [-q platform] [-r streams] [-s seed] [-v] [rom.ch8 ...]\n");
+    printf("  -j N   worker threads (default: one per core)\n");
+    printf("  -k N   compare the state hashes every N instructions (default 1000)\n");
+    printf("  -c N   instructions per run (default 1000000)\n");
+    printf("  -i N   instructions per second of emulated time, the timers tick every ips / 60 (default 60000)\n");
+    printf("  -e E   check only this engine (table, threaded, cached, jit, aot), default all of them\n");
+    printf("  -f     run the candidates frame by frame with chip8_run_frame(), idle loop skipping included\n");
+    printf("  -l N   check N lanes of the lockstep engine instead, on the default platform only\n");
+    printf("  -q P   run only on this platform (default, vip, chip48, schip, xochip), default all of them\n");
+    printf("  -r N   also run N randomly generated roms\n");
+    printf("  -s N   seed of the first generated rom, the next ones get N + 1, ... (default 1)\n");
+    printf("  -v     print every run, not only the ones that diverged\n");
+}
+
+int main(int argc, char** argv) {
+    int threads = 0;
+    unsigned long every = 1000;
+    unsigned long cycles = 1000000;
+    unsigned long ips = 60000;
+    int engine = -1;
+    int platform = -1;
+    diff_mode_t mode = DIFF_STEP;
+    size_t lanes = 0;
+    unsigned long streams = 0;
+    unsigned long long seed = 1;
+    int verbose = 0;
+    int first_rom = 1;
+
+    for (; first_rom < argc && argv[first_rom][0] == '-'; first_rom++) {
+        const char* opt = argv[first_rom];
+
+        if (strcmp(opt, "-v") == 0) {
+            verbose = 1;
+        } else if (strcmp(opt, "-f") == 0) {
+            mode = DIFF_FRAME;
+        } else if (first_rom + 1 < argc && strcmp(opt, "-l") == 0) {
+            mode = DIFF_LOCKSTEP;
+            lanes = strtoul(argv[++first_rom], NULL, 10);
+        } else if (first_rom + 1 < argc && strcmp(opt, "-j") == 0) {
+            threads = atoi(argv[++first_rom]);
+        } else if (first_rom + 1 < argc && strcmp(opt, "-k") == 0) {
+            every = strtoul(argv[++first_rom], NULL, 10);
+        } else if (first_rom + 1 < argc && strcmp(opt, "-c") == 0) {
+            cycles = strtoul(argv[++first_rom], NULL, 10);
+        } else if (first_rom + 1 < argc && strcmp(opt, "-i") == 0) {
+            ips = strtoul(argv[++first_rom], NULL, 10);
+        } else if (first_rom + 1 < argc && strcmp(opt, "-r") == 0) {
+            streams = strtoul(argv[++first_rom], NULL, 10);
+        } else if (first_rom + 1 < argc && strcmp(opt, "-s") == 0) {
+            seed = strtoull(argv[++first_rom], NULL, 10);
+        } else if (first_rom + 1 < argc && strcmp(opt, "-e") == 0) {
+            engine = chip8_engine_from_name(argv[++first_rom]);
+            if (engine <= CHIP8_ENGINE_SWITCH) {
+                usage();
+                return 1;
+            }
+        } else if (first_rom + 1 < argc && strcmp(opt, "-q") == 0) {
+            platform = chip8_platform_from_name(argv[++first_rom]);
+            if (platform < 0) {
+                usage();
+                return 1;
+            }
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    size_t rom_count = (size_t)(argc - first_rom) + streams;
+    // lanes only know the default platform, and there is no engine to pick
+    if (mode == DIFF_LOCKSTEP && (lanes == 0 || engine >= 0 || platform > CHIP8_PLATFORM_DEFAULT))
+        rom_count = 0;
+    if (rom_count == 0 || every == 0 || ips == 0) {
+        usage();
+        return 1;
+    }
+
+    DEBUG = 0;
+
+    rom_image_t* roms = calloc(rom_count, sizeof *roms);
+    if (roms == NULL) {
+        printf("[FAILED] out of memory\n");
+        return 1;
+    }
+    for (int r = 0; r < argc - first_rom; r++) {
+        int status = read_rom(argv[first_rom + r], &roms[r]);
+        if (status != 0) {
+            printf("[FAILED] %s: %s\n", argv[first_rom + r], status == -1 ? "too big for memory" : strerror(status));
+            return 1;
+        }
+    }
+    for (unsigned long r = 0; r < streams; r++)
+        generate_rom(&roms[argc - first_rom + r], seed + r);
+
+    if (mode == DIFF_LOCKSTEP) {
+        engine = CHIP8_ENGINE_SWITCH;
+        platform = CHIP8_PLATFORM_DEFAULT;
+    }
+    size_t engines = engine < 0 ? CHIP8_ENGINE_COUNT - 1 : 1;
+    size_t platforms = platform < 0 ? CHIP8_PLATFORM_COUNT : 1;
+    size_t job_count = rom_count * platforms * engines;
+    diff_job_t* jobs = calloc(job_count, sizeof *jobs);
+    if (jobs == NULL) {
+        printf("[FAILED] out of memory\n");
+        return 1;
+    }
+
+    pool_t* pool = pool_create(threads);
+    if (pool == NULL) {
+        printf("[FAILED] couldn't start the thread pool\n");
+        return 1;
+    }
+    if (mode == DIFF_LOCKSTEP)
+        printf("[OK] %zu roms x %zu lockstep lanes against the switch engine on %d threads\n", rom_count, lanes,
+               pool_threads(pool));
+    else
+        printf("[OK] %zu roms x %zu platforms x %zu engines%s against the switch engine on %d threads\n", rom_count,
+               platforms, engines, mode == DIFF_FRAME ? " by frame" : "", pool_threads(pool));
+
+    double start = now_seconds();
+
+    for (size_t j = 0; j < job_count; j++) {
+        jobs[j].rom = &roms[j / (platforms * engines)];
+        jobs[j].mode = mode;
+        jobs[j].lanes = lanes;
+        jobs[j].platform = platform < 0 ? (chip8_platform_t)(j / engines % platforms) : (chip8_platform_t)platform;
+        jobs[j].engine = engine < 0 ? (chip8_engine_t)(CHIP8_ENGINE_SWITCH + 1 + j % engines) : (chip8_engine_t)engine;
+        jobs[j].cycles = cycles;
+        jobs[j].ips = ips;
+        jobs[j].every = every;
+        if (pool_submit(pool, run_job, &jobs[j]) != 0) {
+            pool_wait(pool);
+            pool_destroy(pool);
+            printf("[FAILED] out of memory queueing the runs\n");
+            return 1;
+        }
+    }
+    pool_wait(pool);
+
+    double elapsed = now_seconds() - start;
+    if (elapsed <= 0)
+        elapsed = 1e-9;
+
+    pool_destroy(pool);
+
+    size_t failed = 0;
+    size_t diverged = 0;
+    double checked = 0;
+
+    for (size_t j = 0; j < job_count; j++) {
+        const diff_job_t* job = &jobs[j];
+        const char* platform_name = chip8_platform_name(job->platform);
+        char engine_name[32];
+
+        if (job->mode == DIFF_LOCKSTEP && job->diverged)
+            snprintf(engine_name, sizeof engine_name, "lockstep lane %zu", job->lane);
+        else if (job->mode == DIFF_LOCKSTEP)
+            snprintf(engine_name, sizeof engine_name, "lockstep");
+        else if (job->mode == DIFF_FRAME)
+            snprintf(engine_name, sizeof engine_name, "%s by frame", chip8_engine_name(job->engine));
+        else
+            snprintf(engine_name, sizeof engine_name, "%s", chip8_engine_name(job->engine));
+
+        if (job->failed) {
+            printf("[FAILED] %s: couldn't start it\n", job->rom->name);
+            failed++;
+            continue;
+        }
+        checked += (double)job->checked;
+
+        if (job->diverged) {
+            char text[32];
+            chip8_disasm(job->opcode, text, sizeof text);
+            if (job->exact)
+                printf("[FAILED] %s, %s on %s: instruction %llu, pc %03X opcode %04X (%s):%s\n", job->rom->name,
+                       engine_name, platform_name, job->at, job->pc, job->opcode, text, job->what);
+            else if (job->mode != DIFF_STEP)
+                printf("[FAILED] %s, %s on %s: in the frame from instruction %llu, pc %03X opcode %04X (%s), not "
+                       "when cut short:%s\n", job->rom->name, engine_name, platform_name, job->at, job->pc,
+                       job->opcode, text, job->what);
+            else
+                printf("[FAILED] %s, %s on %s: within %lu instructions of %llu, pc %03X opcode %04X (%s), not when "
+                       "single stepping:%s\n", job->rom->name, engine_name, platform_name, job->every, job->at,
+                       job->pc, job->opcode, text, job->what);
+            diverged++;
+        } else if (verbose) {
+            printf("%s, %s on %s: %llu instructions match%s%s\n", job->rom->name, engine_name, platform_name,
+                   job->checked, job->stopped ? ", stopped: " : "", job->stopped ? job->stopped : "");
+        }
+    }
+
+    printf("runs:         %zu (%zu diverged, %zu failed)\n", job_count, diverged, failed);
+    printf("instructions: %.0f\n", checked);
+    printf("wall time:    %.3f s\n", elapsed);
+    printf("instr/sec:    %.0f\n", checked / elapsed);
+
+    free(jobs);
+    free(roms);
+    return diverged != 0 || failed != 0;
+}
@@ -0,0 +1,73 @@
+#include <stdio.h>
+
+#include "disasm.h"
+
+void chip8_disasm(unsigned short opcode, char* buf, size_t size) {
+    unsigned int x = (opcode >> 8) & 0xF;
+    unsigned int y = (opcode >> 4) & 0xF;
+    unsigned int n = opcode & 0xF;
+    unsigned int nn = opcode & 0xFF;
+    unsigned int nnn = opcode & 0xFFF;
+
+    switch (opcode >> 12) {
+        case 0x0:
+            if (opcode == 0x00E0) { snprintf(buf, size, "CLS"); return; }
+            if (opcode == 0x00EE) { snprintf(buf, size, "RET"); return; }
+            if (opcode == 0x00FB) { snprintf(buf, size, "SCR"); return; }
+            if (opcode == 0x00FC) { snprintf(buf, size, "SCL"); return; }
+            if (opcode == 0x00FE) { snprintf(buf, size, "LOW"); return; }
+            if (opcode == 0x00FF) { snprintf(buf, size, "HIGH"); return; }
+            if ((opcode & 0xFFF0) == 0x00C0) { snprintf(buf, size, "SCD %u", n); return; }
+            if ((opcode & 0xFFF0) == 0x00D0) { snprintf(buf, size, "SCU %u", n); return; }
+            break;
+        case 0x1: snprintf(buf, size, "JP 0x%03X", nnn); return;
+        case 0x2: snprintf(buf, size, "CALL 0x%03X", nnn); return;
+        case 0x3: snprintf(buf, size, "SE V%X, 0x%02X", x, nn); return;
+        case 0x4: snprintf(buf, size, "SNE V%X, 0x%02X", x, nn); return;
+        case 0x5:
+            if (n == 0) { snprintf(buf, size, "SE V%X, V%X", x, y); return; }
+            break;
+        case 0x6: snprintf(buf, size, "LD V%X, 0x%02X", x, nn); return;
+        case 0x7: snprintf(buf, size, "ADD V%X, 0x%02X", x, nn); return;
+        case 0x8:
+            switch (n) {
+                case 0x0: snprintf(buf, size, "LD V%X, V%X", x, y); return;
+                case 0x1: snprintf(buf, size, "OR V%X, V%X", x, y); return;
+                case 0x2: snprintf(buf, size, "AND V%X, V%X", x, y); return;
+                case 0x3: snprintf(buf, size, "XOR V%X, V%X", x, y); return;
+                case 0x4: snprintf(buf, size, "ADD V%X, V%X", x, y); return;
+                case 0x5: snprintf(buf, size, "SUB V%X, V%X", x, y); return;
+                case 0x6: snprintf(buf, size, "SHR V%X, V%X", x, y); return;
+                case 0x7: snprintf(buf, size, "SUBN V%X, V%X", x, y); return;
+                case 0xE: snprintf(buf, size, "SHL V%X, V%X", x, y); return;
+            }
+            break;
+        case 0x9:
+            if (n == 0) { snprintf(buf, size, "SNE V%X, V%X", x, y); return; }
+            break;
+        case 0xA: snprintf(buf, size, "LD I, 0x%03X", nnn); return;
+        case 0xB: snprintf(buf, size, "JP V0, 0x%03X", nnn); return;
+        case 0xC: snprintf(buf, size, "RND V%X, 0x%02X", x, nn); return;
+        case 0xD: snprintf(buf, size, "DRW V%X, V%X, %u", x, y, n); return;
+        case 0xE:
+            if (nn == 0x9E) { snprintf(buf, size, "SKP V%X", x); return; }
+            if (nn == 0xA1) { snprintf(buf, size, "SKNP V%X", x); return; }
+            break;
+        case 0xF:
+            switch (nn) {
+                case 0x01: snprintf(buf, size, "PLANE %u", x); return;
+                case 0x07: snprintf(buf, size, "LD V%X, DT", x); return;
+                case 0x0A: snprintf(buf, size, "LD V%X, K", x); return;
+                case 0x15: snprintf(buf, size, "LD DT, V%X", x); return;
+                case 0x18: snprintf(buf, size, "LD ST, V%X", x); return;
+                case 0x1E: snprintf(buf, size, "ADD I, V%X", x); return;
+                case 0x29: snprintf(buf, size, "LD F, V%X", x); return;
+                case 0x33: snprintf(buf, size, "LD B, V%X", x); return;
+                case 0x55: snprintf(buf, size, "LD [I], V%X", x); return;
+                case 0x65: snprintf(buf, size, "LD V%X, [I]", x); return;
+            }
+            break;
+    }
+
+    snprintf(buf, size, "DW 0x%04X", opcode);
+}
@@ -0,0 +1,13 @@
+//
+// CHIP-8 disassembler, mnemonics as in Cowgod's technical reference.
+//
+
+#ifndef CHIP8_EMU_DISASM_H
+#define CHIP8_EMU_DISASM_H
+
+#include <stddef.h>
+
+// Writes the mnemonic for opcode into buf, e.g. "LD V3, 0x2A". Unknown opcodes come out as "DW 0xNNNN".
+void chip8_disasm(unsigned short opcode, char* buf, size_t size);
+
+#endif //CHIP8_EMU_DISASM_H
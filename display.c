@@ -0,0 +1,165 @@
+#include <string.h>
+
+#include "display.h"
+#include "quirks.h"
+
+// A sprite row (cols pixels wide, leftmost pixel in the top bit of the cols-bit value) moved to x on a row width
+// pixels wide: out[0] gets pixels 0-63, out[1] pixels 64-127. Past the right edge it wraps round to the left,
+// unless clipping.
+static void place_row(uint64_t bits, unsigned int cols, unsigned int x, unsigned int width, int clip,
+                      uint64_t out[2]) {
+    uint64_t top = bits << (64 - cols);
+
+    if (width == 64) {
+        out[0] = clip ? top >> x : (top >> x) | (top << ((64 - x) & 63));
+        out[1] = 0;
+        return;
+    }
+
+    if (x < 64) {
+        out[0] = top >> x;
+        out[1] = x ? top << (64 - x) : 0;
+    } else {
+        out[0] = 0;
+        out[1] = top >> (x - 64);
+    }
+    // the k rightmost pixels of the sprite fell off the end
+    if (!clip && x + cols > 128) {
+        unsigned int k = x + cols - 128;
+        out[0] |= (bits & ((1ULL << k) - 1)) << (64 - k);
+    }
+}
+
+void chip8_display_draw(chip8_t* c, const chip8_decoded_t* d, unsigned int quirks) {
+    unsigned int width = chip8_display_width(c);
+    unsigned int height = chip8_display_height(c);
+    unsigned int x0 = c->V[d->x] & (width - 1);
+    unsigned int y0 = c->V[d->y] & (height - 1);
+    unsigned int rows = d->n ? d->n : 16;
+    unsigned int cols = d->n ? 8 : 16;
+    int clip = (quirks & CHIP8_QUIRK_CLIP) != 0;
+    unsigned int addr = c->I;
+    uint64_t collision = 0;
+
+    for (int p = 0; p < CHIP8_PLANES; p++) {
+        if (!(c->planes & (1 << p)))
+            continue;
+
+        for (unsigned int r = 0; r < rows; r++) {
+            unsigned int y = y0 + r;
+            if (y >= height) {
+                if (clip)
+                    break;
+                y -= height;
+            }
+
+            // a sprite running off the end of memory wraps round to the start
+            uint64_t bits = cols == 8 ? c->memory[(addr + r) & 0xFFF]
+                                      : (uint64_t)c->memory[(addr + 2 * r) & 0xFFF] << 8 |
+                                        c->memory[(addr + 2 * r + 1) & 0xFFF];
+            uint64_t row[2];
+            place_row(bits, cols, x0, width, clip, row);
+
+            uint64_t* left = &c->display[p][0][y];
+            uint64_t* right = &c->display[p][1][y];
+            collision |= (*left & row[0]) | (*right & row[1]);
+            *left ^= row[0];
+            *right ^= row[1];
+            c->dirty_rows |= 1ULL << y;
+        }
+        // the next plane's sprite comes right after this one
+        addr += rows * cols / 8;
+    }
+
+    c->V[0xF] = collision != 0;
+    c->draw_flag = 1;
+}
+
+void chip8_display_clear(chip8_t* c) {
+    for (int p = 0; p < CHIP8_PLANES; p++)
+        if (c->planes & (1 << p))
+            memset(c->display[p], 0, sizeof c->display[p]);
+    c->dirty_rows = UINT64_MAX;
+}
+
+// In lo-res only the left word of each row is on screen
+static unsigned int words(const chip8_t* c) {
+    return c->hires ? 2 : 1;
+}
+
+void chip8_display_scroll_down(chip8_t* c, unsigned int rows) {
+    unsigned int height = chip8_display_height(c);
+
+    for (int p = 0; p < CHIP8_PLANES; p++) {
+        if (!(c->planes & (1 << p)))
+            continue;
+        for (unsigned int w = 0; w < words(c); w++) {
+            uint64_t* column = c->display[p][w];
+            memmove(column + rows, column, (height - rows) * sizeof *column);
+            memset(column, 0, rows * sizeof *column);
+        }
+    }
+    c->dirty_rows = UINT64_MAX;
+    c->draw_flag = 1;
+}
+
+void chip8_display_scroll_up(chip8_t* c, unsigned int rows) {
+    unsigned int height = chip8_display_height(c);
+
+    for (int p = 0; p < CHIP8_PLANES; p++) {
+        if (!(c->planes & (1 << p)))
+            continue;
+        for (unsigned int w = 0; w < words(c); w++) {
+            uint64_t* column = c->display[p][w];
+            memmove(column, column + rows, (height - rows) * sizeof *column);
+            memset(column + height - rows, 0, rows * sizeof *column);
+        }
+    }
+    c->dirty_rows = UINT64_MAX;
+    c->draw_flag = 1;
+}
+
+void chip8_display_scroll_right(chip8_t* c) {
+    unsigned int height = chip8_display_height(c);
+
+    for (int p = 0; p < CHIP8_PLANES; p++) {
+        if (!(c->planes & (1 << p)))
+            continue;
+        uint64_t* left = c->display[p][0];
+        uint64_t* right = c->display[p][1];
+        for (unsigned int y = 0; y < height; y++) {
+            if (c->hires)
+                right[y] = right[y] >> 4 | left[y] << 60;
+            left[y] >>= 4;
+        }
+    }
+    c->dirty_rows = UINT64_MAX;
+    c->draw_flag = 1;
+}
+
+void chip8_display_scroll_left(chip8_t* c) {
+    unsigned int height = chip8_display_height(c);
+
+    for (int p = 0; p < CHIP8_PLANES; p++) {
+        if (!(c->planes & (1 << p)))
+            continue;
+        uint64_t* left = c->display[p][0];
+        uint64_t* right = c->display[p][1];
+        for (unsigned int y = 0; y < height; y++) {
+            left[y] <<= 4;
+            if (c->hires) {
+                left[y] |= right[y] >> 60;
+                right[y] <<= 4;
+            }
+        }
+    }
+    c->dirty_rows = UINT64_MAX;
+    c->draw_flag = 1;
+}
+
+void chip8_display_set_hires(chip8_t* c, int hires) {
+    c->hires = hires != 0;
+    memset(c->display, 0, sizeof c->display);
+    c->dirty_rows = UINT64_MAX;
+    c->draw_flag = 1;
+}
@@ -0,0 +1,30 @@
+//
+// SUPER-CHIP / XO-CHIP display instructions for the table driven engines: everything but the plain lo-res DXYN on
+// plane 0, which stays inline in ops.h so CHIP-8 roms run exactly as fast as before. These work a row of words at
+// a time on the bit planes in chip8_t.display; emulate_cycle() has its own pixel at a time versions they are
+// checked against.
+//
+
+#ifndef CHIP8_EMU_DISPLAY_H
+#define CHIP8_EMU_DISPLAY_H
+
+#include "chip8.h"
+
+// DXYN in hi-res, with more than plane 0 selected, or DXY0 (a 16x16 sprite) at all. With both planes selected the
+// sprite for plane 1 follows the one for plane 0 in memory. Doesn't move the pc.
+void chip8_display_draw(chip8_t* chip8, const chip8_decoded_t* d, unsigned int quirks);
+
+// 00E0 on the selected planes
+void chip8_display_clear(chip8_t* chip8);
+
+// 00CN / 00DN: the selected planes move down / up by rows pixels, what comes in is blank
+void chip8_display_scroll_down(chip8_t* chip8, unsigned int rows);
+void chip8_display_scroll_up(chip8_t* chip8, unsigned int rows);
+// 00FB / 00FC: the selected planes move right / left by 4 pixels
+void chip8_display_scroll_right(chip8_t* chip8);
+void chip8_display_scroll_left(chip8_t* chip8);
+
+// 00FE / 00FF. Switching clears every plane, like XO-CHIP does.
+void chip8_display_set_hires(chip8_t* chip8, int hires);
+
+#endif //CHIP8_EMU_DISPLAY_H
@@ -0,0 +1,72 @@
+#include "engine.h"
+#include "decode.h"
+#include "ops.h"
+#include "profile.h"
+#include "quirks.h"
+#include "trace.h"
+
+// Fetch, look the opcode up in the pre-decoded table, run the handler for it. The fetch wraps at 4K like
+// emulate_cycle()'s, so what the cached core stores under icache[pc & 0xFFF] is what is at that address.
+#define FETCH(c) (&chip8_decoded[(c)->memory[(c)->pc & 0xFFF] << 8 | (c)->memory[((c)->pc + 1) & 0xFFF]])
+
+#ifdef CHIP8_HOOK_PC
+#define SAVE_PC(c) unsigned short op_pc = (c)->pc
+#else
+#define SAVE_PC(c) do { } while (0)
+#endif
+
+void chip8_run_switch(chip8_t* c, unsigned long n) {
+    while (n--)
+        emulate_cycle(c);
+}
+
+// The cores, once per platform: run_table_VIP() and so on, each with CORE_QUIRKS the platform's CHIP8_QUIRKS_*
+#define CORE_PASTE(a, b, c) a##_##b##_##c
+#define CORE_NAME(name, platform) CORE_PASTE(run, name, platform)
+#define CORE(name) CORE_NAME(name, CORE_PLATFORM)
+#define CORE_QUIRKS_OF(platform) CHIP8_QUIRKS_##platform
+#define CORE_QUIRKS_EXPAND(platform) CORE_QUIRKS_OF(platform)
+#define CORE_QUIRKS CORE_QUIRKS_EXPAND(CORE_PLATFORM)
+
+#define CORE_PLATFORM DEFAULT
+#include "engine_core.h"
+#undef CORE_PLATFORM
+
+#define CORE_PLATFORM VIP
+#include "engine_core.h"
+#undef CORE_PLATFORM
+
+#define CORE_PLATFORM CHIP48
+#include "engine_core.h"
+#undef CORE_PLATFORM
+
+#define CORE_PLATFORM SCHIP
+#include "engine_core.h"
+#undef CORE_PLATFORM
+
+#define CORE_PLATFORM XOCHIP
+#include "engine_core.h"
+#undef CORE_PLATFORM
+
+typedef void (*core_fn)(chip8_t* c, unsigned long n);
+
+// which core runs is picked once per chip8_step(), not per instruction
+#define CORES(name) { CHIP8_PLATFORM_LIST(name) }
+#define TABLE_CORE(NAME, name) CORE_NAME(table, NAME),
+#define THREADED_CORE(NAME, name) CORE_NAME(threaded, NAME),
+#define CACHED_CORE(NAME, name) CORE_NAME(cached, NAME),
+static const core_fn table_cores[CHIP8_PLATFORM_COUNT] = CORES(TABLE_CORE);
+static const core_fn threaded_cores[CHIP8_PLATFORM_COUNT] = CORES(THREADED_CORE);
+static const core_fn cached_cores[CHIP8_PLATFORM_COUNT] = CORES(CACHED_CORE);
+
+void chip8_run_table(chip8_t* c, unsigned long n) {
+    table_cores[c->platform](c, n);
+}
+
+void chip8_run_threaded(chip8_t* c, unsigned long n) {
+    threaded_cores[c->platform](c, n);
+}
+
+void chip8_run_cached(chip8_t* c, unsigned long n) {
+    cached_cores[c->platform](c, n);
+}
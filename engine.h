@@ -0,0 +1,15 @@
+//
+// The interpreter engines behind chip8_step(). Internal to the core, pick one with chip8_t.engine instead.
+//
+
+#ifndef CHIP8_EMU_ENGINE_H
+#define CHIP8_EMU_ENGINE_H
+
+#include "chip8.h"
+
+void chip8_run_switch(chip8_t* chip8, unsigned long n);
+void chip8_run_table(chip8_t* chip8, unsigned long n);
+void chip8_run_threaded(chip8_t* chip8, unsigned long n);
+void chip8_run_cached(chip8_t* chip8, unsigned long n);
+
+#endif //CHIP8_EMU_ENGINE_H
@@ -0,0 +1,128 @@
+//
+// Interpreter core template, no include guard on purpose: engine.c includes it once per platform, with
+// CORE(name) naming the functions for the platform and CORE_QUIRKS its quirk flags. The flags are a constant in
+// every copy, so the quirk branches in ops.h fold away and each platform gets its own straight-line handlers.
+//
+
+// Table engine: one switch on the handler number instead of the nested switches on the opcode
+static void CORE(table)(chip8_t* c, unsigned long n) {
+    while (n--) {
+        const chip8_decoded_t* d = FETCH(c);
+        SAVE_PC(c);
+
+        switch (d->op) {
+#define CASE(name, handler) case CHIP8_OP_##name: chip8_op_##handler(c, d, CORE_QUIRKS); break;
+            CHIP8_OP_LIST(CASE)
+#undef CASE
+        }
+
+        chip8_trace_op(c, op_pc, d->opcode);
+        chip8_profile_op(c, op_pc, d->opcode);
+    }
+}
+
+#if defined(__GNUC__)
+// Threaded engine: same table, but every handler ends in its own indirect jump to the next handler (computed goto)
+// instead of going back round a loop to one shared switch. That gives the branch predictor one jump per handler to
+// learn, which is where most of the win over the switch comes from.
+static void CORE(threaded)(chip8_t* c, unsigned long n) {
+#define LABEL(name, handler) [CHIP8_OP_##name] = &&op_##handler,
+    static const void* const labels[CHIP8_OP_COUNT] = { CHIP8_OP_LIST(LABEL) };
+#undef LABEL
+    const chip8_decoded_t* d;
+#ifdef CHIP8_HOOK_PC
+    unsigned short op_pc;
+#endif
+
+    if (n == 0)
+        return;
+
+#ifdef CHIP8_HOOK_PC
+#define DISPATCH() do { d = FETCH(c); op_pc = c->pc; goto *labels[d->op]; } while (0)
+#else
+#define DISPATCH() do { d = FETCH(c); goto *labels[d->op]; } while (0)
+#endif
+
+#define NEXT()                                   \
+    do {                                         \
+        chip8_trace_op(c, op_pc, d->opcode);     \
+        chip8_profile_op(c, op_pc, d->opcode);   \
+        if (--n == 0) return;                    \
+        DISPATCH();                              \
+    } while (0)
+
+    DISPATCH();
+
+#define HANDLER(name, handler) op_##handler: chip8_op_##handler(c, d, CORE_QUIRKS); NEXT();
+    CHIP8_OP_LIST(HANDLER)
+#undef HANDLER
+#undef NEXT
+#undef DISPATCH
+}
+
+// Cached engine: the threaded engine, but fetching from the per-pc decode cache instead of memory. Entries start
+// out (and get invalidated back to) op == CHIP8_OP_COUNT, which lands on op_decode: fill the entry from memory and
+// dispatch again. In a hot loop every instruction after the first pass is one load from icache.
+static void CORE(cached)(chip8_t* c, unsigned long n) {
+#define LABEL(name, handler) [CHIP8_OP_##name] = &&op_##handler,
+    static const void* const labels[CHIP8_OP_COUNT + 1] = { CHIP8_OP_LIST(LABEL) [CHIP8_OP_COUNT] = &&op_decode };
+#undef LABEL
+    const chip8_decoded_t* d;
+#ifdef CHIP8_HOOK_PC
+    unsigned short op_pc;
+#endif
+
+    if (n == 0)
+        return;
+
+#ifdef CHIP8_HOOK_PC
+#define DISPATCH() do { d = &c->icache[c->pc & 0xFFF]; op_pc = c->pc; goto *labels[d->op]; } while (0)
+#else
+#define DISPATCH() do { d = &c->icache[c->pc & 0xFFF]; goto *labels[d->op]; } while (0)
+#endif
+
+#define NEXT()                                   \
+    do {                                         \
+        chip8_trace_op(c, op_pc, d->opcode);     \
+        chip8_profile_op(c, op_pc, d->opcode);   \
+        if (--n == 0) return;                    \
+        DISPATCH();                              \
+    } while (0)
+
+    DISPATCH();
+
+op_decode:
+    c->icache[c->pc & 0xFFF] = *FETCH(c);
+    DISPATCH();
+
+#define HANDLER(name, handler) op_##handler: chip8_op_##handler(c, d, CORE_QUIRKS); NEXT();
+    CHIP8_OP_LIST(HANDLER)
+#undef HANDLER
+#undef NEXT
+#undef DISPATCH
+}
+#else
+// no computed goto outside GCC/Clang, the table engine is the next best thing
+static void CORE(threaded)(chip8_t* c, unsigned long n) {
+    CORE(table)(c, n);
+}
+
+static void CORE(cached)(chip8_t* c, unsigned long n) {
+    while (n--) {
+        chip8_decoded_t* d = &c->icache[c->pc & 0xFFF];
+        SAVE_PC(c);
+
+        if (d->op == CHIP8_OP_COUNT)
+            *d = *FETCH(c);
+
+        switch (d->op) {
+#define CASE(name, handler) case CHIP8_OP_##name: chip8_op_##handler(c, d, CORE_QUIRKS); break;
+            CHIP8_OP_LIST(CASE)
+#undef CASE
+        }
+
+        chip8_trace_op(c, op_pc, d->opcode);
+        chip8_profile_op(c, op_pc, d->opcode);
+    }
+}
+#endif
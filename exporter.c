@@ -0,0 +1,196 @@
+//
+// Headless video exporter. Runs a rom for a number of frames with no window and no throttle, and streams the
+// display out as raw 1-bit frames, y4m, or png snapshots (see video.h). A frame only goes out when it changed the
+// display, unless -a asks for every one. With -o - the video goes to stdout, ready to pipe into ffmpeg; the
+// messages go to stderr then.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "movie.h"
+#include "quirks.h"
+#include "sched.h"
+#include "timing.h"
+#include "video.h"
+
+static void usage(void) {
+    fprintf(stderr, "usage: chip8-export rom.ch8 -o out [-F raw|y4m|png] [-f frames | -m movie] [-i ips] [-s scale]\n");
+    fprintf(stderr, "                    [-n every] [-a] [-q platform] [-H] [-T]\n");
+    fprintf(stderr, "  -o F   output file, - for stdout. For png the file name prefix, frame numbers get appended\n");
+    fprintf(stderr, "  -F X   raw (64x32 / 128x64 monob), y4m (mono, scaled) or png (1-bit snapshots), default y4m\n");
+    fprintf(stderr, "  -H     128x64 video for SUPER-CHIP / XO-CHIP roms, lo-res frames get their pixels doubled.\n");
+    fprintf(stderr, "         Without it hi-res frames are sampled down to 64x32\n");
+    fprintf(stderr, "  -f N   run N 60 Hz frames (default 600)\n");
+    fprintf(stderr, "  -m F   replay the movie F (its frames, input, seed, ips and platform)\n");
+    fprintf(stderr, "  -i N   instructions per second of emulated time (default %d)\n", CHIP8_DEFAULT_IPS);
+    fprintf(stderr, "  -T     pace the frames by the COSMAC VIP timing model instead (see timing.h)\n");
+    fprintf(stderr, "  -s N   scale y4m and png up N times (default 1)\n");
+    fprintf(stderr, "  -n N   only write every Nth frame that goes out, for periodic png snapshots (default 1)\n");
+    fprintf(stderr, "  -a     write every frame, not only the ones that changed the display, so the video keeps\n");
+    fprintf(stderr, "         real time at 60 fps\n");
+    fprintf(stderr, "  -q P   quirks of platform P (default, vip, chip48, schip, xochip), default is default\n");
+}
+
+int main(int argc, char** argv) {
+    const char* out_file = NULL;
+    const char* movie_file = NULL;
+    int format = CHIP8_VIDEO_Y4M;
+    unsigned long long max_frames = 600;
+    unsigned long ips = CHIP8_DEFAULT_IPS;
+    unsigned long scale = 1;
+    unsigned long long every = 1;
+    int all_frames = 0;
+    int hires = 0;
+    int platform = CHIP8_PLATFORM_DEFAULT;
+
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            out_file = argv[++i];
+        } else if (strcmp(argv[i], "-F") == 0 && i + 1 < argc) {
+            format = chip8_video_format_from_name(argv[++i]);
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            max_frames = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            movie_file = argv[++i];
+        } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            ips = strtoul(argv[++i], NULL, 10);
+            if (ips == 0) {
+                usage();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-T") == 0) {
+            ips = 0;
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            scale = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            every = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-a") == 0) {
+            all_frames = 1;
+        } else if (strcmp(argv[i], "-H") == 0) {
+            hires = 1;
+        } else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+            platform = chip8_platform_from_name(argv[++i]);
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    // a scale of 64 is already a 4096x2048 video, 8192x4096 with -H
+    if (out_file == NULL || format < 0 || platform < 0 || scale == 0 || scale > 64 || every == 0) {
+        usage();
+        return 1;
+    }
+
+    DEBUG = 0;
+
+    chip8_movie_t movie;
+    if (movie_file) {
+        int status = chip8_movie_read(&movie, movie_file);
+        if (status != 0) {
+            if (status == -1)
+                fprintf(stderr, "[FAILED] %s is not a movie\n", movie_file);
+            else
+                perror(movie_file);
+            return 1;
+        }
+        ips = movie.ips;
+        max_frames = movie.frames;
+        platform = movie.platform;
+    }
+
+    static chip8_t chip8;
+    chip8_init(&chip8);
+
+    int status = chip8_load_rom(&chip8, argv[1]);
+    if (status == -1) {
+        fprintf(stderr, "[FAILED] the rom is too big for memory.\n");
+        return 1;
+    }
+    else if (status != 0) {
+        perror("Error while loading rom");
+        return 1;
+    }
+
+    if (movie_file) {
+        if (chip8_movie_rom_hash(&chip8) != movie.rom_hash) {
+            fprintf(stderr, "[FAILED] %s was recorded on a different rom\n", movie_file);
+            return 1;
+        }
+        chip8_seed(&chip8, movie.seed);
+    }
+    chip8_set_platform(&chip8, (chip8_platform_t)platform);
+
+    chip8_video_t video;
+    status = chip8_video_open(&video, (chip8_video_format_t)format, out_file, (unsigned int)scale, hires);
+    if (status != 0) {
+        if (status == -1)
+            fprintf(stderr, "[FAILED] out of memory\n");
+        else
+            fprintf(stderr, "%s: %s\n", out_file, strerror(status));
+        return 1;
+    }
+
+    chip8_sched_t sched;
+    chip8_sched_init(&sched, ips);
+
+    // the frame before the first one is the blank screen, so the first frame goes out if anything is on it
+    static uint64_t last_display[CHIP8_PLANES][2][CHIP8_MAX_HEIGHT];
+    unsigned char last_hires = chip8.hires;
+    chip8.dirty_rows = 0;
+    unsigned long long candidates = 0;
+
+    while (chip8.frame_count < max_frames && status == 0) {
+        if (movie_file)
+            chip8_movie_play(&movie, &chip8);
+        // ips 0 is the VIP timing model, from -T or a movie recorded with it
+        if (ips == 0)
+            chip8_run_timed_frame(&chip8);
+        else
+            chip8_run_frame(&chip8, chip8_sched_instructions(&sched));
+        chip8_sched_advance(&sched);
+
+        // dirty_rows is set by every draw, scroll and clear, even one that leaves the screen as it was (a sprite
+        // drawn twice to flicker), so a dirty screen still gets compared with the last one that counted
+        if (!all_frames) {
+            if (chip8.dirty_rows == 0)
+                continue;
+            chip8.dirty_rows = 0;
+            if (chip8.hires == last_hires && memcmp(chip8.display, last_display, sizeof last_display) == 0)
+                continue;
+            memcpy(last_display, chip8.display, sizeof last_display);
+            last_hires = chip8.hires;
+        }
+
+        if (candidates++ % every == 0)
+            status = chip8_video_frame(&video, &chip8);
+    }
+
+    if (status != 0) {
+        if (status == -1)
+            fprintf(stderr, "[FAILED] out of memory\n");
+        else
+            fprintf(stderr, "%s: %s\n", out_file, strerror(status));
+    }
+    int close_status = chip8_video_close(&video);
+    if (close_status != 0 && status == 0) {
+        fprintf(stderr, "%s: %s\n", out_file, strerror(close_status));
+        status = close_status;
+    }
+
+    if (status == 0)
+        fprintf(stderr, "[OK] Wrote %llu of %llu frames to %s\n", video.frames, chip8.frame_count, out_file);
+
+    chip8_destroy(&chip8);
+    if (movie_file)
+        chip8_movie_free(&movie);
+    return status == 0 ? 0 : 1;
+}
@@ -0,0 +1,74 @@
+//
+// Wire protocol of chip8-server, the step API for agents in another process. A client connects to the server's
+// Unix socket (SOCK_SEQPACKET, so every send is exactly one message), opens a set of environments, and then drives
+// them with reset / step / save / load requests. Every request addresses a range of environments at once, so a
+// vectorized agent pays for one round trip per step, not one per environment.
+//
+// Observations don't go over the socket. The answer to OPEN carries a memfd (SCM_RIGHTS) holding one
+// chip8_gym_env_t per environment; the client mmaps it and reads framebuffer, registers and memory in place. The
+// server rewrites an environment's slot before it answers a request that touched it.
+//
+// Everything is in host byte order, both ends are on the same machine.
+//
+
+#ifndef CHIP8_EMU_GYM_H
+#define CHIP8_EMU_GYM_H
+
+#include <stdint.h>
+
+#include "state.h"
+
+#define CHIP8_GYM_DEFAULT_SOCKET "/tmp/chip8.sock"
+// 2: hi-res / XO-CHIP states, 64 dirty rows
+#define CHIP8_GYM_VERSION 2
+
+// environments per connection, and save slots per connection
+#define CHIP8_GYM_MAX_ENVS 1024
+#define CHIP8_GYM_MAX_SLOTS 1024
+
+typedef enum chip8_gym_op {
+    // count environments, seeded seed, seed + 1, ... Has to come first, once. Answered with the memfd.
+    CHIP8_GYM_OPEN = 1,
+    // envs [env, env + count) go back to power on, env + k seeded with seed + k
+    CHIP8_GYM_RESET,
+    // envs [env, env + count) run frames 60 Hz frames each with the keypads that follow the request
+    CHIP8_GYM_STEP,
+    // envs [env, env + count) are saved to slots [slot, slot + count) / loaded back from them
+    CHIP8_GYM_SAVE,
+    CHIP8_GYM_LOAD,
+} chip8_gym_op_t;
+
+typedef enum chip8_gym_status {
+    CHIP8_GYM_OK = 0,
+    CHIP8_GYM_BAD_REQUEST,      // unknown op, wrong size, or a range past the environments / slots
+    CHIP8_GYM_OUT_OF_ORDER,     // anything but OPEN before OPEN, or OPEN twice
+    CHIP8_GYM_EMPTY_SLOT,       // LOAD from a slot nothing was saved to
+    CHIP8_GYM_NO_MEMORY,
+} chip8_gym_status_t;
+
+// 24 bytes. STEP is followed by count uint16_t keypads, bit k set while key k is down.
+typedef struct chip8_gym_request {
+    uint32_t op;
+    uint32_t env;
+    uint32_t count;
+    uint32_t frames;    // STEP
+    uint64_t arg;       // OPEN, RESET: the seed. SAVE, LOAD: the first slot
+} chip8_gym_request_t;
+
+typedef struct chip8_gym_response {
+    uint32_t status;
+    uint32_t version;
+    // OPEN: bytes of the shared region and of one chip8_gym_env_t in it
+    uint64_t size;
+    uint64_t env_size;
+} chip8_gym_response_t;
+
+// One environment's observation, padded to a multiple of 64 bytes so neighbours don't share cache lines
+typedef struct chip8_gym_env {
+    chip8_state_t state;        // display, registers, memory and timers (see state.h)
+    uint64_t dirty_rows;        // display rows drawn to during the last request, bit y is row y
+    uint32_t frames;            // frames run by the last request
+    unsigned char reserved[36];
+} chip8_gym_env_t;
+
+#endif //CHIP8_EMU_GYM_H
@@ -0,0 +1,123 @@
+#include <string.h>
+
+#include "decode.h"
+#include "idle.h"
+
+// The registers an idle loop may touch. Everything else (memory, display, stack, timers, rng) has to stay as it is,
+// which the ops allowed in step() guarantee.
+typedef struct idle_regs {
+    unsigned char V[16];
+    unsigned short I;
+    unsigned short pc;
+} idle_regs_t;
+
+// Runs one instruction on r without touching the machine. Only ops that can't write anything but V, I and pc are
+// allowed, 0 for anything else. These have to match ops.h exactly.
+static int step(const chip8_t* c, idle_regs_t* r, int* reads_timer) {
+    if (r->pc > 0xFFE)
+        return 0;
+
+    const chip8_decoded_t* d = &chip8_decoded[c->memory[r->pc] << 8 | c->memory[r->pc + 1]];
+    unsigned char nn = d->nnn & 0xFF;
+
+    switch (d->op) {
+        case CHIP8_OP_JP:
+            r->pc = d->nnn;
+            break;
+        case CHIP8_OP_SE_VX_NN:
+            r->pc += r->V[d->x] == nn ? 4 : 2;
+            break;
+        case CHIP8_OP_SNE_VX_NN:
+            r->pc += r->V[d->x] != nn ? 4 : 2;
+            break;
+        case CHIP8_OP_SE_VX_VY:
+            r->pc += r->V[d->x] == r->V[d->y] ? 4 : 2;
+            break;
+        case CHIP8_OP_SNE_VX_VY:
+            r->pc += r->V[d->x] != r->V[d->y] ? 4 : 2;
+            break;
+        case CHIP8_OP_SKP:
+            r->pc += c->keypad[r->V[d->x] & 0xF] ? 4 : 2;
+            break;
+        case CHIP8_OP_SKNP:
+            r->pc += !c->keypad[r->V[d->x] & 0xF] ? 4 : 2;
+            break;
+        case CHIP8_OP_LD_VX_NN:
+            r->V[d->x] = nn;
+            r->pc += 2;
+            break;
+        case CHIP8_OP_LD_VX_VY:
+            r->V[d->x] = r->V[d->y];
+            r->pc += 2;
+            break;
+        case CHIP8_OP_LD_I:
+            r->I = d->nnn;
+            r->pc += 2;
+            break;
+        case CHIP8_OP_LD_VX_DT:
+            r->V[d->x] = c->delayTimer;
+            r->pc += 2;
+            *reads_timer = 1;
+            break;
+        case CHIP8_OP_LD_VX_K:
+            for (int i = 0; i < 16; i++) {
+                if (c->keypad[i]) {
+                    r->V[d->x] = i;
+                    r->pc += 2;
+                    break;
+                }
+            }
+            break;
+        default:
+            return 0;
+    }
+
+    return 1;
+}
+
+// Runs r round the loop starting at its pc once. Returns the number of instructions that took, 0 if it didn't come
+// back to the start within CHIP8_IDLE_MAX_LOOP instructions or ran into anything that isn't allowed.
+static unsigned long go_round(const chip8_t* c, idle_regs_t* r, int* reads_timer) {
+    unsigned short start = r->pc;
+
+    for (unsigned long len = 1; len <= CHIP8_IDLE_MAX_LOOP; len++) {
+        if (!step(c, r, reads_timer))
+            return 0;
+        if (r->pc == start)
+            return len;
+    }
+    return 0;
+}
+
+unsigned long chip8_idle_probe(chip8_t* c, unsigned long n) {
+    idle_regs_t r;
+    int reads_timer = 0;
+
+    c->idle = CHIP8_IDLE_NONE;
+
+    memcpy(r.V, c->V, sizeof r.V);
+    r.I = c->I;
+    r.pc = c->pc;
+
+    // The first time round can still change registers (FX07 picks up this frame's timer value), so it takes two:
+    // if the second time round leaves the registers as the first one did, every later one will too.
+    unsigned long first = go_round(c, &r, &reads_timer);
+    if (first == 0)
+        return n;
+
+    idle_regs_t after_first = r;
+    unsigned long len = go_round(c, &r, &reads_timer);
+    if (len == 0 || memcmp(&r, &after_first, sizeof r) != 0)
+        return n;
+
+    c->idle = reads_timer ? CHIP8_IDLE_TIMER : CHIP8_IDLE_KEY;
+
+#ifdef CHIP8_HOOK_PC
+    // tracing and profiling builds want to see every instruction, spinning included
+    return n;
+#else
+    if (n <= first)
+        return n;
+    return first + (n - first) % len;
+#endif
+}
@@ -0,0 +1,20 @@
+//
+// Idle loop detection. A lot of roms sit in a loop that can't get anywhere until a frame boundary: a jump to
+// itself, FX0A with no key down, polling the delay timer (FX07 / 3XNN / 1NNN) or the keypad (EXA1 / 1NNN). Within
+// one frame the timers and the keypad don't change, so once such a loop has gone round and come back to the same
+// registers every further time round is identical, and running what is left of the frame is just a remainder.
+//
+
+#ifndef CHIP8_EMU_IDLE_H
+#define CHIP8_EMU_IDLE_H
+
+#include "chip8.h"
+
+// longest loop (instructions per time round) that gets recognised
+#define CHIP8_IDLE_MAX_LOOP 16
+
+// Looks at where the machine is about to run n instructions and sets chip8->idle. Returns how many of them have to
+// actually run to end up in exactly the same state as running all n: n itself unless this is an idle loop.
+unsigned long chip8_idle_probe(chip8_t* chip8, unsigned long n);
+
+#endif //CHIP8_EMU_IDLE_H
@@ -0,0 +1,614 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "engine.h"
+#include "jit.h"
+#include "ops.h"
+#include "quirks.h"
+
+// the generated code has no per-instruction hooks, so tracing and profiling builds run the cached engine instead
+#if defined(__x86_64__) && defined(__linux__) && !defined(CHIP8_HOOK_PC)
+#define CHIP8_JIT_NATIVE 1
+#include <sys/mman.h>
+#endif
+
+#ifdef CHIP8_JIT_NATIVE
+
+// How the generated code works:
+//
+// Every block is a function  unsigned long block(chip8_t* c, unsigned long budget, unsigned char** exit_site)
+// (rdi, rsi, rdx). Guest registers stay in chip8_t and are worked on in place through [rdi + offset], so there is
+// no register allocation and nothing to write back. The block first checks that the whole block fits in the
+// instruction budget (if not it returns straight away with pc at its start) and takes its length off the budget.
+//
+// A block ends at the first branch, at an instruction the jit doesn't translate, or after JIT_MAX_INSNS. Each
+// statically known successor gets an exit stub:
+//
+//     site: jmp +0               patched to jump straight into the successor once it is compiled (chaining)
+//           mov word [rdi+pc], target
+//           mov [rdx], site      tells the dispatcher which jump to patch
+//           mov rax, rsi         return the budget that is left
+//           ret
+//
+// Instructions that write memory are never translated, so the code can't change under a running block; when the
+// interpreter writes to a byte a block covers, that block is dropped and every jump into it is unpatched.
+//
+// The code buffer is never writable and executable at once (hardened kernels refuse such mappings): it is mapped
+// read-write, and flipped to read-execute with mprotect() before the dispatcher enters it and back to read-write
+// before a compile or a patch. Only when something was written in between, so a warmed up rom doesn't pay for it.
+
+#define JIT_CODE_SIZE (4 << 20)
+#define JIT_MAX_INSNS 64
+#define JIT_MAX_BLOCK_BYTES (JIT_MAX_INSNS * 2 + 2)
+// enough room for the worst case block, so a block never has to be abandoned halfway
+#define JIT_BLOCK_RESERVE (JIT_MAX_INSNS * 48 + 256)
+
+// block_at[] values besides a block number
+#define JIT_NOT_COMPILED 0
+#define JIT_INTERPRET (-1)
+
+typedef unsigned long (*jit_fn)(chip8_t* c, unsigned long budget, unsigned char** exit_site);
+
+typedef struct jit_block {
+    unsigned char* code;
+    unsigned short start;
+    unsigned short end;
+    int incoming;   // head of the list of patched jumps into this block, -1 if none
+} jit_block_t;
+
+typedef struct jit_link {
+    unsigned char* site;
+    int next;
+} jit_link_t;
+
+struct chip8_jit {
+    unsigned char* code;
+    size_t used;
+    // whether code is mapped read-write right now, otherwise it is read-execute
+    int writable;
+    // bumped by every flush, so the dispatcher knows not to patch a jump that was just thrown away
+    unsigned long generation;
+
+    jit_block_t* blocks;
+    int block_count;
+    int block_cap;
+
+    jit_link_t* links;
+    int link_count;
+    int link_cap;
+
+    // block number + 1 for each guest address a block starts at, or JIT_NOT_COMPILED / JIT_INTERPRET
+    int block_at[4096];
+};
+
+// emitting
+
+typedef struct emitter {
+    unsigned char* p;
+} emitter_t;
+
+static void emit8(emitter_t* e, unsigned int v) {
+    *e->p++ = (unsigned char)v;
+}
+
+static void emit16(emitter_t* e, unsigned int v) {
+    emit8(e, v & 0xFF);
+    emit8(e, (v >> 8) & 0xFF);
+}
+
+static void emit32(emitter_t* e, uint32_t v) {
+    memcpy(e->p, &v, 4);
+    e->p += 4;
+}
+
+static void emit64(emitter_t* e, uint64_t v) {
+    memcpy(e->p, &v, 8);
+    e->p += 8;
+}
+
+// opcode bytes followed by a [rdi + disp32] operand, reg is the ModRM reg field (register or /digit)
+static void emit_rdi_op(emitter_t* e, const unsigned char* op, int op_len, int reg, size_t disp) {
+    for (int i = 0; i < op_len; i++)
+        emit8(e, op[i]);
+    emit8(e, 0x80 | (reg << 3) | 7);
+    emit32(e, (uint32_t)disp);
+}
+
+#define RDI_OP(e, reg, disp, ...)                                                           \
+    do {                                                                                    \
+        static const unsigned char op_[] = {__VA_ARGS__};                                   \
+        emit_rdi_op(e, op_, (int)sizeof op_, reg, disp);                                    \
+    } while (0)
+
+#define OFF_V(i) (offsetof(chip8_t, V) + (i))
+#define OFF_I offsetof(chip8_t, I)
+#define OFF_PC offsetof(chip8_t, pc)
+#define OFF_SP offsetof(chip8_t, sp)
+#define OFF_STACK offsetof(chip8_t, stack)
+
+#define REG_AL 0
+#define REG_CL 1
+
+static void emit_load_al(emitter_t* e, int v) {        // mov al, [V + v]
+    RDI_OP(e, REG_AL, OFF_V(v), 0x8A);
+}
+
+static void emit_store_al(emitter_t* e, int v) {       // mov [V + v], al
+    RDI_OP(e, REG_AL, OFF_V(v), 0x88);
+}
+
+static void emit_set_pc(emitter_t* e, unsigned int pc) {  // mov word [pc], imm16
+    RDI_OP(e, 0, OFF_PC, 0x66, 0xC7);
+    emit16(e, pc);
+}
+
+static void emit_return(emitter_t* e) {
+    emit8(e, 0x48); emit8(e, 0x89); emit8(e, 0xF0);    // mov rax, rsi
+    emit8(e, 0xC3);                                     // ret
+}
+
+static void emit_exit_stub(emitter_t* e, unsigned int target) {
+    unsigned char* site = e->p;
+
+    emit8(e, 0xE9);                                     // jmp rel32, falls through until it is linked
+    emit32(e, 0);
+    emit_set_pc(e, target);
+    emit8(e, 0x48); emit8(e, 0xB8);                     // mov rax, site
+    emit64(e, (uint64_t)(uintptr_t)site);
+    emit8(e, 0x48); emit8(e, 0x89); emit8(e, 0x02);    // mov [rdx], rax
+    emit_return(e);
+}
+
+static unsigned char* emit_jcc(emitter_t* e, unsigned int cc) {   // jcc rel32, returns where to patch
+    emit8(e, 0x0F);
+    emit8(e, cc);
+    unsigned char* at = e->p;
+    emit32(e, 0);
+    return at;
+}
+
+static void patch_rel32(unsigned char* at, const unsigned char* target) {
+    int32_t rel = (int32_t)(target - (at + 4));
+    memcpy(at, &rel, 4);
+}
+
+#define CC_JB 0x82
+#define CC_JE 0x84
+#define CC_JNE 0x85
+
+// Straight-line instructions. Each one is written to match ops.h, down to the order registers are read and
+// written in, since x or y can be F.
+static int emit_simple(emitter_t* e, const chip8_decoded_t* d) {
+    int x = d->x, y = d->y;
+
+    switch (d->op) {
+        case CHIP8_OP_LD_VX_NN:
+            RDI_OP(e, 0, OFF_V(x), 0xC6);                  // mov byte [Vx], nn
+            emit8(e, CHIP8_NN(d));
+            return 1;
+        case CHIP8_OP_ADD_VX_NN:
+            RDI_OP(e, 0, OFF_V(x), 0x80);                  // add byte [Vx], nn
+            emit8(e, CHIP8_NN(d));
+            return 1;
+        case CHIP8_OP_LD_VX_VY:
+            emit_load_al(e, y);
+            emit_store_al(e, x);
+            return 1;
+        case CHIP8_OP_OR:
+        case CHIP8_OP_AND:
+        case CHIP8_OP_XOR:
+            emit_load_al(e, x);
+            if (d->op == CHIP8_OP_OR) RDI_OP(e, REG_AL, OFF_V(y), 0x0A);
+            else if (d->op == CHIP8_OP_AND) RDI_OP(e, REG_AL, OFF_V(y), 0x22);
+            else RDI_OP(e, REG_AL, OFF_V(y), 0x32);
+            emit_store_al(e, x);
+            return 1;
+        case CHIP8_OP_ADD_VX_VY:
+            RDI_OP(e, REG_AL, OFF_V(x), 0x0F, 0xB6);       // movzx eax, byte [Vx]
+            RDI_OP(e, REG_CL, OFF_V(y), 0x0F, 0xB6);       // movzx ecx, byte [Vy]
+            emit8(e, 0x01); emit8(e, 0xC8);                // add eax, ecx
+            emit8(e, 0x3D); emit32(e, 0xFF);               // cmp eax, 0xFF
+            RDI_OP(e, 0, OFF_V(0xF), 0x0F, 0x97);          // seta [VF]
+            emit_load_al(e, x);
+            RDI_OP(e, REG_AL, OFF_V(y), 0x02);             // add al, [Vy]
+            emit_store_al(e, x);
+            return 1;
+        case CHIP8_OP_SUB:
+            emit_load_al(e, x);
+            RDI_OP(e, REG_AL, OFF_V(y), 0x3A);             // cmp al, [Vy]
+            RDI_OP(e, 0, OFF_V(0xF), 0x0F, 0x97);          // seta [VF]
+            emit_load_al(e, x);
+            RDI_OP(e, REG_AL, OFF_V(y), 0x2A);             // sub al, [Vy]
+            emit_store_al(e, x);
+            return 1;
+        case CHIP8_OP_SUBN:
+            emit_load_al(e, y);
+            RDI_OP(e, REG_AL, OFF_V(x), 0x3A);             // cmp al, [Vx]
+            RDI_OP(e, 0, OFF_V(0xF), 0x0F, 0x97);          // seta [VF]
+            emit_load_al(e, y);
+            RDI_OP(e, REG_AL, OFF_V(x), 0x2A);             // sub al, [Vx]
+            emit_store_al(e, x);
+            return 1;
+        case CHIP8_OP_SHR:
+            emit_load_al(e, x);
+            emit8(e, 0x24); emit8(e, 0x01);                // and al, 1
+            emit_store_al(e, 0xF);
+            emit_load_al(e, x);
+            emit8(e, 0xD0); emit8(e, 0xE8);                // shr al, 1
+            emit_store_al(e, x);
+            return 1;
+        case CHIP8_OP_SHL:
+            emit_load_al(e, x);
+            emit8(e, 0xC0); emit8(e, 0xE8); emit8(e, 7);   // shr al, 7
+            emit_store_al(e, 0xF);
+            emit_load_al(e, x);
+            emit8(e, 0x00); emit8(e, 0xC0);                // add al, al
+            emit_store_al(e, x);
+            return 1;
+        case CHIP8_OP_LD_I:
+            RDI_OP(e, 0, OFF_I, 0x66, 0xC7);               // mov word [I], nnn
+            emit16(e, d->nnn);
+            return 1;
+        case CHIP8_OP_ADD_I_VX:
+            RDI_OP(e, REG_AL, OFF_V(x), 0x0F, 0xB6);       // movzx eax, byte [Vx]
+            RDI_OP(e, REG_AL, OFF_I, 0x66, 0x01);          // add word [I], ax
+            return 1;
+        case CHIP8_OP_LD_F_VX:
+            RDI_OP(e, REG_AL, OFF_V(x), 0x0F, 0xB6);       // movzx eax, byte [Vx]
+            emit8(e, 0x8D); emit8(e, 0x04); emit8(e, 0x80);  // lea eax, [rax + rax * 4]
+            RDI_OP(e, REG_AL, OFF_I, 0x66, 0x89);          // mov word [I], ax
+            return 1;
+    }
+    return 0;
+}
+
+static int is_terminator(unsigned char op) {
+    switch (op) {
+        case CHIP8_OP_JP:
+        case CHIP8_OP_CALL:
+        case CHIP8_OP_RET:
+        case CHIP8_OP_JP_V0:
+        case CHIP8_OP_SE_VX_NN:
+        case CHIP8_OP_SNE_VX_NN:
+        case CHIP8_OP_SE_VX_VY:
+        case CHIP8_OP_SNE_VX_VY:
+            return 1;
+    }
+    return 0;
+}
+
+// Emits a branch that ends the block
+static void emit_terminator(emitter_t* e, const chip8_decoded_t* d, unsigned int pc) {
+    unsigned char* skip;
+
+    switch (d->op) {
+        case CHIP8_OP_JP:
+            emit_exit_stub(e, d->nnn);
+            return;
+        case CHIP8_OP_CALL:
+            RDI_OP(e, 0, OFF_SP, 0xFE);                    // inc byte [sp]
+            RDI_OP(e, 4, OFF_SP, 0x80);                    // and byte [sp], 0xF
+            emit8(e, 0x0F);
+            RDI_OP(e, REG_AL, OFF_SP, 0x0F, 0xB6);         // movzx eax, byte [sp]
+            emit8(e, 0x66); emit8(e, 0xC7); emit8(e, 0x84); emit8(e, 0x47);   // mov word [rdi + rax*2 + stack], pc
+            emit32(e, (uint32_t)OFF_STACK);
+            emit16(e, pc);
+            emit_exit_stub(e, d->nnn);
+            return;
+        case CHIP8_OP_RET:
+            RDI_OP(e, REG_AL, OFF_SP, 0x0F, 0xB6);         // movzx eax, byte [sp]
+            emit8(e, 0x0F); emit8(e, 0xB7); emit8(e, 0x84); emit8(e, 0x47);   // movzx eax, word [rdi + rax*2 + stack]
+            emit32(e, (uint32_t)OFF_STACK);
+            RDI_OP(e, 1, OFF_SP, 0xFE);                    // dec byte [sp]
+            RDI_OP(e, 4, OFF_SP, 0x80);                    // and byte [sp], 0xF
+            emit8(e, 0x0F);
+            emit8(e, 0x05); emit32(e, 2);                  // add eax, 2
+            RDI_OP(e, REG_AL, OFF_PC, 0x66, 0x89);         // mov word [pc], ax
+            emit_return(e);
+            return;
+        case CHIP8_OP_JP_V0:
+            RDI_OP(e, REG_AL, OFF_V(0), 0x0F, 0xB6);       // movzx eax, byte [V0]
+            emit8(e, 0x05); emit32(e, d->nnn);             // add eax, nnn
+            RDI_OP(e, REG_AL, OFF_PC, 0x66, 0x89);         // mov word [pc], ax
+            emit_return(e);
+            return;
+        case CHIP8_OP_SE_VX_NN:
+        case CHIP8_OP_SNE_VX_NN:
+            RDI_OP(e, 7, OFF_V(d->x), 0x80);               // cmp byte [Vx], nn
+            emit8(e, CHIP8_NN(d));
+            break;
+        case CHIP8_OP_SE_VX_VY:
+        case CHIP8_OP_SNE_VX_VY:
+            emit_load_al(e, d->x);
+            RDI_OP(e, REG_AL, OFF_V(d->y), 0x3A);          // cmp al, [Vy]
+            break;
+    }
+
+    // the skips: fall through to the stub for pc + 4 when the skip is taken
+    int skip_if_equal = d->op == CHIP8_OP_SE_VX_NN || d->op == CHIP8_OP_SE_VX_VY;
+    skip = emit_jcc(e, skip_if_equal ? CC_JNE : CC_JE);
+    emit_exit_stub(e, (pc + 4) & 0xFFFF);
+    patch_rel32(skip, e->p);
+    emit_exit_stub(e, (pc + 2) & 0xFFFF);
+}
+
+// The translations are of the default platform. The ops a quirk changes go to the interpreter under a platform that
+// has the quirk, the interpreter's core for the platform gets them right.
+static int quirked(unsigned char op, unsigned int quirks) {
+    switch (op) {
+        case CHIP8_OP_OR: case CHIP8_OP_AND: case CHIP8_OP_XOR:
+            return (quirks & CHIP8_QUIRK_VF_RESET) != 0;
+        case CHIP8_OP_SHR: case CHIP8_OP_SHL:
+            return (quirks & CHIP8_QUIRK_SHIFT_VY) != 0;
+        case CHIP8_OP_JP_V0:
+            return (quirks & CHIP8_QUIRK_JUMP_VX) != 0;
+    }
+    return 0;
+}
+
+static int translatable(unsigned char op, unsigned int quirks) {
+    if (quirked(op, quirks))
+        return 0;
+
+    switch (op) {
+        case CHIP8_OP_LD_VX_NN: case CHIP8_OP_ADD_VX_NN: case CHIP8_OP_LD_VX_VY:
+        case CHIP8_OP_OR: case CHIP8_OP_AND: case CHIP8_OP_XOR:
+        case CHIP8_OP_ADD_VX_VY: case CHIP8_OP_SUB: case CHIP8_OP_SUBN:
+        case CHIP8_OP_SHR: case CHIP8_OP_SHL:
+        case CHIP8_OP_LD_I: case CHIP8_OP_ADD_I_VX: case CHIP8_OP_LD_F_VX:
+            return 1;
+    }
+    return is_terminator(op);
+}
+
+static const chip8_decoded_t* decode_at(const chip8_t* c, unsigned int pc) {
+    return &chip8_decoded[c->memory[pc] << 8 | c->memory[pc + 1]];
+}
+
+// block bookkeeping
+
+void chip8_jit_flush(chip8_jit_t* j) {
+    j->generation++;
+    j->used = 0;
+    j->block_count = 0;
+    j->link_count = 0;
+    memset(j->block_at, 0, sizeof j->block_at);
+}
+
+// -1 if the kernel won't have it
+static int code_writable(chip8_jit_t* j) {
+    if (!j->writable && mprotect(j->code, JIT_CODE_SIZE, PROT_READ | PROT_WRITE) != 0)
+        return -1;
+    j->writable = 1;
+    return 0;
+}
+
+static int code_executable(chip8_jit_t* j) {
+    if (j->writable && mprotect(j->code, JIT_CODE_SIZE, PROT_READ | PROT_EXEC) != 0)
+        return -1;
+    j->writable = 0;
+    return 0;
+}
+
+static chip8_jit_t* jit_create(void) {
+    chip8_jit_t* j = calloc(1, sizeof *j);
+    if (j == NULL) return NULL;
+
+    void* code = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) {
+        free(j);
+        return NULL;
+    }
+    j->code = code;
+    j->writable = 1;
+
+    return j;
+}
+
+void chip8_jit_free(chip8_jit_t* j) {
+    if (j == NULL) return;
+
+    munmap(j->code, JIT_CODE_SIZE);
+    free(j->blocks);
+    free(j->links);
+    free(j);
+}
+
+static void kill_block(chip8_jit_t* j, int start) {
+    jit_block_t* b = &j->blocks[j->block_at[start] - 1];
+
+    // the jumps into it can't be unpatched, so nothing may be entered anymore that could reach it
+    if (b->incoming >= 0 && code_writable(j) != 0) {
+        chip8_jit_flush(j);
+        return;
+    }
+
+    // anything chained into it goes back to exiting to the dispatcher
+    for (int l = b->incoming; l >= 0; l = j->links[l].next) {
+        unsigned char* site = j->links[l].site;
+        patch_rel32(site + 1, site + 5);
+    }
+    b->incoming = -1;
+    j->block_at[start] = JIT_NOT_COMPILED;
+}
+
+void chip8_jit_invalidate(chip8_jit_t* j, unsigned int addr, unsigned int len) {
+    for (unsigned int a = addr; a != addr + len; a++) {
+        unsigned int byte = a & 0xFFF;
+        int first = (int)byte - JIT_MAX_BLOCK_BYTES;
+
+        for (int s = first < 0 ? 0 : first; s <= (int)byte; s++) {
+            int at = j->block_at[s];
+
+            if (at > 0 && j->blocks[at - 1].end > byte)
+                kill_block(j, s);
+            else if (at == JIT_INTERPRET && s + 1 >= (int)byte)
+                j->block_at[s] = JIT_NOT_COMPILED;
+        }
+    }
+}
+
+static void add_link(chip8_jit_t* j, jit_block_t* target, unsigned char* site) {
+    // not linking only costs a trip through the dispatcher
+    if (code_writable(j) != 0)
+        return;
+    if (j->link_count == j->link_cap) {
+        j->link_cap = j->link_cap ? j->link_cap * 2 : 256;
+        j->links = realloc(j->links, j->link_cap * sizeof *j->links);
+    }
+    j->links[j->link_count].site = site;
+    j->links[j->link_count].next = target->incoming;
+    target->incoming = j->link_count++;
+
+    patch_rel32(site + 1, target->code);
+}
+
+// Translates the block starting at pc, or returns NULL if the first instruction can't be translated
+static jit_block_t* compile_block(chip8_jit_t* j, const chip8_t* c, unsigned int pc) {
+    unsigned int quirks = chip8_platform_quirks[c->platform];
+
+    if (pc >= 4095 || !translatable(decode_at(c, pc)->op, quirks)) {
+        j->block_at[pc & 0xFFF] = JIT_INTERPRET;
+        return NULL;
+    }
+
+    if (j->used + JIT_BLOCK_RESERVE > JIT_CODE_SIZE || j->block_count == 65536)
+        chip8_jit_flush(j);
+    if (code_writable(j) != 0) {
+        j->block_at[pc] = JIT_INTERPRET;
+        return NULL;
+    }
+
+    if (j->block_count == j->block_cap) {
+        j->block_cap = j->block_cap ? j->block_cap * 2 : 256;
+        j->blocks = realloc(j->blocks, j->block_cap * sizeof *j->blocks);
+    }
+
+    // count the instructions first, the entry check needs the length
+    unsigned int end = pc;
+    unsigned int len = 0;
+    const chip8_decoded_t* last = NULL;
+    while (len < JIT_MAX_INSNS && end < 4095) {
+        const chip8_decoded_t* d = decode_at(c, end);
+        if (!translatable(d->op, quirks))
+            break;
+        len++;
+        end += 2;
+        if (is_terminator(d->op)) {
+            last = d;
+            break;
+        }
+    }
+
+    emitter_t e = { j->code + j->used };
+    jit_block_t* b = &j->blocks[j->block_count];
+    b->code = e.p;
+    b->start = (unsigned short)pc;
+    b->end = (unsigned short)end;
+    b->incoming = -1;
+
+    emit8(&e, 0x48); emit8(&e, 0x81); emit8(&e, 0xFE); emit32(&e, len);   // cmp rsi, len
+    unsigned char* bail = emit_jcc(&e, CC_JB);
+    emit8(&e, 0x48); emit8(&e, 0x81); emit8(&e, 0xEE); emit32(&e, len);   // sub rsi, len
+
+    unsigned int at = pc;
+    for (unsigned int i = 0; i < len; i++, at += 2) {
+        const chip8_decoded_t* d = decode_at(c, at);
+        if (d == last)
+            emit_terminator(&e, d, at);
+        else
+            emit_simple(&e, d);
+    }
+    if (last == NULL)
+        emit_exit_stub(&e, end);
+
+    patch_rel32(bail, e.p);
+    emit_set_pc(&e, pc);
+    emit_return(&e);
+
+    j->used = (size_t)(e.p - j->code);
+    j->block_at[pc] = ++j->block_count;
+
+    return b;
+}
+
+static jit_block_t* find_block(chip8_jit_t* j, const chip8_t* c, unsigned int pc) {
+    if (pc > 0xFFF)
+        return NULL;
+
+    int at = j->block_at[pc];
+    if (at > 0)
+        return &j->blocks[at - 1];
+    if (at == JIT_INTERPRET)
+        return NULL;
+
+    return compile_block(j, c, pc);
+}
+
+void chip8_run_jit(chip8_t* c, unsigned long n) {
+    if (c->jit == NULL && (c->jit = jit_create()) == NULL) {
+        chip8_run_cached(c, n);
+        return;
+    }
+    chip8_jit_t* j = c->jit;
+
+    while (n) {
+        jit_block_t* b = find_block(j, c, c->pc);
+
+        if (b == NULL) {
+            chip8_run_cached(c, 1);
+            n--;
+            continue;
+        }
+
+        if (code_executable(j) != 0) {
+            chip8_run_cached(c, n);
+            return;
+        }
+
+        unsigned char* site = NULL;
+        unsigned long left = ((jit_fn)(void*)b->code)(c, n, &site);
+        unsigned long ran = n - left;
+
+        if (ran == 0) {
+            // the block doesn't fit in what's left of the budget, finish up on the interpreter
+            chip8_run_cached(c, n);
+            return;
+        }
+
+        n = left;
+
+        // the run ended in an exit stub that isn't linked yet, link it if the target can be compiled
+        if (site != NULL) {
+            unsigned long generation = j->generation;
+            jit_block_t* target = find_block(j, c, c->pc);
+            if (target != NULL && j->generation == generation)
+                add_link(j, target, site);
+        }
+    }
+}
+
+#else
+
+void chip8_run_jit(chip8_t* c, unsigned long n) {
+    chip8_run_cached(c, n);
+}
+
+void chip8_jit_invalidate(chip8_jit_t* j, unsigned int addr, unsigned int len) {
+    (void)j;
+    (void)addr;
+    (void)len;
+}
+
+void chip8_jit_flush(chip8_jit_t* j) {
+    (void)j;
+}
+
+void chip8_jit_free(chip8_jit_t* j) {
+    (void)j;
+}
+
+#endif
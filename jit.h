@@ -0,0 +1,25 @@
+//
+// Basic block recompiler for x86-64 Linux. Blocks of plain register/ALU/branch instructions are translated into
+// native code and chained together; everything else (DXYN, keys, timers, memory, RND) runs on the interpreter.
+// On other hosts, or if the code buffer can't be mapped executable, the jit engine is just the cached engine.
+//
+
+#ifndef CHIP8_EMU_JIT_H
+#define CHIP8_EMU_JIT_H
+
+struct chip8;
+
+typedef struct chip8_jit chip8_jit_t;
+
+// Runs n instructions through the recompiler. Allocates chip8->jit on first use, chip8_destroy() frees it.
+void chip8_run_jit(struct chip8* chip8, unsigned long n);
+
+// Throws away every translated block that covers any of the len bytes at addr
+void chip8_jit_invalidate(chip8_jit_t* jit, unsigned int addr, unsigned int len);
+
+// Throws away everything
+void chip8_jit_flush(chip8_jit_t* jit);
+
+void chip8_jit_free(chip8_jit_t* jit);
+
+#endif //CHIP8_EMU_JIT_H
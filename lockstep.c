@@ -0,0 +1,523 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "lockstep.h"
+#include "quirks.h"
+
+// GCC / Clang vector extensions: plain C operators on whole vectors, compiled to SSE2 (two halves at a time) or
+// AVX2. may_alias, because the lane arrays are read and written through these as well as element by element.
+typedef uint8_t u8x32 __attribute__((vector_size(32), may_alias));
+typedef uint32_t u32x8 __attribute__((vector_size(32), may_alias));
+typedef uint8_t u8x8 __attribute__((vector_size(8), may_alias));
+
+// x86-64 always has SSE2. The round function is built twice, for AVX2 and without, and the loader picks the one
+// the cpu can run.
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__) && defined(__linux__)
+#define LOCKSTEP_KERNEL __attribute__((target_clones("avx2", "default")))
+#else
+#define LOCKSTEP_KERNEL
+#endif
+
+#define AT8(array, b) (*(u8x32*)((array) + (b)))
+#define AT32(array, b) (*(u32x8*)((array) + (b)))
+// a byte register of 8 lanes widened to 32 bits, to line up with the pc
+#define WIDE(array, b) __builtin_convertvector(*(u8x8*)((array) + (b)), u32x8)
+#define REG(ls, x) ((ls)->V + (size_t)(x) * (ls)->padded)
+// new where the mask is set, old elsewhere
+#define BLEND(old, new, mask) (((new) & (mask)) | ((old) & ~(mask)))
+
+#define FOR_BLOCKS8(ls, b) for (size_t b = 0; b < (ls)->padded; b += 32)
+#define FOR_BLOCKS32(ls, b) for (size_t b = 0; b < (ls)->padded; b += 8)
+// the lanes in the current group, one at a time
+#define FOR_GROUP(ls, l) for (size_t l = 0; l < (ls)->lanes; l++) if ((ls)->mask8[l])
+
+static void* lanes_alloc(size_t size) {
+    size = (size + 31) & ~(size_t)31;
+    void* p = aligned_alloc(32, size);
+    if (p)
+        memset(p, 0, size);
+    return p;
+}
+
+void chip8_lockstep_free(chip8_lockstep_t* ls) {
+    free(ls->V);
+    free(ls->sp);
+    free(ls->delay);
+    free(ls->sound);
+    free(ls->pc);
+    free(ls->I);
+    free(ls->keys);
+    free(ls->stack);
+    free(ls->rng);
+    free(ls->memory);
+    free(ls->display);
+    free(ls->dirty_rows);
+    free(ls->left);
+    free(ls->mask32);
+    free(ls->mask8);
+    memset(ls, 0, sizeof *ls);
+}
+
+int chip8_lockstep_init(chip8_lockstep_t* ls, size_t lanes, const chip8_t* c) {
+    memset(ls, 0, sizeof *ls);
+    // the lanes only know the default platform's quirks, and the lo-res screen
+    if (lanes == 0 || c->platform != CHIP8_PLATFORM_DEFAULT || c->hires || c->planes != 1)
+        return -1;
+
+    size_t p = (lanes + CHIP8_LOCKSTEP_BLOCK - 1) / CHIP8_LOCKSTEP_BLOCK * CHIP8_LOCKSTEP_BLOCK;
+    ls->lanes = lanes;
+    ls->padded = p;
+
+    ls->V = lanes_alloc(16 * p);
+    ls->sp = lanes_alloc(p);
+    ls->delay = lanes_alloc(p);
+    ls->sound = lanes_alloc(p);
+    ls->pc = lanes_alloc(p * sizeof *ls->pc);
+    ls->I = lanes_alloc(p * sizeof *ls->I);
+    ls->keys = lanes_alloc(p * sizeof *ls->keys);
+    ls->stack = lanes_alloc(16 * p * sizeof *ls->stack);
+    ls->rng = lanes_alloc(p * sizeof *ls->rng);
+    ls->memory = lanes_alloc(lanes * CHIP8_LOCKSTEP_MEMORY);
+    ls->display = lanes_alloc(lanes * 32 * sizeof *ls->display);
+    ls->dirty_rows = lanes_alloc(lanes * sizeof *ls->dirty_rows);
+    ls->left = lanes_alloc(p * sizeof *ls->left);
+    ls->mask32 = lanes_alloc(p * sizeof *ls->mask32);
+    ls->mask8 = lanes_alloc(p);
+
+    if (!ls->V || !ls->sp || !ls->delay || !ls->sound || !ls->pc || !ls->I || !ls->keys || !ls->stack || !ls->rng ||
+        !ls->memory || !ls->display || !ls->dirty_rows || !ls->left || !ls->mask32 || !ls->mask8) {
+        chip8_lockstep_free(ls);
+        return -1;
+    }
+
+    for (size_t l = 0; l < lanes; l++)
+        chip8_lockstep_load(ls, l, c);
+    ls->frame_count = c->frame_count;
+    return 0;
+}
+
+void chip8_lockstep_load(chip8_lockstep_t* ls, size_t l, const chip8_t* c) {
+    size_t p = ls->padded;
+
+    for (int x = 0; x < 16; x++)
+        ls->V[x * p + l] = c->V[x];
+    ls->sp[l] = c->sp;
+    ls->delay[l] = c->delayTimer;
+    ls->sound[l] = c->soundTimer;
+    ls->pc[l] = c->pc;
+    ls->I[l] = c->I;
+    ls->keys[l] = 0;
+    for (int k = 0; k < 16; k++)
+        ls->keys[l] |= (c->keypad[k] != 0) << k;
+    for (int s = 0; s < 16; s++)
+        ls->stack[s * p + l] = c->stack[s];
+    ls->rng[l] = c->rng;
+    memcpy(ls->memory + l * CHIP8_LOCKSTEP_MEMORY, c->memory, 4096);
+    memcpy(ls->display + l * 32, c->display[0][0], 32 * sizeof *ls->display);
+    ls->dirty_rows[l] = (uint32_t)c->dirty_rows;
+
+    // which chunks are still the same everywhere gets worked out again before the next frame
+    ls->shared = 0;
+    ls->written = ~0ULL;
+}
+
+void chip8_lockstep_store(const chip8_lockstep_t* ls, size_t l, chip8_t* c) {
+    size_t p = ls->padded;
+
+    for (int x = 0; x < 16; x++)
+        c->V[x] = ls->V[x * p + l];
+    c->sp = ls->sp[l];
+    c->delayTimer = ls->delay[l];
+    c->soundTimer = ls->sound[l];
+    c->pc = (unsigned short)ls->pc[l];
+    c->I = (unsigned short)ls->I[l];
+    for (int k = 0; k < 16; k++)
+        c->keypad[k] = (ls->keys[l] >> k) & 1;
+    for (int s = 0; s < 16; s++)
+        c->stack[s] = ls->stack[s * p + l];
+    c->rng = ls->rng[l];
+    memcpy(c->memory, ls->memory + l * CHIP8_LOCKSTEP_MEMORY, 4096);
+    memset(c->display, 0, sizeof c->display);
+    memcpy(c->display[0][0], ls->display + l * 32, 32 * sizeof *ls->display);
+    c->hires = 0;
+    c->planes = 1;
+    c->dirty_rows = ls->dirty_rows[l];
+    c->frame_count = ls->frame_count;
+    chip8_icache_flush(c);
+}
+
+void chip8_lockstep_set_keys(chip8_lockstep_t* ls, const unsigned char* keys) {
+    for (size_t l = 0; l < ls->lanes; l++) {
+        uint32_t mask = 0;
+        for (int k = 0; k < 16; k++)
+            mask |= (keys[l * 16 + k] != 0) << k;
+        ls->keys[l] = mask;
+    }
+}
+
+// Chunks that were written to since the last frame are compared across all lanes again. Lanes that stored the same
+// thing (the same score, say) can share the chunk again; only really different code makes fetching per lane.
+static void reshare(chip8_lockstep_t* ls) {
+    for (int k = 0; k < 64; k++) {
+        uint64_t bit = 1ULL << k;
+        if (!(ls->written & bit))
+            continue;
+
+        int same = 1;
+        for (size_t l = 1; l < ls->lanes && same; l++)
+            same = memcmp(ls->memory + l * CHIP8_LOCKSTEP_MEMORY + k * 64, ls->memory + k * 64, 64) == 0;
+        ls->shared = same ? ls->shared | bit : ls->shared & ~bit;
+    }
+    ls->written = 0;
+}
+
+static void wrote(chip8_lockstep_t* ls, unsigned int addr, unsigned int len) {
+    for (unsigned int a = addr; a != addr + len; a++) {
+        uint64_t bit = 1ULL << ((a & 0xFFF) / 64);
+        ls->written |= bit;
+        ls->shared &= ~bit;
+    }
+}
+
+static unsigned short fetch(const chip8_lockstep_t* ls, size_t l, uint32_t pc) {
+    const unsigned char* m = ls->memory + l * CHIP8_LOCKSTEP_MEMORY;
+    return (unsigned short)(m[pc & 0xFFF] << 8 | m[(pc + 1) & 0xFFF]);
+}
+
+// same generator as chip8_rand()
+static unsigned char lane_rand(uint64_t* rng) {
+    uint64_t x = *rng;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *rng = x;
+    return (unsigned char)((x * 0x2545F4914F6CDD1DULL) >> 56);
+}
+
+// pc += 2 for the group
+static inline void next(chip8_lockstep_t* ls) {
+    FOR_BLOCKS32(ls, b)
+        AT32(ls->pc, b) = (AT32(ls->pc, b) + (AT32(ls->mask32, b) & 2)) & 0xFFFF;
+}
+
+// pc += 4 where cond (all ones / zero per lane) is set, 2 elsewhere
+#define SKIP(ls, b, cond) \
+    AT32((ls)->pc, b) = (AT32((ls)->pc, b) + (AT32((ls)->mask32, b) & (2 + ((cond) & 2)))) & 0xFFFF
+
+static inline void lane_drw(chip8_lockstep_t* ls, size_t l, const chip8_decoded_t* d) {
+    size_t p = ls->padded;
+    const unsigned char* mem = ls->memory + l * CHIP8_LOCKSTEP_MEMORY;
+    uint64_t* display = ls->display + l * 32;
+    unsigned int xCoord = ls->V[d->x * p + l] % 64;
+    unsigned int yCoords = ls->V[d->y * p + l] % 32;
+    uint32_t I = ls->I[l];
+    uint64_t collision = 0;
+    // DXY0 is a 16x16 sprite, two bytes a row
+    int rows = d->n ? d->n : 16;
+
+    for (int yline = 0; yline < rows; yline++) {
+        uint64_t row;
+        if (d->n)
+            row = (uint64_t)mem[(I + yline) & 0xFFF] << 56;
+        else
+            row = (uint64_t)mem[(I + 2 * yline) & 0xFFF] << 56 | (uint64_t)mem[(I + 2 * yline + 1) & 0xFFF] << 48;
+        unsigned int screenY = (yCoords + yline) % 32;
+
+        row = (row >> xCoord) | (row << ((64 - xCoord) & 63));
+        collision |= display[screenY] & row;
+        display[screenY] ^= row;
+        ls->dirty_rows[l] |= 1u << screenY;
+    }
+    ls->V[0xF * p + l] = collision != 0;
+    ls->pc[l] = (ls->pc[l] + 2) & 0xFFFF;
+}
+
+// The group's instruction, following ops.h statement by statement: VF is stored before Vx is read again, which
+// matters when x or y is F.
+static inline void execute(chip8_lockstep_t* ls, const chip8_decoded_t* d) {
+    size_t p = ls->padded;
+    uint8_t* vx = REG(ls, d->x);
+    uint8_t* vy = REG(ls, d->y);
+    uint8_t* vf = REG(ls, 0xF);
+    uint8_t nn = (uint8_t)(d->nnn & 0xFF);
+
+    switch (d->op) {
+        case CHIP8_OP_CLS:
+            FOR_GROUP(ls, l) {
+                memset(ls->display + l * 32, 0, 32 * sizeof *ls->display);
+                ls->dirty_rows[l] = 0xFFFFFFFF;
+            }
+            next(ls);
+            break;
+        case CHIP8_OP_RET:
+            FOR_GROUP(ls, l) {
+                uint32_t pc = ls->stack[ls->sp[l] * p + l];
+                ls->sp[l] = (ls->sp[l] - 1) & 0xF;
+                ls->pc[l] = (pc + 2) & 0xFFFF;
+            }
+            break;
+        case CHIP8_OP_JP:
+            FOR_BLOCKS32(ls, b)
+                AT32(ls->pc, b) = BLEND(AT32(ls->pc, b), (uint32_t)d->nnn, AT32(ls->mask32, b));
+            break;
+        case CHIP8_OP_CALL:
+            FOR_GROUP(ls, l) {
+                ls->sp[l] = (ls->sp[l] + 1) & 0xF;
+                ls->stack[ls->sp[l] * p + l] = (uint16_t)ls->pc[l];
+                ls->pc[l] = d->nnn;
+            }
+            break;
+        case CHIP8_OP_SE_VX_NN:
+            FOR_BLOCKS32(ls, b)
+                SKIP(ls, b, (u32x8)(WIDE(vx, b) == nn));
+            break;
+        case CHIP8_OP_SNE_VX_NN:
+            FOR_BLOCKS32(ls, b)
+                SKIP(ls, b, (u32x8)(WIDE(vx, b) != nn));
+            break;
+        case CHIP8_OP_SE_VX_VY:
+            FOR_BLOCKS32(ls, b)
+                SKIP(ls, b, (u32x8)(WIDE(vx, b) == WIDE(vy, b)));
+            break;
+        case CHIP8_OP_SNE_VX_VY:
+            FOR_BLOCKS32(ls, b)
+                SKIP(ls, b, (u32x8)(WIDE(vx, b) != WIDE(vy, b)));
+            break;
+        case CHIP8_OP_LD_VX_NN:
+            FOR_BLOCKS8(ls, b)
+                AT8(vx, b) = BLEND(AT8(vx, b), nn, AT8(ls->mask8, b));
+            next(ls);
+            break;
+        case CHIP8_OP_ADD_VX_NN:
+            FOR_BLOCKS8(ls, b)
+                AT8(vx, b) = BLEND(AT8(vx, b), AT8(vx, b) + nn, AT8(ls->mask8, b));
+            next(ls);
+            break;
+        case CHIP8_OP_LD_VX_VY:
+            FOR_BLOCKS8(ls, b)
+                AT8(vx, b) = BLEND(AT8(vx, b), AT8(vy, b), AT8(ls->mask8, b));
+            next(ls);
+            break;
+        case CHIP8_OP_OR:
+            FOR_BLOCKS8(ls, b)
+                AT8(vx, b) = BLEND(AT8(vx, b), AT8(vx, b) | AT8(vy, b), AT8(ls->mask8, b));
+            next(ls);
+            break;
+        case CHIP8_OP_AND:
+            FOR_BLOCKS8(ls, b)
+                AT8(vx, b) = BLEND(AT8(vx, b), AT8(vx, b) & AT8(vy, b), AT8(ls->mask8, b));
+            next(ls);
+            break;
+        case CHIP8_OP_XOR:
+            FOR_BLOCKS8(ls, b)
+                AT8(vx, b) = BLEND(AT8(vx, b), AT8(vx, b) ^ AT8(vy, b), AT8(ls->mask8, b));
+            next(ls);
+            break;
+        case CHIP8_OP_ADD_VX_VY:
+            FOR_BLOCKS8(ls, b) {
+                u8x32 m = AT8(ls->mask8, b);
+                u8x32 carry = (u8x32)(AT8(vx, b) + AT8(vy, b) < AT8(vx, b)) & 1;
+                AT8(vf, b) = BLEND(AT8(vf, b), carry, m);
+                AT8(vx, b) = BLEND(AT8(vx, b), AT8(vx, b) + AT8(vy, b), m);
+            }
+            next(ls);
+            break;
+        case CHIP8_OP_SUB:
+            FOR_BLOCKS8(ls, b) {
+                u8x32 m = AT8(ls->mask8, b);
+                AT8(vf, b) = BLEND(AT8(vf, b), (u8x32)(AT8(vx, b) > AT8(vy, b)) & 1, m);
+                AT8(vx, b) = BLEND(AT8(vx, b), AT8(vx, b) - AT8(vy, b), m);
+            }
+            next(ls);
+            break;
+        case CHIP8_OP_SHR:
+            FOR_BLOCKS8(ls, b) {
+                u8x32 m = AT8(ls->mask8, b);
+                AT8(vf, b) = BLEND(AT8(vf, b), AT8(vx, b) & 1, m);
+                AT8(vx, b) = BLEND(AT8(vx, b), AT8(vx, b) >> 1, m);
+            }
+            next(ls);
+            break;
+        case CHIP8_OP_SUBN:
+            FOR_BLOCKS8(ls, b) {
+                u8x32 m = AT8(ls->mask8, b);
+                AT8(vf, b) = BLEND(AT8(vf, b), (u8x32)(AT8(vy, b) > AT8(vx, b)) & 1, m);
+                AT8(vx, b) = BLEND(AT8(vx, b), AT8(vy, b) - AT8(vx, b), m);
+            }
+            next(ls);
+            break;
+        case CHIP8_OP_SHL:
+            FOR_BLOCKS8(ls, b) {
+                u8x32 m = AT8(ls->mask8, b);
+                AT8(vf, b) = BLEND(AT8(vf, b), (AT8(vx, b) >> 7) & 1, m);
+                AT8(vx, b) = BLEND(AT8(vx, b), AT8(vx, b) << 1, m);
+            }
+            next(ls);
+            break;
+        case CHIP8_OP_LD_I:
+            FOR_BLOCKS32(ls, b)
+                AT32(ls->I, b) = BLEND(AT32(ls->I, b), (uint32_t)d->nnn, AT32(ls->mask32, b));
+            next(ls);
+            break;
+        case CHIP8_OP_JP_V0:
+            FOR_BLOCKS32(ls, b)
+                AT32(ls->pc, b) = BLEND(AT32(ls->pc, b), WIDE(REG(ls, 0), b) + d->nnn, AT32(ls->mask32, b));
+            break;
+        case CHIP8_OP_RND:
+            FOR_GROUP(ls, l)
+                vx[l] = lane_rand(&ls->rng[l]) & nn;
+            next(ls);
+            break;
+        case CHIP8_OP_DRW:
+            FOR_GROUP(ls, l)
+                lane_drw(ls, l, d);
+            break;
+        case CHIP8_OP_SKP:
+            FOR_BLOCKS32(ls, b)
+                SKIP(ls, b, 0 - ((AT32(ls->keys, b) >> (WIDE(vx, b) & 15)) & 1));
+            break;
+        case CHIP8_OP_SKNP:
+            FOR_BLOCKS32(ls, b)
+                SKIP(ls, b, ((AT32(ls->keys, b) >> (WIDE(vx, b) & 15)) & 1) - 1);
+            break;
+        case CHIP8_OP_LD_VX_DT:
+            FOR_BLOCKS8(ls, b)
+                AT8(vx, b) = BLEND(AT8(vx, b), AT8(ls->delay, b), AT8(ls->mask8, b));
+            next(ls);
+            break;
+        case CHIP8_OP_LD_VX_K:
+            // waits (doesn't move the pc) until a key is down
+            FOR_GROUP(ls, l) {
+                for (int k = 0; k < 16; k++) {
+                    if ((ls->keys[l] >> k) & 1) {
+                        vx[l] = (uint8_t)k;
+                        ls->pc[l] = (ls->pc[l] + 2) & 0xFFFF;
+                        break;
+                    }
+                }
+            }
+            break;
+        case CHIP8_OP_LD_DT_VX:
+            FOR_BLOCKS8(ls, b)
+                AT8(ls->delay, b) = BLEND(AT8(ls->delay, b), AT8(vx, b), AT8(ls->mask8, b));
+            next(ls);
+            break;
+        case CHIP8_OP_LD_ST_VX:
+            FOR_BLOCKS8(ls, b)
+                AT8(ls->sound, b) = BLEND(AT8(ls->sound, b), AT8(vx, b), AT8(ls->mask8, b));
+            next(ls);
+            break;
+        case CHIP8_OP_ADD_I_VX:
+            FOR_BLOCKS32(ls, b)
+                AT32(ls->I, b) = BLEND(AT32(ls->I, b), (AT32(ls->I, b) + WIDE(vx, b)) & 0xFFFF, AT32(ls->mask32, b));
+            next(ls);
+            break;
+        case CHIP8_OP_LD_F_VX:
+            FOR_BLOCKS32(ls, b)
+                AT32(ls->I, b) = BLEND(AT32(ls->I, b), WIDE(vx, b) * 5, AT32(ls->mask32, b));
+            next(ls);
+            break;
+        case CHIP8_OP_LD_B_VX:
+            FOR_GROUP(ls, l) {
+                unsigned char* mem = ls->memory + l * CHIP8_LOCKSTEP_MEMORY;
+                unsigned char v = vx[l];
+                uint32_t I = ls->I[l];
+                mem[I & 0xFFF] = v / 100;
+                mem[(I + 1) & 0xFFF] = (v % 100) / 10;
+                mem[(I + 2) & 0xFFF] = v % 10;
+                wrote(ls, I, 3);
+            }
+            next(ls);
+            break;
+        case CHIP8_OP_LD_MEM_VX:
+            FOR_GROUP(ls, l) {
+                unsigned char* mem = ls->memory + l * CHIP8_LOCKSTEP_MEMORY;
+                uint32_t I = ls->I[l];
+                for (int i = 0; i <= d->x; i++)
+                    mem[(I + i) & 0xFFF] = ls->V[i * p + l];
+                wrote(ls, I, d->x + 1);
+            }
+            next(ls);
+            break;
+        case CHIP8_OP_LD_VX_MEM:
+            FOR_GROUP(ls, l) {
+                const unsigned char* mem = ls->memory + l * CHIP8_LOCKSTEP_MEMORY;
+                uint32_t I = ls->I[l];
+                for (int i = 0; i <= d->x; i++)
+                    ls->V[i * p + l] = mem[(I + i) & 0xFFF];
+            }
+            next(ls);
+            break;
+        default:
+            // unknown opcode: the pc stays put, like everywhere else
+            break;
+    }
+}
+
+// One round: the lanes at the lowest pc that still have instructions left this frame run one instruction
+// together. 0 once every lane is done.
+LOCKSTEP_KERNEL
+static int lockstep_round(chip8_lockstep_t* ls) {
+    u32x8 lowest = {0};
+    lowest = ~lowest;
+
+    FOR_BLOCKS32(ls, b) {
+        u32x8 busy = (u32x8)(AT32(ls->left, b) != 0);
+        // the pc fits in 16 bits, so lanes that are done (all ones) never win
+        u32x8 key = (AT32(ls->pc, b) & busy) | ~busy;
+        lowest = BLEND(lowest, key, (u32x8)(key < lowest));
+    }
+
+    uint32_t pc = UINT32_MAX;
+    for (int i = 0; i < 8; i++)
+        if (lowest[i] < pc)
+            pc = lowest[i];
+    if (pc == UINT32_MAX)
+        return 0;
+
+    unsigned short opcode;
+    if ((ls->shared >> ((pc & 0xFFF) / 64)) & (ls->shared >> (((pc + 1) & 0xFFF) / 64)) & 1) {
+        // the code is the same in every lane, so every lane at that pc runs the same instruction
+        opcode = fetch(ls, 0, pc);
+        FOR_BLOCKS32(ls, b) {
+            u32x8 m = (u32x8)(AT32(ls->pc, b) == pc) & (u32x8)(AT32(ls->left, b) != 0);
+            AT32(ls->mask32, b) = m;
+            AT32(ls->left, b) += m;
+        }
+    } else {
+        // Different code in different lanes here: fetch lane by lane, and only the lanes with the same opcode as
+        // the first one go this round
+        size_t first = 0;
+        while (!(ls->left[first] && ls->pc[first] == pc))
+            first++;
+        opcode = fetch(ls, first, pc);
+
+        for (size_t l = 0; l < ls->padded; l++) {
+            int run = l < ls->lanes && ls->left[l] && ls->pc[l] == pc && fetch(ls, l, pc) == opcode;
+            ls->mask32[l] = run ? UINT32_MAX : 0;
+            ls->left[l] -= run;
+        }
+    }
+
+    FOR_BLOCKS32(ls, b)
+        *(u8x8*)(ls->mask8 + b) = __builtin_convertvector(AT32(ls->mask32, b), u8x8);
+
+    execute(ls, &chip8_decoded[opcode]);
+    return 1;
+}
+
+void chip8_lockstep_run_frame(chip8_lockstep_t* ls, unsigned long n) {
+    reshare(ls);
+
+    for (size_t l = 0; l < ls->lanes; l++)
+        ls->left[l] = (uint32_t)n;
+    while (lockstep_round(ls))
+        ;
+
+    // the timer tick, adding all ones is subtracting 1
+    FOR_BLOCKS8(ls, b) {
+        AT8(ls->delay, b) += (u8x32)(AT8(ls->delay, b) != 0);
+        AT8(ls->sound, b) += (u8x32)(AT8(ls->sound, b) != 0);
+    }
+    ls->frame_count++;
+}
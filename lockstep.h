@@ -0,0 +1,80 @@
+//
+// Lockstep batch engine: many machines running the same rom, kept in structure-of-arrays layout (V0 of every lane
+// next to each other, then V1, ..., the pcs, the timers) so one SIMD instruction does the same thing to a whole
+// block of lanes. Every round, the lanes sitting at the lowest pc execute that instruction together, masked; the
+// others wait. Lanes running the same code with different input stay at the same pc most of the time, and
+// lanes that branched apart come back together at the next join point, since whoever is behind goes first.
+// Instructions that touch memory, the stack or the screen run lane by lane inside the group.
+//
+// A lane behaves exactly like a chip8_t stepped with chip8_run_frame(). Lanes are plain lo-res CHIP-8 (DXY0's
+// 16x16 sprite included): the SUPER-CHIP / XO-CHIP resolution, scroll and plane instructions are left alone like
+// unknown opcodes, the pc stays on them.
+//
+
+#ifndef CHIP8_EMU_LOCKSTEP_H
+#define CHIP8_EMU_LOCKSTEP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+// lanes per block, one 256-bit vector of bytes. The lane arrays are padded to a multiple of it.
+#define CHIP8_LOCKSTEP_BLOCK 32
+
+// Bytes between the memories of two lanes. Not 4096: with a power of two every lane's copy of the same address
+// would land in the same cache set, and a group touching it in all lanes would keep evicting itself.
+#define CHIP8_LOCKSTEP_MEMORY (4096 + 64)
+
+typedef struct chip8_lockstep {
+    size_t lanes;
+    size_t padded;
+
+    // registers, padded lanes each. The 8 and 16-bit registers are widened to 32 bits where they meet the pc, so
+    // a mask computed for one can be used on the other without shuffling.
+    uint8_t* V;         // V[x * padded + lane]
+    uint8_t* sp;
+    uint8_t* delay;
+    uint8_t* sound;
+    uint32_t* pc;
+    uint32_t* I;
+    uint32_t* keys;     // keypad, bit k is key k
+    uint16_t* stack;    // stack[s * padded + lane]
+    uint64_t* rng;
+
+    // lane-major: memory[lane * CHIP8_LOCKSTEP_MEMORY + addr], display[lane * 32 + row]. The display is the packed
+    // framebuffer, lanes x 32 rows x 64 bits with pixel x at bit 63 - x, like chip8_t.display[0][0].
+    unsigned char* memory;
+    uint64_t* display;
+    uint32_t* dirty_rows;
+
+    // per round: instructions each lane has left this frame, and which lanes run (all ones / zero)
+    uint32_t* left;
+    uint32_t* mask32;
+    uint8_t* mask8;
+
+    // bit k: the 64-byte chunk k of memory is the same in every lane, so an instruction there can be fetched once
+    // for all of them. written collects the chunks stored to since the last check.
+    uint64_t shared;
+    uint64_t written;
+
+    unsigned long long frame_count;
+} chip8_lockstep_t;
+
+// Sets up lanes copies of machine (after chip8_init(), loading and seeding it). -1 if out of memory, if the
+// machine is set to a platform other than the default one, or if it is in hi-res or has other planes selected.
+int chip8_lockstep_init(chip8_lockstep_t* ls, size_t lanes, const chip8_t* machine);
+void chip8_lockstep_free(chip8_lockstep_t* ls);
+
+// Copies one machine's state into / out of a lane, e.g. to seed lanes differently or to hash a lane. store()
+// needs a chip8_init()-ed machine and flushes its instruction cache.
+void chip8_lockstep_load(chip8_lockstep_t* ls, size_t lane, const chip8_t* machine);
+void chip8_lockstep_store(const chip8_lockstep_t* ls, size_t lane, chip8_t* machine);
+
+// The keypad matrix: keys[lane * 16 + k] is non zero while key k of that lane is down
+void chip8_lockstep_set_keys(chip8_lockstep_t* ls, const unsigned char* keys);
+
+// One frame on every lane: n instructions each, then one timer tick, like chip8_run_frame()
+void chip8_lockstep_run_frame(chip8_lockstep_t* ls, unsigned long n);
+
+#endif //CHIP8_EMU_LOCKSTEP_H
@@ -2,39 +2,309 @@
 // Created by Noah Beal on 5/25/22.
 //
 
-#define _XOPEN_SOURCE 500
-
 #include <stdio.h>
-#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
 #include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
+#include "audio.h"
 #include "chip8.h"
+#include "movie.h"
+#include "quirks.h"
 #include "render.h"
+#include "rewind.h"
+#include "sched.h"
+#include "state.h"
+#include "timing.h"
+#include "triple.h"
+
+
+// the one machine the SDL frontend drives. Once the emulation thread is running nothing else touches it.
+static chip8_t chip8;
+
+// how often the speed in the title gets refreshed while fast forwarding
+#define SPEED_REPORT_NS 500000000ULL
+// longest the emulation thread sleeps waiting for a key while the rom can't do anything without one
+#define IDLE_WAIT_MS 250
+
+// Everything the SDL thread and the emulation thread share. Frames go one way through the triple buffer, input
+// goes the other way as atomics, so neither thread ever waits for the other. The mutex and condition variable are
+// only there for the emulation thread to sleep on while the rom waits for a key.
+typedef struct frontend {
+    chip8_triple_t frames;
+
+    atomic_uint keypad;       // bit k is key k
+    atomic_uint key_seq;      // key_events() as of keypad, stored after it
+    atomic_uint hotkeys;      // HOTKEY_* bits the emulation thread hasn't handled yet
+    atomic_int rewinding;
+    atomic_int quit;
+    atomic_uint speed;        // fast forward multiplier in hundredths, 0 when not fast forwarding
+
+    pthread_mutex_t input_lock;
+    pthread_cond_t input_changed;
+    unsigned int input_seq;
+} frontend_t;
+
+static frontend_t frontend;
+
+// command line, read only once the emulation thread runs
+static unsigned long ips = CHIP8_DEFAULT_IPS;
+static int vip_timing = 0;
+static int start_fast_forward = 0;
+static unsigned int ff_speed = 0;
+static long frameskip = -1;
+static int mute = 0;
+static unsigned long rewind_mb = 16;
+static const char* record_filename = NULL;
+static const char* replay_filename = NULL;
+static char state_filename[4096];
+
+// a movie is the input from power on, so it has to start from the same machine: same rom, seed and ips
+static chip8_movie_t movie;
+
+// the emulation thread fills it, SDL's audio thread plays it
+static chip8_audio_t audio;
+
+static void usage(void) {
+    printf("usage: emulator [--ips N | --vip-timing] [--fast-forward] [--ff-speed N] [--frameskip N] [--mute] [--rewind-mb N]\n");
+    printf("                [--seed N] [--quirks P | --quirks-db F] [--record movie | --replay movie] rom.ch8\n");
+    printf("  --ips N          cpu speed, the timers stay at 60 Hz (default %d)\n", CHIP8_DEFAULT_IPS);
+    printf("  --vip-timing     pace the cpu by what each instruction took on the COSMAC VIP instead, DXYN waiting\n");
+    printf("                   for the vertical blank (see timing.h)\n");
+    printf("  --fast-forward   start in fast forward (Tab toggles it while running)\n");
+    printf("  --ff-speed N     fast forward runs at N times normal speed, 0 is uncapped (default 0)\n");
+    printf("  --frameskip N    only render one frame in N + 1. Default: every frame at normal speed, and\n");
+    printf("                   at most one per display refresh while fast forwarding\n");
+    printf("  --mute           no sound\n");
+    printf("  --rewind-mb N    memory for the rewind buffer (hold Backspace), 0 turns it off (default 16)\n");
+    printf("  --seed N         seed for the random generator (default: the time)\n");
+    printf("  --quirks P       platform: default, vip, chip48, schip or xochip (default: default)\n");
+    printf("  --quirks-db F    look the rom's platform up in F, see quirks.h for the format\n");
+    printf("  --record F       record the input into the movie F, replay it with --replay or chip8-bench -m\n");
+    printf("  --replay F       play the movie F back (its seed, ips or timing and platform win over the options)\n");
+    printf("F5 saves the machine to rom.ch8.state, F9 loads it back\n");
+}
+
+// SDL thread: something the emulation thread might be sleeping on changed
+static void wake_emulation(void) {
+    pthread_mutex_lock(&frontend.input_lock);
+    frontend.input_seq++;
+    pthread_cond_signal(&frontend.input_changed);
+    pthread_mutex_unlock(&frontend.input_lock);
+}
+
+// Emulation thread: sleeps until wake_emulation() or timeout_ms
+static void wait_for_input(int timeout_ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&frontend.input_lock);
+    unsigned int seq = frontend.input_seq;
+    while (frontend.input_seq == seq && !atomic_load(&frontend.quit)) {
+        if (pthread_cond_timedwait(&frontend.input_changed, &frontend.input_lock, &deadline) == ETIMEDOUT)
+            break;
+    }
+    pthread_mutex_unlock(&frontend.input_lock);
+}
 
+// The emulation thread: one iteration per 60 Hz frame. Input snapshot, a batch of instructions plus one timer
+// tick, publish the display if it changed, then sleep off whatever is left of the 1/60 s. However long the SDL
+// thread spends presenting, this keeps its own time.
+// Fast forward only changes how often frames come round: every frame still runs its batch and its timer tick,
+// so the rom can't tell.
+static void* emulation_thread(void* arg) {
+    (void)arg;
 
+    int fast_forward = start_fast_forward;
+    int replaying = replay_filename != NULL;
+    int status;
+
+    chip8_sched_t sched;
+    chip8_sched_init(&sched, ips);
+    if (fast_forward)
+        chip8_sched_set_speed(&sched, ff_speed);
+
+    chip8_rewind_t* rewind = rewind_mb ? chip8_rewind_create(rewind_mb << 20) : NULL;
+
+    unsigned long long frames_run = 0;
+    unsigned int input_seq = 0;
+    unsigned long long report_start = chip8_sched_now();
+    unsigned long long report_frames = 0;
+
+    while (!atomic_load(&frontend.quit)) {
+        // sequence first: the keypad read after it is at least as new
+        unsigned int seq = atomic_load(&frontend.key_seq);
+        unsigned int keys = atomic_load(&frontend.keypad);
+        int new_input = seq != input_seq;
+        input_seq = seq;
+        for (int k = 0; k < 16; k++)
+            chip8.keypad[k] = (keys >> k) & 1;
+
+        unsigned int hotkeys = atomic_exchange(&frontend.hotkeys, 0);
+
+        if (hotkeys & HOTKEY_FAST_FORWARD) {
+            fast_forward = !fast_forward;
+            chip8_sched_set_speed(&sched, fast_forward ? ff_speed : 1);
+            report_start = chip8_sched_now();
+            report_frames = frames_run;
+            if (!fast_forward) {
+                atomic_store(&frontend.speed, 0);
+                notify_frame();
+            }
+        }
+        if (hotkeys & HOTKEY_SAVE_STATE) {
+            status = chip8_state_write_file(&chip8, state_filename);
+            if (status == 0)
+                printf("[OK] Saved state to %s\n", state_filename);
+            else
+                printf("[FAILED] Could not save state to %s\n", state_filename);
+        }
+        if (hotkeys & HOTKEY_LOAD_STATE) {
+            // a state from some other run would leave the movie with frames nobody has the input for
+            status = record_filename || replaying ? -1 : chip8_state_read_file(&chip8, state_filename);
+            if (status == 0)
+                printf("[OK] Loaded state from %s\n", state_filename);
+            else
+                printf("[FAILED] Could not load state from %s\n", state_filename);
+        }
+
+        // rewinding walks back one recorded frame per frame instead of running one
+        int rewinding = rewind && atomic_load(&frontend.rewinding);
+        if (rewinding) {
+            chip8_rewind_pop(rewind, &chip8);
+        } else {
+            // the keypad of a frame is whatever it is when the frame starts, that's what gets recorded or replayed
+            if (replaying && !chip8_movie_play(&movie, &chip8)) {
+                printf("[OK] Movie finished at frame %llu, input is live again\n", chip8.frame_count);
+                replaying = 0;
+            }
+            if (record_filename)
+                chip8_movie_record(&movie, &chip8);
+
+            // either way a whole frame of instructions runs in one go, the scheduler only sleeps between frames
+            if (vip_timing)
+                chip8_run_timed_frame(&chip8);
+            else
+                chip8_run_frame(&chip8, chip8_sched_instructions(&sched));
+            if (rewind)
+                chip8_rewind_push(rewind, &chip8);
+            frames_run++;
+        }
+
+        // fast forward would make more sound than there is time to play, so it stays quiet. Rewinding plays silence.
+        if (!fast_forward)
+            chip8_audio_frame(&audio, !rewinding && chip8.sound_flag);
+
+        // only frames that changed something get handed over, skipped ones leave their dirty rows for the next.
+        // The first frame with new input always goes, even unchanged, so the latency stats know the key got here.
+        int publish = chip8.dirty_rows != 0;
+        if (frameskip >= 0)
+            publish = publish && chip8.frame_count % (unsigned long long)(frameskip + 1) == 0;
+        if (publish || new_input) {
+            chip8_triple_back(&frontend.frames)->input_seq = input_seq;
+            chip8_triple_publish_machine(&frontend.frames, &chip8);
+            chip8.dirty_rows = 0;
+            notify_frame();
+        }
+
+        // emulated frames per second over real ones, 60 per second being 1x
+        unsigned long long now = chip8_sched_now();
+        if (fast_forward && now - report_start >= SPEED_REPORT_NS) {
+            double speed = (double)(frames_run - report_frames) * 1e9 / (double)(now - report_start) / CHIP8_FRAME_HZ;
+            atomic_store(&frontend.speed, (unsigned int)(speed * 100) + 1);
+            notify_frame();
+            report_start = now;
+            report_frames = frames_run;
+        }
+
+        // Waiting on a key with no timer running, nothing can happen until there is input: sleep until the SDL
+        // thread passes some on instead of waking up 60 times a second. The frames slept through aren't run, the
+        // scheduler just picks up from the wake up (they would only have counted frame_count up).
+        if (chip8.idle == CHIP8_IDLE_KEY && chip8.delayTimer == 0 && chip8.soundTimer == 0 && !fast_forward &&
+            !replaying && !rewinding) {
+            wait_for_input(IDLE_WAIT_MS);
+            chip8_sched_reset(&sched);
+        } else {
+            chip8_sched_wait(&sched);
+        }
+    }
+
+    chip8_rewind_destroy(rewind);
+    return NULL;
+}
 
 int main(int argc, char** argv) {
     // printing values for debugging purposes
    // printf("argc: %d\nargv: %s\n", argc, argv);
 
-    if (argc != 2) {
-        printf("usage: emulator rom.ch8\n");
+    uint64_t seed = (uint64_t)time(NULL);
+    char *rom_filename = NULL;
+    int platform = -1;
+    const char* quirks_db = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ips") == 0 && i + 1 < argc) {
+            ips = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--vip-timing") == 0) {
+            vip_timing = 1;
+        } else if (strcmp(argv[i], "--fast-forward") == 0) {
+            start_fast_forward = 1;
+        } else if (strcmp(argv[i], "--ff-speed") == 0 && i + 1 < argc) {
+            ff_speed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--frameskip") == 0 && i + 1 < argc) {
+            frameskip = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--mute") == 0) {
+            mute = 1;
+        } else if (strcmp(argv[i], "--rewind-mb") == 0 && i + 1 < argc) {
+            rewind_mb = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--quirks") == 0 && i + 1 < argc) {
+            platform = chip8_platform_from_name(argv[++i]);
+            if (platform < 0) {
+                rom_filename = NULL;
+                break;
+            }
+        } else if (strcmp(argv[i], "--quirks-db") == 0 && i + 1 < argc) {
+            quirks_db = argv[++i];
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_filename = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_filename = argv[++i];
+        } else if (rom_filename == NULL && argv[i][0] != '-') {
+            rom_filename = argv[i];
+        } else {
+            rom_filename = NULL;
+            break;
+        }
+    }
+
+    if (rom_filename == NULL || ips == 0 || frameskip < -1 || (record_filename && replay_filename)) {
+        usage();
         return 1;
     }
 
 
     printf("[PENDING] Initializing...\n");
-    initialize_cpu();
+    chip8_init(&chip8);
     printf("[OK] Done!\n");
 
-    char *rom_filename = argv[1];
     printf("[PENDING] Loading rom %s...\n", rom_filename);
 
-    int status = load_rom(rom_filename);
+    int status = chip8_load_rom(&chip8, rom_filename);
     printf("status: %d\n", status);
 
     if (status == -1) {
-        printf("[FAILED] fread() failure: the return value was not equal to the rom file size.\n");
+        printf("[FAILED] the rom is too big for memory.\n");
         return 1;
     }
     else if (status != 0) {
@@ -44,24 +314,146 @@ int main(int argc, char** argv) {
 
     printf("[OK] Rom loaded successfully!\n");
 
+    if (replay_filename) {
+        status = chip8_movie_read(&movie, replay_filename);
+        if (status != 0) {
+            printf("[FAILED] Could not read movie %s\n", replay_filename);
+            return 1;
+        }
+        if (movie.rom_hash != chip8_movie_rom_hash(&chip8)) {
+            printf("[FAILED] %s was recorded on a different rom\n", replay_filename);
+            return 1;
+        }
+        seed = movie.seed;
+        // a movie recorded with the VIP timing has no ips
+        vip_timing = movie.ips == 0;
+        if (!vip_timing)
+            ips = movie.ips;
+        platform = movie.platform;
+        printf("[OK] Replaying %zu frames from %s\n", movie.frames, replay_filename);
+    }
+    // an explicit platform wins over the database
+    if (platform < 0 && quirks_db) {
+        platform = chip8_platform_lookup(quirks_db, &chip8);
+        if (platform < 0)
+            printf("[OK] %s (hash %016llx) isn't in %s, using the default platform\n", rom_filename,
+                   (unsigned long long)chip8_movie_rom_hash(&chip8), quirks_db);
+    }
+    chip8_set_platform(&chip8, platform < 0 ? CHIP8_PLATFORM_DEFAULT : (chip8_platform_t)platform);
+    printf("[OK] Platform: %s\n", chip8_platform_name(chip8.platform));
+
+    chip8_seed(&chip8, seed);
+    if (record_filename)
+        chip8_movie_init(&movie, &chip8, seed, vip_timing ? 0 : ips);
+
+    snprintf(state_filename, sizeof state_filename, "%s.state", rom_filename);
+
     initialize_display();
     printf("[OK] Display successfully initialized.\n");
 
-    while (1) {
-        emulate_cycle();
+    chip8_audio_init(&audio, 0, mute);
+    if (!mute) {
+        if (initialize_audio(&audio) == 0) {
+            printf("[OK] Audio successfully initialized.\n");
+        } else {
+            printf("[FAILED] No audio device, running without sound\n");
+            audio.null_sink = 1;
+        }
+    }
+
+    chip8_triple_init(&frontend.frames);
+    atomic_init(&frontend.keypad, 0);
+    atomic_init(&frontend.key_seq, 0);
+    atomic_init(&frontend.hotkeys, 0);
+    atomic_init(&frontend.rewinding, 0);
+    atomic_init(&frontend.quit, 0);
+    atomic_init(&frontend.speed, 0);
+    pthread_mutex_init(&frontend.input_lock, NULL);
+    pthread_cond_init(&frontend.input_changed, NULL);
 
-        sdl_ehandler(keypad);
+    pthread_t emulation;
+    if (pthread_create(&emulation, NULL, emulation_thread, NULL) != 0) {
+        printf("[FAILED] Could not start the emulation thread\n");
+        stop_audio();
+        stop_display();
+        return 1;
+    }
+
+    // The SDL thread only handles events and presents. It sleeps in wait_event() until there is input or the
+    // emulation thread published a frame.
+    chip8_frame_t shown = {0};
+    unsigned int shown_speed = 0;
+
+    while (1) {
+        wait_event();
+        sdl_ehandler();
 
         if (should_quit()) {
             break;
         }
-        if (draw_flag) {
-            draw(display);
+
+        unsigned int keys = keypad_keys();
+        unsigned int seq = key_events();
+        unsigned int hotkeys = take_hotkeys();
+        int rewinding = rewind_held();
+
+        int changed = atomic_exchange(&frontend.keypad, keys) != keys;
+        changed |= atomic_exchange(&frontend.key_seq, seq) != seq;
+        changed |= atomic_exchange(&frontend.rewinding, rewinding) != rewinding;
+        if (hotkeys) {
+            atomic_fetch_xor(&frontend.hotkeys, hotkeys & HOTKEY_FAST_FORWARD);
+            atomic_fetch_or(&frontend.hotkeys, hotkeys & ~HOTKEY_FAST_FORWARD);
+            changed = 1;
+        }
+        if (changed)
+            wake_emulation();
+
+        // the emulation thread may have published several frames since the last look, diffing against what is on
+        // screen gives the rows that changed over all of them
+        const chip8_frame_t* frame = chip8_triple_take(&frontend.frames);
+        if (frame) {
+            uint64_t dirty_rows = 0;
+            if (frame->hires != shown.hires) {
+                dirty_rows = UINT64_MAX;
+            } else {
+                for (int y = 0; y < CHIP8_MAX_HEIGHT; y++)
+                    for (int p = 0; p < CHIP8_PLANES; p++)
+                        if (frame->display[p][0][y] != shown.display[p][0][y] ||
+                            frame->display[p][1][y] != shown.display[p][1][y])
+                            dirty_rows |= 1ull << y;
+            }
+
+            if (dirty_rows) {
+                memcpy(shown.display, frame->display, sizeof shown.display);
+                shown.hires = frame->hires;
+                draw(&shown, dirty_rows);
+            }
+            frame_input(frame->input_seq);
         }
+        present_frame();
+
+        unsigned int speed = atomic_load(&frontend.speed);
+        if (speed != shown_speed) {
+            show_speed(speed ? (double)(speed - 1) / 100.0 : 0);
+            shown_speed = speed;
+        }
+    }
+
+    atomic_store(&frontend.quit, 1);
+    wake_emulation();
+    pthread_join(emulation, NULL);
 
-        usleep(1500);
+    if (record_filename) {
+        if (chip8_movie_write(&movie, record_filename) == 0)
+            printf("[OK] Recorded %zu frames to %s\n", movie.frames, record_filename);
+        else
+            printf("[FAILED] Could not write movie %s\n", record_filename);
     }
+    if (record_filename || replay_filename)
+        chip8_movie_free(&movie);
 
+    report_input_latency();
+    stop_audio();
     stop_display();
     return 0;
-}
\ No newline at end of file
+}
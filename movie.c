@@ -0,0 +1,152 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "movie.h"
+
+#define MOVIE_HEADER_SIZE (4 + 2 + 2 + 8 + 8 + 4 + 4)
+
+static void put_le(unsigned char* p, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; i++)
+        p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static uint64_t get_le(const unsigned char* p, int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++)
+        v |= (uint64_t)p[i] << (8 * i);
+    return v;
+}
+
+uint64_t chip8_movie_rom_hash(const chip8_t* c) {
+    uint64_t h = 0xCBF29CE484222325ULL;
+
+    for (unsigned int addr = 0x200; addr < sizeof c->memory; addr++) {
+        h ^= c->memory[addr];
+        h *= 0x100000001B3ULL;
+    }
+    return h;
+}
+
+void chip8_movie_init(chip8_movie_t* m, const chip8_t* c, uint64_t seed, unsigned long ips) {
+    memset(m, 0, sizeof *m);
+    m->seed = seed;
+    m->rom_hash = chip8_movie_rom_hash(c);
+    m->ips = ips;
+    m->platform = c->platform;
+}
+
+void chip8_movie_free(chip8_movie_t* m) {
+    free(m->keys);
+    m->keys = NULL;
+    m->frames = m->cap = 0;
+}
+
+int chip8_movie_record(chip8_movie_t* m, const chip8_t* c) {
+    size_t frame = (size_t)c->frame_count;
+
+    // jumping ahead of the recording (a save state from elsewhere) would leave frames nobody knows the input of
+    if (frame > m->frames)
+        return -1;
+
+    if (frame >= m->cap) {
+        size_t cap = m->cap ? m->cap * 2 : 4096;
+        uint16_t* keys = realloc(m->keys, cap * sizeof *keys);
+        if (keys == NULL) return -1;
+        m->keys = keys;
+        m->cap = cap;
+    }
+
+    uint16_t mask = 0;
+    for (int k = 0; k < 16; k++)
+        if (c->keypad[k])
+            mask |= (uint16_t)(1u << k);
+
+    m->keys[frame] = mask;
+    m->frames = frame + 1;
+    return 0;
+}
+
+int chip8_movie_play(const chip8_movie_t* m, chip8_t* c) {
+    if (c->frame_count >= m->frames)
+        return 0;
+
+    uint16_t mask = m->keys[c->frame_count];
+    for (int k = 0; k < 16; k++)
+        c->keypad[k] = (mask >> k) & 1;
+    return 1;
+}
+
+int chip8_movie_write(const chip8_movie_t* m, const char* filename) {
+    unsigned char header[MOVIE_HEADER_SIZE];
+
+    memcpy(header, "C8MV", 4);
+    put_le(header + 4, CHIP8_MOVIE_VERSION, 2);
+    put_le(header + 6, m->platform, 2);
+    put_le(header + 8, m->seed, 8);
+    put_le(header + 16, m->rom_hash, 8);
+    put_le(header + 24, m->ips, 4);
+    put_le(header + 28, m->frames, 4);
+
+    FILE* fp = fopen(filename, "wb");
+    if (fp == NULL) return errno;
+
+    int failed = fwrite(header, 1, sizeof header, fp) != sizeof header;
+    for (size_t f = 0; f < m->frames && !failed; f++) {
+        unsigned char key[2];
+        put_le(key, m->keys[f], 2);
+        failed = fwrite(key, 1, 2, fp) != 2;
+    }
+
+    if (fclose(fp) != 0 || failed)
+        return errno ? errno : EIO;
+    return 0;
+}
+
+int chip8_movie_read(chip8_movie_t* m, const char* filename) {
+    unsigned char header[MOVIE_HEADER_SIZE];
+
+    FILE* fp = fopen(filename, "rb");
+    if (fp == NULL) return errno;
+
+    if (fread(header, 1, sizeof header, fp) != sizeof header || memcmp(header, "C8MV", 4) != 0) {
+        fclose(fp);
+        return -1;
+    }
+
+    // version 1: the default platform, and always a number of instructions per frame
+    uint64_t version = get_le(header + 4, 2);
+    uint64_t ips = get_le(header + 24, 4);
+    if ((version != 1 && version != CHIP8_MOVIE_VERSION) || (version == 1 && ips == 0)) {
+        fclose(fp);
+        return -1;
+    }
+
+    memset(m, 0, sizeof *m);
+    m->platform = version == 1 ? 0 : (unsigned char)get_le(header + 6, 2);
+    m->seed = get_le(header + 8, 8);
+    m->rom_hash = get_le(header + 16, 8);
+    m->ips = (unsigned long)ips;
+    size_t frames = (size_t)get_le(header + 28, 4);
+
+    m->keys = malloc((frames ? frames : 1) * sizeof *m->keys);
+    if (m->keys == NULL) {
+        fclose(fp);
+        return ENOMEM;
+    }
+    m->cap = frames;
+
+    for (; m->frames < frames; m->frames++) {
+        unsigned char key[2];
+        if (fread(key, 1, 2, fp) != 2) {
+            fclose(fp);
+            chip8_movie_free(m);
+            return -1;
+        }
+        m->keys[m->frames] = (uint16_t)get_le(key, 2);
+    }
+
+    fclose(fp);
+    return 0;
+}
@@ -0,0 +1,56 @@
+//
+// Movies: the keypad state of every frame since power on, plus what it takes to replay them exactly (the seed, the
+// instructions per frame and which rom). The core is deterministic given those, so replaying a movie headless gives
+// the same machine state bit for bit, at any speed and on any engine.
+//
+// File layout, little-endian: "C8MV", u16 version, u16 platform, u64 seed, u64 rom hash, u32 ips, u32 frames,
+// then one u16 keypad mask per frame (bit k is key k). An ips of 0 means the VIP timing model.
+//
+// Version 1 had no platform (the field was reserved) and no timing model: it still reads, as the default platform
+// with its ips, and a version 1 file with an ips of 0 is refused. Older readers refuse version 2 files instead of
+// replaying them with the wrong quirks or pacing.
+//
+
+#ifndef CHIP8_EMU_MOVIE_H
+#define CHIP8_EMU_MOVIE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+// 2: the platform, and ips 0 for the VIP timing model
+#define CHIP8_MOVIE_VERSION 2
+
+typedef struct chip8_movie {
+    uint64_t seed;
+    uint64_t rom_hash;
+    // 0: the frames were paced by the VIP timing model (chip8_run_timed_frame()) rather than a number of instructions
+    unsigned long ips;
+    // a chip8_platform_t, replays have to chip8_set_platform() it
+    unsigned char platform;
+
+    size_t frames;
+    size_t cap;
+    uint16_t* keys;
+} chip8_movie_t;
+
+// Starts an empty movie. The machine has to be freshly chip8_init()-ed, loaded, seeded with seed and set to its
+// platform.
+void chip8_movie_init(chip8_movie_t* movie, const chip8_t* chip8, uint64_t seed, unsigned long ips);
+void chip8_movie_free(chip8_movie_t* movie);
+
+// Hash of the program area, identifies the rom a movie was recorded on. Only meaningful right after loading.
+uint64_t chip8_movie_rom_hash(const chip8_t* chip8);
+
+// Records the keypad for the frame the machine is about to run (frame_count). Recording over an earlier frame,
+// after rewinding, cuts the movie off there. -1 if out of memory.
+int chip8_movie_record(chip8_movie_t* movie, const chip8_t* chip8);
+// Sets the keypad for the frame the machine is about to run. 0 if the movie has run out.
+int chip8_movie_play(const chip8_movie_t* movie, chip8_t* chip8);
+
+// 0 on success, errno on i/o errors, -1 if the file isn't a movie this version can read
+int chip8_movie_write(const chip8_movie_t* movie, const char* filename);
+int chip8_movie_read(chip8_movie_t* movie, const char* filename);
+
+#endif //CHIP8_EMU_MOVIE_H
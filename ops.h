@@ -0,0 +1,320 @@
+//
+// Instruction bodies for the table driven engines, one static inline function per decoded op. These follow
+// emulate_cycle() in Chip8.c exactly (including the order registers are written in, which matters when x is F),
+// so the switch engine can stay around as the reference for them.
+//
+// q is the quirk flags of the platform (quirks.h). The cores pass it as a constant, so the branches on it are gone
+// once the op is inlined into a core.
+//
+
+#ifndef CHIP8_EMU_OPS_H
+#define CHIP8_EMU_OPS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aot.h"
+#include "chip8.h"
+#include "decode.h"
+#include "display.h"
+#include "jit.h"
+#include "quirks.h"
+
+#define CHIP8_NN(d) ((d)->nnn & 0x00FF)
+
+// The guest wrote len bytes at addr. Any cached instruction that overlaps them (the one starting a byte earlier too)
+// has to be decoded again, and any recompiled block covering them thrown away. Only FX33 and FX55 write memory, so
+// this costs nothing on the hot path.
+static inline void chip8_icache_invalidate(chip8_t* c, unsigned int addr, unsigned int len) {
+    for (unsigned int a = addr - 1; a != addr + len; a++)
+        c->icache[a & 0xFFF].op = CHIP8_OP_COUNT;
+
+    if (c->jit)
+        chip8_jit_invalidate(c->jit, addr, len);
+    if (c->aot)
+        chip8_aot_check(c, addr, len);
+}
+
+static inline void chip8_op_unknown(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    // like the switch engine the pc doesn't move, so this keeps hitting the same opcode
+    (void)c;
+    printf("[FAILED] Unknown op: 0x%X\n", d->opcode);
+}
+
+static inline void chip8_op_cls(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    (void)d;
+    chip8_display_clear(c);
+    c->pc += 2;
+}
+
+static inline void chip8_op_ret(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    (void)d;
+    c->pc = c->stack[c->sp];
+    c->sp = (c->sp - 1) & 0xF;
+    c->pc += 2;
+}
+
+static inline void chip8_op_jp(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    c->pc = d->nnn;
+}
+
+static inline void chip8_op_call(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    c->sp = (c->sp + 1) & 0xF;
+    c->stack[c->sp] = c->pc;
+    c->pc = d->nnn;
+}
+
+static inline void chip8_op_se_vx_nn(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    c->pc += c->V[d->x] == CHIP8_NN(d) ? 4 : 2;
+}
+
+static inline void chip8_op_sne_vx_nn(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    c->pc += c->V[d->x] != CHIP8_NN(d) ? 4 : 2;
+}
+
+static inline void chip8_op_se_vx_vy(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    c->pc += c->V[d->x] == c->V[d->y] ? 4 : 2;
+}
+
+static inline void chip8_op_ld_vx_nn(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    c->V[d->x] = CHIP8_NN(d);
+    c->pc += 2;
+}
+
+static inline void chip8_op_add_vx_nn(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    c->V[d->x] += CHIP8_NN(d);
+    c->pc += 2;
+}
+
+static inline void chip8_op_ld_vx_vy(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    c->V[d->x] = c->V[d->y];
+    c->pc += 2;
+}
+
+static inline void chip8_op_or(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    c->V[d->x] |= c->V[d->y];
+    if (q & CHIP8_QUIRK_VF_RESET)
+        c->V[0xF] = 0;
+    c->pc += 2;
+}
+
+static inline void chip8_op_and(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    c->V[d->x] &= c->V[d->y];
+    if (q & CHIP8_QUIRK_VF_RESET)
+        c->V[0xF] = 0;
+    c->pc += 2;
+}
+
+static inline void chip8_op_xor(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    c->V[d->x] ^= c->V[d->y];
+    if (q & CHIP8_QUIRK_VF_RESET)
+        c->V[0xF] = 0;
+    c->pc += 2;
+}
+
+// the flag is written before Vx for 8XY4/8XY5, after reading Vx for the shifts, same as the reference
+static inline void chip8_op_add_vx_vy(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    c->V[0xF] = (c->V[d->x] + c->V[d->y]) > 0xFF;
+    c->V[d->x] += c->V[d->y];
+    c->pc += 2;
+}
+
+static inline void chip8_op_sub(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    c->V[0xF] = c->V[d->x] > c->V[d->y];
+    c->V[d->x] -= c->V[d->y];
+    c->pc += 2;
+}
+
+// VF is written before the shift like in the switch engine, so 8FY6 / 8FYE shift the flag they just set
+static inline void chip8_op_shr(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    if (q & CHIP8_QUIRK_SHIFT_VY)
+        c->V[d->x] = c->V[d->y];
+    c->V[0xF] = c->V[d->x] & 0x1;
+    c->V[d->x] >>= 1;
+    c->pc += 2;
+}
+
+static inline void chip8_op_subn(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    c->V[0xF] = c->V[d->y] > c->V[d->x];
+    c->V[d->x] = c->V[d->y] - c->V[d->x];
+    c->pc += 2;
+}
+
+static inline void chip8_op_shl(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    if (q & CHIP8_QUIRK_SHIFT_VY)
+        c->V[d->x] = c->V[d->y];
+    c->V[0xF] = (c->V[d->x] >> 7) & 0x1;
+    c->V[d->x] <<= 1;
+    c->pc += 2;
+}
+
+static inline void chip8_op_sne_vx_vy(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    c->pc += c->V[d->x] != c->V[d->y] ? 4 : 2;
+}
+
+static inline void chip8_op_ld_i(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    c->I = d->nnn;
+    c->pc += 2;
+}
+
+static inline void chip8_op_jp_v0(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    c->pc = c->V[q & CHIP8_QUIRK_JUMP_VX ? d->x : 0] + d->nnn;
+}
+
+static inline void chip8_op_rnd(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    c->V[d->x] = chip8_rand(c) & CHIP8_NN(d);
+    c->pc += 2;
+}
+
+// A whole sprite row at a time: put the byte at the top of a word, rotate it to x (which wraps it around the edge
+// for free), then one AND for the collision and one XOR to draw. Rows wrap at the bottom. When clipping, the
+// start still wraps but the shift drops what is past the right edge and the rows stop at the bottom.
+// That is the lo-res, plane 0 only case every CHIP-8 rom draws with; hi-res, XO-CHIP planes and 16x16 sprites
+// cost one extra well predicted branch here and go to display.c.
+static inline void chip8_op_drw(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    if (c->hires | (c->planes != 1) | (d->n == 0)) {
+        chip8_display_draw(c, d, q);
+        c->pc += 2;
+        return;
+    }
+
+    unsigned int xCoord = c->V[d->x] % 64;
+    unsigned int yCoords = c->V[d->y] % 32;
+    uint64_t collision = 0;
+
+    for (int yline = 0; yline < d->n; yline++) {
+        if ((q & CHIP8_QUIRK_CLIP) && yCoords + yline >= 32)
+            break;
+
+        uint64_t row = (uint64_t)c->memory[(c->I + yline) & 0xFFF] << 56;
+        unsigned int screenY = (yCoords + yline) % 32;
+        uint64_t* screen = &c->display[0][0][screenY];
+
+        if (q & CHIP8_QUIRK_CLIP)
+            row >>= xCoord;
+        else
+            row = (row >> xCoord) | (row << ((64 - xCoord) & 63));
+        collision |= *screen & row;
+        *screen ^= row;
+        c->dirty_rows |= 1u << screenY;
+    }
+    c->V[0xF] = collision != 0;
+    c->draw_flag = 1;
+    c->pc += 2;
+}
+
+static inline void chip8_op_skp(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    c->pc += c->keypad[c->V[d->x] & 0xF] ? 4 : 2;
+}
+
+static inline void chip8_op_sknp(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    c->pc += !c->keypad[c->V[d->x] & 0xF] ? 4 : 2;
+}
+
+static inline void chip8_op_ld_vx_dt(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    c->V[d->x] = c->delayTimer;
+    c->pc += 2;
+}
+
+static inline void chip8_op_ld_vx_k(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    for (int i = 0; i < 16; i++) {
+        if (c->keypad[i]) {
+            c->V[d->x] = i;
+            c->pc += 2;
+            break;
+        }
+    }
+}
+
+static inline void chip8_op_ld_dt_vx(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    c->delayTimer = c->V[d->x];
+    c->pc += 2;
+}
+
+static inline void chip8_op_ld_st_vx(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    c->soundTimer = c->V[d->x];
+    c->pc += 2;
+}
+
+static inline void chip8_op_add_i_vx(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    c->I = c->I + c->V[d->x];
+    c->pc += 2;
+}
+
+static inline void chip8_op_ld_f_vx(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    c->I = c->V[d->x] * 5;
+    c->pc += 2;
+}
+
+// FX1E can take I anywhere up to 0xFFFF, so like the sprite reads the memory instructions wrap at 4K
+static inline void chip8_op_ld_b_vx(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    unsigned char v = c->V[d->x];
+
+    c->memory[c->I & 0xFFF] = v / 100;
+    c->memory[(c->I + 1) & 0xFFF] = (v % 100) / 10;
+    c->memory[(c->I + 2) & 0xFFF] = v % 10;
+    chip8_icache_invalidate(c, c->I, 3);
+    c->pc += 2;
+}
+
+// FX55/FX65 moving I on the platforms that do. It wraps at 4K, otherwise a loop of them walks I off the end of
+// memory.
+static inline void chip8_mem_advance(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    if (q & CHIP8_QUIRK_MEM_INC_X1)
+        c->I = (c->I + d->x + 1) & 0xFFF;
+    else if (q & CHIP8_QUIRK_MEM_INC_X)
+        c->I = (c->I + d->x) & 0xFFF;
+}
+
+static inline void chip8_op_ld_mem_vx(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    for (int i = 0; i <= d->x; i++)
+        c->memory[(c->I + i) & 0xFFF] = c->V[i];
+    chip8_icache_invalidate(c, c->I, d->x + 1);
+    chip8_mem_advance(c, d, q);
+    c->pc += 2;
+}
+
+static inline void chip8_op_ld_vx_mem(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    for (int i = 0; i <= d->x; i++)
+        c->V[i] = c->memory[(c->I + i) & 0xFFF];
+    chip8_mem_advance(c, d, q);
+    c->pc += 2;
+}
+
+static inline void chip8_op_scd(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    chip8_display_scroll_down(c, d->n);
+    c->pc += 2;
+}
+
+static inline void chip8_op_scu(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    chip8_display_scroll_up(c, d->n);
+    c->pc += 2;
+}
+
+static inline void chip8_op_scr(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    chip8_display_scroll_right(c);
+    c->pc += 2;
+}
+
+static inline void chip8_op_scl(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    chip8_display_scroll_left(c);
+    c->pc += 2;
+}
+
+static inline void chip8_op_low(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    chip8_display_set_hires(c, 0);
+    c->pc += 2;
+}
+
+static inline void chip8_op_high(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    chip8_display_set_hires(c, 1);
+    c->pc += 2;
+}
+
+static inline void chip8_op_plane(chip8_t* c, const chip8_decoded_t* d, unsigned int q) {
+    c->planes = d->x & 3;
+    c->pc += 2;
+}
+
+#endif //CHIP8_EMU_OPS_H
@@ -0,0 +1,256 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "pool.h"
+
+// Every worker owns a deque. The owner pushes and pops at the tail (LIFO, so it keeps working on what it just
+// queued), thieves take from the head (FIFO, the oldest work). Tasks here are whole emulator runs, so a mutex per
+// deque costs nothing next to the work itself and keeps this simple.
+
+typedef struct pool_task {
+    pool_fn fn;
+    void* arg;
+} pool_task_t;
+
+typedef struct pool_deque {
+    pthread_mutex_t lock;
+    pool_task_t* tasks;
+    size_t head;
+    size_t tail;
+    size_t cap;
+} pool_deque_t;
+
+typedef struct pool_worker {
+    pool_t* pool;
+    int id;
+    unsigned int seed;
+} pool_worker_t;
+
+struct pool {
+    int nthreads;
+    pthread_t* threads;
+    pool_worker_t* workers;
+    pool_deque_t* deques;
+
+    // tasks sitting in a deque, and tasks submitted but not finished yet
+    atomic_size_t queued;
+    atomic_size_t pending;
+    atomic_uint next_deque;
+
+    // only used for sleeping, never on the fast path
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    int shutdown;
+};
+
+// -1 if the deque was full and couldn't grow, the task isn't queued then
+static int deque_push(pool_deque_t* d, pool_task_t task) {
+    pthread_mutex_lock(&d->lock);
+
+    if (d->tail == d->cap) {
+        // slide everything back to the front, and only grow when it is actually full
+        size_t count = d->tail - d->head;
+        size_t cap = d->cap;
+        if (cap == 0 || count * 2 > cap) {
+            cap = cap ? cap * 2 : 64;
+        }
+        pool_task_t* tasks = malloc(cap * sizeof *tasks);
+        if (tasks == NULL) {
+            pthread_mutex_unlock(&d->lock);
+            return -1;
+        }
+        d->cap = cap;
+        for (size_t i = 0; i < count; i++)
+            tasks[i] = d->tasks[d->head + i];
+        free(d->tasks);
+        d->tasks = tasks;
+        d->head = 0;
+        d->tail = count;
+    }
+    d->tasks[d->tail++] = task;
+
+    pthread_mutex_unlock(&d->lock);
+    return 0;
+}
+
+static int deque_pop(pool_deque_t* d, pool_task_t* out) {
+    int found = 0;
+
+    pthread_mutex_lock(&d->lock);
+    if (d->tail > d->head) {
+        *out = d->tasks[--d->tail];
+        found = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+
+    return found;
+}
+
+static int deque_steal(pool_deque_t* d, pool_task_t* out) {
+    int found = 0;
+
+    // don't queue up behind a busy owner, just go look somewhere else
+    if (pthread_mutex_trylock(&d->lock) != 0)
+        return 0;
+    if (d->tail > d->head) {
+        *out = d->tasks[d->head++];
+        found = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+
+    return found;
+}
+
+static int find_task(pool_worker_t* w, pool_task_t* out) {
+    pool_t* pool = w->pool;
+
+    if (deque_pop(&pool->deques[w->id], out))
+        return 1;
+
+    // start stealing at a random victim so idle workers don't all hammer the same deque
+    w->seed ^= w->seed << 13;
+    w->seed ^= w->seed >> 17;
+    w->seed ^= w->seed << 5;
+    int start = (int)(w->seed % (unsigned int)pool->nthreads);
+
+    for (int i = 0; i < pool->nthreads; i++) {
+        int victim = (start + i) % pool->nthreads;
+        if (victim != w->id && deque_steal(&pool->deques[victim], out))
+            return 1;
+    }
+    return 0;
+}
+
+static void* worker_main(void* arg) {
+    pool_worker_t* w = arg;
+    pool_t* pool = w->pool;
+    pool_task_t task;
+
+    for (;;) {
+        if (find_task(w, &task)) {
+            atomic_fetch_sub(&pool->queued, 1);
+            task.fn(task.arg);
+
+            if (atomic_fetch_sub(&pool->pending, 1) == 1) {
+                pthread_mutex_lock(&pool->lock);
+                pthread_cond_broadcast(&pool->done_cond);
+                pthread_mutex_unlock(&pool->lock);
+            }
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        while (atomic_load(&pool->queued) == 0 && !pool->shutdown)
+            pthread_cond_wait(&pool->work_cond, &pool->lock);
+        int stop = pool->shutdown && atomic_load(&pool->queued) == 0;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (stop)
+            break;
+    }
+    return NULL;
+}
+
+// Stops and joins the first started workers and frees everything, for pool_destroy() and a pool_create() that
+// couldn't start all of them
+static void pool_free(pool_t* pool, int started) {
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < started; i++)
+        pthread_join(pool->threads[i], NULL);
+    for (int i = 0; i < pool->nthreads; i++) {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+        free(pool->deques[i].tasks);
+    }
+
+    pthread_cond_destroy(&pool->done_cond);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->deques);
+    free(pool->workers);
+    free(pool->threads);
+    free(pool);
+}
+
+pool_t* pool_create(int nthreads) {
+    if (nthreads <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = cores > 0 ? (int)cores : 1;
+    }
+
+    pool_t* pool = calloc(1, sizeof *pool);
+    if (pool == NULL) return NULL;
+
+    pool->nthreads = nthreads;
+    pool->threads = calloc(nthreads, sizeof *pool->threads);
+    pool->workers = calloc(nthreads, sizeof *pool->workers);
+    pool->deques = calloc(nthreads, sizeof *pool->deques);
+    if (pool->threads == NULL || pool->workers == NULL || pool->deques == NULL) {
+        free(pool->threads);
+        free(pool->workers);
+        free(pool->deques);
+        free(pool);
+        return NULL;
+    }
+    atomic_init(&pool->queued, 0);
+    atomic_init(&pool->pending, 0);
+    atomic_init(&pool->next_deque, 0);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    for (int i = 0; i < nthreads; i++) {
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+        pool->workers[i].pool = pool;
+        pool->workers[i].id = i;
+        pool->workers[i].seed = 0x9E3779B9u * (unsigned int)(i + 1);
+    }
+    for (int i = 0; i < nthreads; i++) {
+        if (pthread_create(&pool->threads[i], NULL, worker_main, &pool->workers[i]) != 0) {
+            pool_free(pool, i);
+            return NULL;
+        }
+    }
+
+    return pool;
+}
+
+int pool_threads(pool_t* pool) {
+    return pool->nthreads;
+}
+
+int pool_submit(pool_t* pool, pool_fn fn, void* arg) {
+    pool_task_t task = {fn, arg};
+    unsigned int target = atomic_fetch_add(&pool->next_deque, 1) % (unsigned int)pool->nthreads;
+
+    // counted before the push so a worker can never see the task without it being counted
+    atomic_fetch_add(&pool->pending, 1);
+    atomic_fetch_add(&pool->queued, 1);
+    if (deque_push(&pool->deques[target], task) != 0) {
+        atomic_fetch_sub(&pool->queued, 1);
+        atomic_fetch_sub(&pool->pending, 1);
+        return -1;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+}
+
+void pool_wait(pool_t* pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (atomic_load(&pool->pending) != 0)
+        pthread_cond_wait(&pool->done_cond, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_destroy(pool_t* pool) {
+    pool_free(pool, pool->nthreads);
+}
@@ -0,0 +1,25 @@
+//
+// Small work-stealing thread pool used by the batch runners.
+//
+
+#ifndef CHIP8_EMU_POOL_H
+#define CHIP8_EMU_POOL_H
+
+typedef void (*pool_fn)(void* arg);
+
+typedef struct pool pool_t;
+
+// nthreads <= 0 means one worker per online core. NULL if out of memory or the threads couldn't be started.
+pool_t* pool_create(int nthreads);
+int pool_threads(pool_t* pool);
+
+// Queues fn(arg). Tasks are spread round-robin over the workers' deques; idle workers steal from the others.
+// -1 if out of memory, fn(arg) won't run then.
+int pool_submit(pool_t* pool, pool_fn fn, void* arg);
+
+// Blocks until every submitted task has finished
+void pool_wait(pool_t* pool);
+
+void pool_destroy(pool_t* pool);
+
+#endif //CHIP8_EMU_POOL_H
@@ -0,0 +1,203 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "disasm.h"
+#include "profile.h"
+
+static const char* const op_names[CHIP8_OP_COUNT] = {
+#define NAME(name, handler) [CHIP8_OP_##name] = #name,
+    CHIP8_OP_LIST(NAME)
+#undef NAME
+};
+
+int chip8_profile_open(chip8_profile_t* p) {
+    memset(p, 0, sizeof *p);
+
+    p->node_cap = 256;
+    p->nodes = malloc(p->node_cap * sizeof *p->nodes);
+    if (p->nodes == NULL) return -1;
+
+    chip8_profile_reset(p);
+    return 0;
+}
+
+void chip8_profile_close(chip8_profile_t* p) {
+    free(p->nodes);
+    p->nodes = NULL;
+}
+
+void chip8_profile_reset(chip8_profile_t* p) {
+    chip8_profile_node_t* nodes = p->nodes;
+    unsigned int cap = p->node_cap;
+
+    memset(p, 0, sizeof *p);
+    p->nodes = nodes;
+    p->node_cap = cap;
+
+    memset(&p->nodes[0], 0, sizeof p->nodes[0]);
+    p->nodes[0].addr = 0x200;
+    p->node_count = 1;
+}
+
+// The child of the current node for a call to addr, made if it isn't there yet
+static unsigned int enter(chip8_profile_t* p, unsigned short addr) {
+    chip8_profile_node_t* cur = &p->nodes[p->current];
+
+    if (cur->depth >= CHIP8_PROFILE_MAX_DEPTH)
+        return p->current;
+
+    for (unsigned int child = cur->first_child; child; child = p->nodes[child].next_sibling)
+        if (p->nodes[child].addr == addr)
+            return child;
+
+    if (p->node_count == p->node_cap) {
+        chip8_profile_node_t* nodes = realloc(p->nodes, p->node_cap * 2 * sizeof *nodes);
+        if (nodes == NULL) return p->current;
+        p->nodes = nodes;
+        p->node_cap *= 2;
+        cur = &p->nodes[p->current];
+    }
+
+    unsigned int n = p->node_count++;
+    chip8_profile_node_t* node = &p->nodes[n];
+    node->addr = addr;
+    node->depth = cur->depth + 1;
+    node->parent = p->current;
+    node->first_child = 0;
+    node->next_sibling = cur->first_child;
+    node->self = 0;
+    cur->first_child = n;
+
+    return n;
+}
+
+void chip8_profile_write(chip8_profile_t* p, const chip8_t* c, unsigned short pc, unsigned short opcode) {
+    p->instructions++;
+    p->op_count[chip8_decoded[opcode].op]++;
+    p->pc_count[pc & 0xFFF]++;
+    p->nodes[p->current].self++;
+
+    switch (opcode >> 12) {
+        case 0x0:
+            // a return from a call that got folded stays in the node it was folded into
+            if (opcode == 0x00EE) {
+                if (p->folded)
+                    p->folded--;
+                else
+                    p->current = p->nodes[p->current].parent;
+            }
+            break;
+        case 0x2: {
+            unsigned int node = enter(p, opcode & 0x0FFF);
+            if (node == p->current)
+                p->folded++;
+            else
+                p->current = node;
+            break;
+        }
+        case 0xD:
+            p->draws[opcode & 0xF]++;
+            break;
+    }
+
+    if (c->pc == pc) {
+        if ((opcode & 0xF0FF) == 0xF00A)
+            p->key_wait++;
+        else
+            p->spin++;
+    }
+}
+
+typedef struct ranked {
+    unsigned int index;
+    unsigned long long count;
+} ranked_t;
+
+static int by_count(const void* a, const void* b) {
+    const ranked_t* ra = a;
+    const ranked_t* rb = b;
+
+    if (ra->count != rb->count)
+        return ra->count < rb->count ? 1 : -1;
+    return ra->index < rb->index ? -1 : ra->index > rb->index;
+}
+
+static double percent(unsigned long long part, unsigned long long total) {
+    return total ? 100.0 * (double)part / (double)total : 0.0;
+}
+
+void chip8_profile_report(const chip8_profile_t* p, const chip8_t* c, unsigned int top, FILE* out) {
+    ranked_t ranks[4096];
+    unsigned long long total = p->instructions;
+
+    fprintf(out, "instructions:  %llu\n", total);
+    fprintf(out, "key wait:      %llu (%.2f%%) spinning in FX0A\n", p->key_wait, percent(p->key_wait, total));
+    fprintf(out, "spin:          %llu (%.2f%%) jumps to self and other instructions that go nowhere\n", p->spin,
+            percent(p->spin, total));
+
+    fprintf(out, "\nby opcode class\n");
+    unsigned int n = 0;
+    for (unsigned int op = 0; op < CHIP8_OP_COUNT; op++) {
+        if (p->op_count[op]) {
+            ranks[n].index = op;
+            ranks[n++].count = p->op_count[op];
+        }
+    }
+    qsort(ranks, n, sizeof *ranks, by_count);
+    for (unsigned int i = 0; i < n; i++)
+        fprintf(out, "  %-10s %14llu %7.2f%%\n", op_names[ranks[i].index], ranks[i].count,
+                percent(ranks[i].count, total));
+
+    fprintf(out, "\nhot pcs\n");
+    n = 0;
+    for (unsigned int pc = 0; pc < 4096; pc++) {
+        if (p->pc_count[pc]) {
+            ranks[n].index = pc;
+            ranks[n++].count = p->pc_count[pc];
+        }
+    }
+    qsort(ranks, n, sizeof *ranks, by_count);
+    for (unsigned int i = 0; i < n && i < top; i++) {
+        unsigned int pc = ranks[i].index;
+        unsigned short opcode = c->memory[pc] << 8 | c->memory[(pc + 1) & 0xFFF];
+        char text[32];
+
+        chip8_disasm(opcode, text, sizeof text);
+        fprintf(out, "  0x%03X  %04X  %-18s %14llu %7.2f%%\n", pc, opcode, text, ranks[i].count,
+                percent(ranks[i].count, total));
+    }
+
+    unsigned long long draws = 0, rows = 0;
+    for (int h = 0; h < 16; h++) {
+        draws += p->draws[h];
+        rows += p->draws[h] * (unsigned long long)(h ? h : 16);
+    }
+    fprintf(out, "\nDXYN: %llu calls, %llu sprite rows\n", draws, rows);
+    for (int h = 0; h < 16; h++) {
+        if (p->draws[h] == 0)
+            continue;
+        if (h == 0)
+            fprintf(out, "  16x16     %14llu %7.2f%%\n", p->draws[h], percent(p->draws[h], draws));
+        else
+            fprintf(out, "  height %2d %14llu %7.2f%%\n", h, p->draws[h], percent(p->draws[h], draws));
+    }
+}
+
+static void print_stack(const chip8_profile_t* p, unsigned int node, FILE* out) {
+    if (node == 0) {
+        fputs("main", out);
+        return;
+    }
+    print_stack(p, p->nodes[node].parent, out);
+    fprintf(out, ";0x%03x", p->nodes[node].addr);
+}
+
+void chip8_profile_folded(const chip8_profile_t* p, FILE* out) {
+    for (unsigned int node = 0; node < p->node_count; node++) {
+        if (p->nodes[node].self == 0)
+            continue;
+        print_stack(p, node, out);
+        fprintf(out, " %llu\n", p->nodes[node].self);
+    }
+}
@@ -0,0 +1,77 @@
+//
+// Profiler. Only does anything in builds with CHIP8_PROFILE defined, like the tracer: counts every instruction
+// by opcode class and by pc, looks at every DXYN, counts the cycles burnt waiting in FX0A or in jump-to-self
+// loops, and keeps a call tree off 2NNN/00EE so the time can be written out as folded stacks for flamegraph.pl.
+//
+
+#ifndef CHIP8_EMU_PROFILE_H
+#define CHIP8_EMU_PROFILE_H
+
+#include <stdio.h>
+
+#include "decode.h"
+
+struct chip8;
+
+// call tree nodes deeper than this get folded into their parent (the stack only has 16 entries anyway, and a rom
+// that calls without returning would grow the tree forever)
+#define CHIP8_PROFILE_MAX_DEPTH 64
+
+// One function in the call tree, named by the address it was called at. Node 0 is the root, whatever ran before
+// the first call.
+typedef struct chip8_profile_node {
+    unsigned short addr;
+    unsigned short depth;
+    unsigned int parent;
+    unsigned int first_child;
+    unsigned int next_sibling;
+    unsigned long long self;
+} chip8_profile_node_t;
+
+typedef struct chip8_profile {
+    unsigned long long instructions;
+    unsigned long long op_count[CHIP8_OP_COUNT];
+    unsigned long long pc_count[4096];
+
+    // DXYN calls by N: 1 to 15 rows, and DXY0's 16x16 sprites at 0
+    unsigned long long draws[16];
+
+    // instructions that left pc where it was: FX0A with no key down, and everything else (1NNN to itself mostly)
+    unsigned long long key_wait;
+    unsigned long long spin;
+
+    chip8_profile_node_t* nodes;
+    unsigned int node_count;
+    unsigned int node_cap;
+    unsigned int current;
+    // calls past CHIP8_PROFILE_MAX_DEPTH (or with no memory for a node) that were folded into current, so their
+    // 00EEs don't pop it
+    unsigned int folded;
+} chip8_profile_t;
+
+int chip8_profile_open(chip8_profile_t* profile);
+void chip8_profile_close(chip8_profile_t* profile);
+// Zeroes every count and the call tree
+void chip8_profile_reset(chip8_profile_t* profile);
+
+// Sorted text report: totals, the opcode histogram, the top hot pcs (disassembled from chip8's memory) and the
+// DXYN breakdown
+void chip8_profile_report(const chip8_profile_t* profile, const struct chip8* chip8, unsigned int top, FILE* out);
+// One "main;0x2a0;0x316 count" line per call stack that ran anything, what flamegraph.pl takes as input
+void chip8_profile_folded(const chip8_profile_t* profile, FILE* out);
+
+void chip8_profile_write(chip8_profile_t* profile, const struct chip8* chip8, unsigned short pc,
+                         unsigned short opcode);
+
+// Every engine calls this once per instruction, after it ran, next to chip8_trace_op(). Without CHIP8_PROFILE it
+// is nothing at all.
+#ifdef CHIP8_PROFILE
+#define chip8_profile_op(c, op_pc, opcode)                                      \
+    do {                                                                        \
+        if ((c)->profile) chip8_profile_write((c)->profile, c, op_pc, opcode); \
+    } while (0)
+#else
+#define chip8_profile_op(c, op_pc, opcode) do { } while (0)
+#endif
+
+#endif //CHIP8_EMU_PROFILE_H
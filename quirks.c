@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "movie.h"
+#include "quirks.h"
+
+const unsigned int chip8_platform_quirks[CHIP8_PLATFORM_COUNT] = {
+#define QUIRKS(NAME, name) CHIP8_QUIRKS_##NAME,
+    CHIP8_PLATFORM_LIST(QUIRKS)
+#undef QUIRKS
+};
+
+static const char* platform_names[CHIP8_PLATFORM_COUNT] = {
+#define NAME(NAME, name) #name,
+    CHIP8_PLATFORM_LIST(NAME)
+#undef NAME
+};
+
+const char* chip8_platform_name(chip8_platform_t platform) {
+    return platform < CHIP8_PLATFORM_COUNT ? platform_names[platform] : "?";
+}
+
+int chip8_platform_from_name(const char* name) {
+    for (int i = 0; i < CHIP8_PLATFORM_COUNT; i++) {
+        if (strcmp(name, platform_names[i]) == 0)
+            return i;
+    }
+    return -1;
+}
+
+void chip8_set_platform(chip8_t* c, chip8_platform_t platform) {
+    c->platform = platform < CHIP8_PLATFORM_COUNT ? platform : CHIP8_PLATFORM_DEFAULT;
+    chip8_icache_flush(c);
+}
+
+int chip8_platform_lookup(const char* db_file, const chip8_t* c) {
+    FILE* fp = fopen(db_file, "r");
+    if (fp == NULL)
+        return -1;
+
+    unsigned long long hash = chip8_movie_rom_hash(c);
+    char line[256];
+    int platform = -1;
+
+    while (platform < 0 && fgets(line, sizeof line, fp)) {
+        char name[32];
+        unsigned long long h;
+
+        if (line[0] == '#' || sscanf(line, "%llx %31s", &h, name) != 2)
+            continue;
+        if (h == hash)
+            platform = chip8_platform_from_name(name);
+    }
+
+    fclose(fp);
+    return platform;
+}
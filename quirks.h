@@ -0,0 +1,65 @@
+//
+// Quirks: the few instructions that behave differently between CHIP-8 platforms. A platform is a set of quirk
+// flags, and every interpreter core is compiled once per platform with its flags as constants (engine_core.h),
+// so picking a platform picks a core and nothing checks a quirk per instruction. The default platform is what this
+// emulator always did, so existing movies and hashes stay valid.
+//
+// Which platform a rom wants can come from a database file, one rom per line:
+//
+//     <rom hash, 16 hex digits> <platform name> [anything, e.g. the rom's name]
+//
+// The hash is chip8_movie_rom_hash() of the freshly loaded rom, blank lines and lines starting with # are skipped.
+//
+
+#ifndef CHIP8_EMU_QUIRKS_H
+#define CHIP8_EMU_QUIRKS_H
+
+#include "chip8.h"
+
+#define CHIP8_QUIRK_SHIFT_VY    0x01    // 8XY6/8XYE shift Vy into Vx instead of shifting Vx in place
+#define CHIP8_QUIRK_MEM_INC_X1  0x02    // FX55/FX65 leave I at I + X + 1
+#define CHIP8_QUIRK_MEM_INC_X   0x04    // FX55/FX65 leave I at I + X
+#define CHIP8_QUIRK_JUMP_VX     0x08    // BNNN jumps to NNN + VX, X being the top digit of NNN, instead of + V0
+#define CHIP8_QUIRK_CLIP        0x10    // DXYN clips sprites at the right and bottom edges instead of wrapping them
+#define CHIP8_QUIRK_VF_RESET    0x20    // 8XY1/8XY2/8XY3 clear VF
+
+// The platforms: this emulator as it always was, the original COSMAC VIP interpreter, CHIP-48 on the HP-48,
+// SUPER-CHIP 1.1 and XO-CHIP. The SUPER-CHIP / XO-CHIP display instructions work on every platform, these only
+// pick the quirks.
+#define CHIP8_QUIRKS_DEFAULT 0
+#define CHIP8_QUIRKS_VIP (CHIP8_QUIRK_SHIFT_VY | CHIP8_QUIRK_MEM_INC_X1 | CHIP8_QUIRK_CLIP | CHIP8_QUIRK_VF_RESET)
+#define CHIP8_QUIRKS_CHIP48 (CHIP8_QUIRK_MEM_INC_X | CHIP8_QUIRK_JUMP_VX | CHIP8_QUIRK_CLIP)
+#define CHIP8_QUIRKS_SCHIP (CHIP8_QUIRK_JUMP_VX | CHIP8_QUIRK_CLIP)
+#define CHIP8_QUIRKS_XOCHIP (CHIP8_QUIRK_SHIFT_VY | CHIP8_QUIRK_MEM_INC_X1)
+
+// X(NAME, name), in chip8_platform_t order, the quirks being CHIP8_QUIRKS_NAME. DEFAULT has to stay first, a zeroed
+// machine runs it. A new platform also needs its cores instantiated in engine.c.
+#define CHIP8_PLATFORM_LIST(X)  \
+    X(DEFAULT, default)         \
+    X(VIP, vip)                 \
+    X(CHIP48, chip48)           \
+    X(SCHIP, schip)             \
+    X(XOCHIP, xochip)
+
+typedef enum chip8_platform {
+#define CHIP8_PLATFORM_ENUM(NAME, name) CHIP8_PLATFORM_##NAME,
+    CHIP8_PLATFORM_LIST(CHIP8_PLATFORM_ENUM)
+#undef CHIP8_PLATFORM_ENUM
+    CHIP8_PLATFORM_COUNT
+} chip8_platform_t;
+
+// The quirk flags of every platform
+extern const unsigned int chip8_platform_quirks[CHIP8_PLATFORM_COUNT];
+
+const char* chip8_platform_name(chip8_platform_t platform);
+// -1 if there is no platform by that name
+int chip8_platform_from_name(const char* name);
+
+// Switches the machine to another core. Drops the jit blocks and picks the aot program again, both are per platform.
+void chip8_set_platform(chip8_t* chip8, chip8_platform_t platform);
+
+// Looks the rom in memory up in the database file. The platform, or -1 if the rom isn't listed or the file can't be
+// read.
+int chip8_platform_lookup(const char* db_file, const chip8_t* chip8);
+
+#endif //CHIP8_EMU_QUIRKS_H
@@ -0,0 +1,279 @@
+//
+// Ahead-of-time recompiler: translates a rom into C for the aot engine (see aot.h). The code is found by recursive
+// descent from 0x200 over the control flow: jumps, calls and the instruction after them (where RET comes back
+// to), both ways out of every skip, and for BNNN every even offset up to 0xFF (jump tables are tables of 2-byte
+// instructions). Every instruction becomes the op body from ops.h with its operands as constants, plus direct
+// gotos to the static successors; anything dynamic (RET, BNNN) goes through a switch on the pc, and a pc the
+// switch doesn't know hands back to the interpreter.
+//
+// The code is translated for one platform (-q), its quirk flags go into the op bodies as a constant like in
+// the interpreter's cores.
+//
+// Only needs the decoder, so it builds without libchip8 and libchip8 can contain what it generates.
+//
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "decode.h"
+#include "disasm.h"
+#include "quirks.h"
+
+#define ROM_START 0x200
+
+static const char* const op_names[CHIP8_OP_COUNT] = {
+#define NAME(name, handler) "CHIP8_OP_" #name,
+    CHIP8_OP_LIST(NAME)
+#undef NAME
+};
+
+static const char* const handler_names[CHIP8_OP_COUNT] = {
+#define NAME(name, handler) "chip8_op_" #handler,
+    CHIP8_OP_LIST(NAME)
+#undef NAME
+};
+
+static const char* const platform_names[CHIP8_PLATFORM_COUNT] = {
+#define NAME(NAME, name) #name,
+    CHIP8_PLATFORM_LIST(NAME)
+#undef NAME
+};
+
+static const char* const platform_enums[CHIP8_PLATFORM_COUNT] = {
+#define NAME(NAME, name) #NAME,
+    CHIP8_PLATFORM_LIST(NAME)
+#undef NAME
+};
+
+static unsigned char memory[4096];
+static int platform = CHIP8_PLATFORM_DEFAULT;
+static size_t rom_size;
+// reached[a]: there is a translated instruction at a
+static unsigned char reached[4096];
+
+static chip8_decoded_t decode_at(unsigned int addr) {
+    return chip8_decode((unsigned short)(memory[addr] << 8 | memory[addr + 1]));
+}
+
+// Only the rom image gets translated: RAM past it, the font and anything the interpreter doesn't know stay with
+// the interpreter
+static int translatable(unsigned int addr) {
+    return addr >= ROM_START && addr + 1 < ROM_START + rom_size && decode_at(addr).op != CHIP8_OP_UNKNOWN;
+}
+
+// Where the instruction at addr can go next that is known now. RET and BNNN are only partly known: the return
+// address is the instruction after some CALL, and BNNN gets a bounded guess.
+static int successors(unsigned int addr, unsigned int* out) {
+    chip8_decoded_t d = decode_at(addr);
+    int count = 0;
+
+    switch (d.op) {
+        case CHIP8_OP_JP:
+            out[count++] = d.nnn;
+            break;
+        case CHIP8_OP_CALL:
+            out[count++] = d.nnn;
+            out[count++] = addr + 2;
+            break;
+        case CHIP8_OP_RET:
+            break;
+        case CHIP8_OP_JP_V0:
+            for (unsigned int v = 0; v < 0x100; v += 2)
+                out[count++] = d.nnn + v;
+            break;
+        case CHIP8_OP_SE_VX_NN:
+        case CHIP8_OP_SNE_VX_NN:
+        case CHIP8_OP_SE_VX_VY:
+        case CHIP8_OP_SNE_VX_VY:
+        case CHIP8_OP_SKP:
+        case CHIP8_OP_SKNP:
+            out[count++] = addr + 2;
+            out[count++] = addr + 4;
+            break;
+        case CHIP8_OP_LD_VX_K:
+            // waits by not moving on
+            out[count++] = addr;
+            out[count++] = addr + 2;
+            break;
+        default:
+            out[count++] = addr + 2;
+            break;
+    }
+    return count;
+}
+
+// Recursive descent with an explicit stack, returns the number of instructions found. An address is marked when
+// it goes on the stack, so it goes on at most once.
+static int find_code(void) {
+    static unsigned int stack[4096];
+    unsigned int next[128];
+    int top = 0;
+    int found = 0;
+
+    next[0] = ROM_START;
+    int count = 1;
+    for (;;) {
+        for (int i = 0; i < count; i++) {
+            unsigned int addr = next[i];
+            if (addr < sizeof memory - 1 && !reached[addr] && translatable(addr)) {
+                reached[addr] = 1;
+                stack[top++] = addr;
+                found++;
+            }
+        }
+        if (top == 0)
+            break;
+        count = successors(stack[--top], next);
+    }
+    return found;
+}
+
+static void emit_bytes(FILE* out, const char* name, const unsigned char* bytes, size_t size) {
+    fprintf(out, "static const unsigned char %s[%zu] = {", name, size);
+    for (size_t i = 0; i < size; i++)
+        fprintf(out, "%s0x%02X,", i % 16 ? " " : "\n    ", bytes[i]);
+    fprintf(out, "\n};\n\n");
+}
+
+static void emit_instruction(FILE* out, unsigned int addr) {
+    chip8_decoded_t d = decode_at(addr);
+    char text[32];
+    unsigned int next[128];
+
+    chip8_disasm(d.opcode, text, sizeof text);
+    fprintf(out, "L%03X: // %s\n", addr, text);
+    fprintf(out, "    CHIP8_AOT_INSN(0x%03X);\n", addr);
+    fprintf(out, "    %s(c, &(const chip8_decoded_t){%s, 0x%X, 0x%X, 0x%X, 0x%03X, 0x%04X}, CHIP8_QUIRKS_%s);\n",
+            handler_names[d.op], op_names[d.op], d.x, d.y, d.n, d.nnn, d.opcode, platform_enums[platform]);
+
+    // a store that hit the code may have changed what comes next
+    if (d.op == CHIP8_OP_LD_B_VX || d.op == CHIP8_OP_LD_MEM_VX)
+        fprintf(out, "    if (!c->aot_valid) return n;\n");
+
+    // the op just set the pc from a constant, so the compiler folds these into the branch the op made. RET and
+    // BNNN really are dynamic and go through the dispatch switch.
+    if (d.op != CHIP8_OP_RET && d.op != CHIP8_OP_JP_V0) {
+        int count = successors(addr, next);
+        for (int i = 0; i < count; i++)
+            if (next[i] < sizeof memory && reached[next[i]])
+                fprintf(out, "    if (c->pc == 0x%03X) goto L%03X;\n", next[i], next[i]);
+    }
+    fprintf(out, "    goto dispatch;\n\n");
+}
+
+static void emit(FILE* out, const char* rom_file, const char* name, int found) {
+    fprintf(out, "//\n");
+    fprintf(out, "// Generated by chip8-aot from %s, do not edit. %d instructions translated for the %s platform.\n",
+            rom_file, found, platform_names[platform]);
+    fprintf(out, "//\n\n");
+    fprintf(out, "#include \"aot.h\"\n");
+    fprintf(out, "#include \"ops.h\"\n\n");
+
+    unsigned char code[4096 / 8] = {0};
+    for (unsigned int a = 0; a < sizeof memory; a++)
+        if (reached[a]) {
+            code[a / 8] |= 1 << (a % 8);
+            code[(a + 1) / 8] |= 1 << ((a + 1) % 8);
+        }
+    emit_bytes(out, "image", memory + ROM_START, rom_size);
+    emit_bytes(out, "code", code, sizeof code);
+
+    fprintf(out, "static unsigned long run(chip8_t* c, unsigned long n) {\n");
+    fprintf(out, "dispatch:\n");
+    fprintf(out, "    switch (c->pc) {\n");
+    for (unsigned int a = 0; a < sizeof memory; a++)
+        if (reached[a])
+            fprintf(out, "        case 0x%03X: goto L%03X;\n", a, a);
+    fprintf(out, "        default: return n;\n");
+    fprintf(out, "    }\n\n");
+
+    for (unsigned int a = 0; a < sizeof memory; a++)
+        if (reached[a])
+            emit_instruction(out, a);
+
+    fprintf(out, "}\n\n");
+    fprintf(out, "const chip8_aot_program_t chip8_aot_%s = {\"%s\", image, sizeof image, code, run, CHIP8_PLATFORM_%s};\n",
+            name, name, platform_enums[platform]);
+}
+
+// The rom's file name without directories and extension, as a C identifier
+static void default_name(const char* path, char* name, size_t size) {
+    const char* base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+
+    size_t n = 0;
+    if (isdigit((unsigned char)*base))
+        name[n++] = '_';
+    for (; *base && *base != '.' && n + 1 < size; base++)
+        name[n++] = isalnum((unsigned char)*base) ? *base : '_';
+    name[n] = '\0';
+}
+
+int main(int argc, char** argv) {
+    const char* out_file = NULL;
+    char name[64] = "";
+
+    if (argc < 2) {
+        printf("usage: chip8-aot rom.ch8 -o out.c [-n name] [-q platform]\n");
+        printf("  -o F   the C file to write\n");
+        printf("  -n N   program name, the C file defines chip8_aot_N (default: the rom's file name)\n");
+        printf("  -q P   platform to translate for: default, vip, chip48, schip or xochip (default: default)\n");
+        return 1;
+    }
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            out_file = argv[++i];
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            snprintf(name, sizeof name, "%s", argv[++i]);
+        } else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+            const char* wanted = argv[++i];
+            for (platform = CHIP8_PLATFORM_COUNT - 1; platform >= 0; platform--)
+                if (strcmp(wanted, platform_names[platform]) == 0)
+                    break;
+            if (platform < 0) {
+                printf("[FAILED] unknown platform %s\n", wanted);
+                return 1;
+            }
+        } else {
+            printf("[FAILED] unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (out_file == NULL) {
+        printf("[FAILED] no output file, pass -o\n");
+        return 1;
+    }
+    if (name[0] == '\0')
+        default_name(argv[1], name, sizeof name);
+
+    FILE* fp = fopen(argv[1], "rb");
+    if (fp == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    rom_size = fread(memory + ROM_START, 1, sizeof memory - ROM_START, fp);
+    fclose(fp);
+
+    int found = find_code();
+    if (found == 0) {
+        printf("[FAILED] %s doesn't start with an instruction, nothing to translate\n", argv[1]);
+        return 1;
+    }
+
+    FILE* out = fopen(out_file, "w");
+    if (out == NULL) {
+        perror(out_file);
+        return 1;
+    }
+    emit(out, argv[1], name, found);
+    if (fclose(out) != 0) {
+        perror(out_file);
+        return 1;
+    }
+
+    printf("[OK] Translated %d instructions of %s into %s (chip8_aot_%s)\n", found, argv[1], out_file, name);
+    return 0;
+}
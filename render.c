@@ -2,6 +2,8 @@
 // https://github.com/f0lg0/CHIP-8/blob/main/src/peripherals.c
 
 #include "render.h"
+#include <stdatomic.h>
+#include <stdio.h>
 #include <SDL.h>
 //#include <SDL_ttf.h>
 //#include <SDL_image.h>
@@ -11,6 +13,24 @@ SDL_Window* screen;
 
 SDL_Renderer* renderer;
 
+// The whole display lives in one streaming texture, one texel per pixel, and gets scaled up to the window in a
+// single SDL_RenderCopy. The texture is 128x64; in lo-res only its top left 64x32 is used and scaled up. pixels is
+// our copy of it, rows are only re-expanded when the core says they changed.
+SDL_Texture* texture;
+Uint32 pixels[CHIP8_MAX_WIDTH * CHIP8_MAX_HEIGHT];
+SDL_Rect visible = {0, 0, 64, 32};
+
+#define PIXEL_OFF 0xFF000000
+
+// XO-CHIP colours by plane bits: off, plane 0 only, plane 1 only, both. A plain CHIP-8 rom only ever uses the
+// first two.
+Uint32 palette[4] = {PIXEL_OFF, 0xFFFFFFFF, 0xFFAAAAAA, 0xFF555555};
+
+// there is a new frame in the texture that hasn't been presented yet
+int frame_pending = 0;
+Uint64 last_present = 0;
+Uint64 present_interval = 0;
+
 SDL_Scancode keymappings[16] = {
         SDL_SCANCODE_1, SDL_SCANCODE_2, SDL_SCANCODE_3, SDL_SCANCODE_4,
         SDL_SCANCODE_Q, SDL_SCANCODE_W, SDL_SCANCODE_E, SDL_SCANCODE_R,
@@ -18,7 +38,34 @@ SDL_Scancode keymappings[16] = {
         SDL_SCANCODE_Z, SDL_SCANCODE_X, SDL_SCANCODE_C, SDL_SCANCODE_V
 };
 
+// 0 while there is no audio device open
+SDL_AudioDeviceID audio_device = 0;
+
 int QUIT = 0;
+// user event the emulation thread wakes us up with, and whether one is already on its way
+Uint32 frame_event_type = (Uint32)-1;
+atomic_int frame_event_queued = 0;
+
+// HOTKEY_* presses not picked up by take_hotkeys() yet
+unsigned int HOTKEYS = 0;
+
+// The keypad (bit k is key k) and Backspace as of the last key event. Kept up to date from key down / up events,
+// so nothing has to sample the whole keyboard.
+unsigned int KEYS = 0;
+int REWIND = 0;
+
+// Input to photon latency. Every keypad change gets a sequence number and remembers its event timestamp; the
+// first present of a frame that was emulated with it closes the sample.
+#define KEY_STAMPS 64
+unsigned int key_seq = 0;
+Uint32 key_stamps[KEY_STAMPS];
+unsigned int drawn_seq = 0;     // newest keypad change the texture reflects
+unsigned int measured_seq = 0;  // newest keypad change that has been sampled or dropped
+#define LATENCY_BUCKETS 256     // 1 ms each, the last one catches everything slower
+unsigned long latency_hist[LATENCY_BUCKETS];
+unsigned long latency_samples = 0;
+unsigned long long latency_total = 0;
+Uint32 latency_max = 0;
 
 //initializing display
 void initialize_display(void) {
@@ -28,64 +75,293 @@ void initialize_display(void) {
                               SDL_WINDOWPOS_CENTERED, 64 * 8, 32 * 8, 0);
 
     renderer = SDL_CreateRenderer(screen, -1, SDL_RENDERER_ACCELERATED);
-}
 
-void draw(unsigned char* display) {
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    // nearest neighbour, so the upscaled pixels stay sharp
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "0");
+    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+                                CHIP8_MAX_WIDTH, CHIP8_MAX_HEIGHT);
 
-    SDL_RenderClear(renderer);
+    for (int i = 0; i < CHIP8_MAX_WIDTH * CHIP8_MAX_HEIGHT; i++)
+        pixels[i] = PIXEL_OFF;
+    SDL_UpdateTexture(texture, NULL, pixels, CHIP8_MAX_WIDTH * sizeof(Uint32));
+    frame_pending = 1;
 
-    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+    // presenting faster than the monitor refreshes is wasted work, so presents get spaced out by one refresh.
+    // Only 3/4 of one though: the scheduler calls in every 1/60 s give or take some jitter, and on a 60 Hz monitor
+    // a frame arriving a little early must not be pushed back to the one after.
+    SDL_DisplayMode mode;
+    int refresh = 60;
+    if (SDL_GetWindowDisplayMode(screen, &mode) == 0 && mode.refresh_rate > 0)
+        refresh = mode.refresh_rate;
+    present_interval = SDL_GetPerformanceFrequency() * 3 / 4 / refresh;
 
-    // iterating through display
-    for (int y = 0; y < 32; y++) {
-        for (int x = 0; x < 64; x++){
-            if (display[x + (y * 64)]) {
-                SDL_Rect rect;
+    frame_event_type = SDL_RegisterEvents(1);
+}
 
-                rect.x = x * 8;
-                rect.y = y * 8;
-                rect.w = 8;
-                rect.h = 8;
+void draw(const chip8_frame_t* frame, uint64_t dirty_rows) {
+    int width = frame->hires ? 128 : 64;
+    int height = frame->hires ? 64 : 32;
 
-                SDL_RenderFillRect(renderer, &rect);
-            }
+    dirty_rows &= height == 64 ? UINT64_MAX : 0xFFFFFFFFull;
+    if (dirty_rows == 0)
+        return;
+
+    int first = -1;
+    int last = -1;
+
+    // expanding the changed rows into texels
+    for (int y = 0; y < height; y++) {
+        if (!(dirty_rows & (1ull << y)))
+            continue;
+
+        Uint32* out = &pixels[y * CHIP8_MAX_WIDTH];
+        for (int x = 0; x < width; x++) {
+            uint64_t mask = CHIP8_PIXEL_MASK(x);
+            int colour = (frame->display[0][x / 64][y] & mask ? 1 : 0) |
+                         (frame->display[1][x / 64][y] & mask ? 2 : 0);
+            out[x] = palette[colour];
         }
+
+        if (first < 0)
+            first = y;
+        last = y;
     }
 
+    // one upload covering the changed rows
+    SDL_Rect rect;
+    rect.x = 0;
+    rect.y = first;
+    rect.w = width;
+    rect.h = last - first + 1;
+    SDL_UpdateTexture(texture, &rect, &pixels[first * CHIP8_MAX_WIDTH], CHIP8_MAX_WIDTH * sizeof(Uint32));
+
+    visible.w = width;
+    visible.h = height;
+
+    frame_pending = 1;
+}
+
+static void present_now(Uint64 now) {
+    SDL_RenderCopy(renderer, texture, &visible, NULL);
+
     // updating screen
     SDL_RenderPresent(renderer);
+
+    last_present = now;
+    frame_pending = 0;
+
+    // every keypad change this frame was emulated with is on screen now
+    Uint32 ticks = SDL_GetTicks();
+    if (drawn_seq - measured_seq > KEY_STAMPS)
+        measured_seq = drawn_seq - KEY_STAMPS;
+    while (measured_seq != drawn_seq) {
+        measured_seq++;
+        Uint32 latency = ticks - key_stamps[measured_seq % KEY_STAMPS];
+        latency_hist[latency < LATENCY_BUCKETS ? latency : LATENCY_BUCKETS - 1]++;
+        latency_samples++;
+        latency_total += latency;
+        if (latency > latency_max)
+            latency_max = latency;
+    }
+}
+
+void frame_input(unsigned int seq) {
+    drawn_seq = seq;
+
+    // nothing to present means the key didn't change the screen, there is no photon to time
+    if (!frame_pending)
+        measured_seq = drawn_seq;
+}
+
+void present_frame(void) {
+    if (!frame_pending)
+        return;
+
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (now - last_present < present_interval)
+        return;
+
+    present_now(now);
 }
 
-void sdl_ehandler(unsigned char* keypad) {
+void wait_event(void) {
+    // a frame held back by the refresh limit has to go out once the limit is up, otherwise sleep until something
+    // happens: a key, the window, or notify_frame()
+    int timeout = 100;
+    if (frame_pending) {
+        Uint64 since = SDL_GetPerformanceCounter() - last_present;
+        Uint64 left = since < present_interval ? present_interval - since : 0;
+        timeout = (int)(left * 1000 / SDL_GetPerformanceFrequency()) + 1;
+    }
+
+    // NULL leaves the event in the queue for sdl_ehandler()
+    SDL_WaitEventTimeout(NULL, timeout);
+
+    // from here on a new frame needs a new wake up
+    atomic_store(&frame_event_queued, 0);
+}
+
+void notify_frame(void) {
+    // one wake up in the queue at a time, fast forward would otherwise flood it
+    if (frame_event_type == (Uint32)-1 || atomic_exchange(&frame_event_queued, 1))
+        return;
+
     SDL_Event event;
+    SDL_zero(event);
+    event.type = frame_event_type;
+    SDL_PushEvent(&event);
+}
+
+static void key_changed(SDL_Scancode scancode, int down, Uint32 timestamp) {
+    if (scancode == SDL_SCANCODE_BACKSPACE) {
+        REWIND = down;
+        return;
+    }
 
-    //checking for event
-    if (SDL_PollEvent(&event)) {
-        // getting snapshot of current state of the keyboard
-        const Uint8* state = SDL_GetKeyboardState(NULL);
+    for (int keycode = 0; keycode < 16; keycode++) {
+        if (keymappings[keycode] != scancode)
+            continue;
 
+        unsigned int keys = down ? KEYS | 1u << keycode : KEYS & ~(1u << keycode);
+        if (keys != KEYS) {
+            KEYS = keys;
+            key_seq++;
+            key_stamps[key_seq % KEY_STAMPS] = timestamp;
+        }
+        return;
+    }
+}
+
+void sdl_ehandler(void) {
+    SDL_Event event;
+
+    // called once per wake up, so take everything that queued up since the last one
+    while (SDL_PollEvent(&event)) {
         switch (event.type) {
             case SDL_QUIT:
                 QUIT = 1;
                 break;
-            default:
-                if (state[SDL_SCANCODE_ESCAPE]) {
-                    QUIT = 1;
+            case SDL_KEYDOWN:
+                // auto repeat changes nothing, the key was already down
+                if (event.key.repeat)
+                    break;
+                switch (event.key.keysym.scancode) {
+                    case SDL_SCANCODE_ESCAPE: QUIT = 1; break;
+                    case SDL_SCANCODE_TAB: HOTKEYS ^= HOTKEY_FAST_FORWARD; break;
+                    case SDL_SCANCODE_F5: HOTKEYS |= HOTKEY_SAVE_STATE; break;
+                    case SDL_SCANCODE_F9: HOTKEYS |= HOTKEY_LOAD_STATE; break;
+                    default: key_changed(event.key.keysym.scancode, 1, event.key.timestamp); break;
                 }
-                for (int keycode = 0; keycode < 16; keycode++) {
-                    keypad[keycode] = state[keymappings[keycode]];
+                break;
+            case SDL_KEYUP:
+                key_changed(event.key.keysym.scancode, 0, event.key.timestamp);
+                break;
+            case SDL_WINDOWEVENT:
+                // the key up events go to whatever window has the focus now, so let go of everything
+                if (event.window.event == SDL_WINDOWEVENT_FOCUS_LOST) {
+                    for (int keycode = 0; keycode < 16; keycode++)
+                        key_changed(keymappings[keycode], 0, event.window.timestamp);
+                    REWIND = 0;
                 }
                 break;
+            default:
+                break;
         }
     }
 }
 
+unsigned int keypad_keys(void) {
+    return KEYS;
+}
+
+unsigned int key_events(void) {
+    return key_seq;
+}
+
 int should_quit(void) {
     return QUIT;
 }
 
+unsigned int take_hotkeys(void) {
+    unsigned int hotkeys = HOTKEYS;
+    HOTKEYS = 0;
+    return hotkeys;
+}
+
+int rewind_held(void) {
+    return REWIND;
+}
+
+void show_speed(double multiplier) {
+    char title[64];
+
+    if (multiplier > 0)
+        snprintf(title, sizeof title, "CHIP-8 [fast forward %.1fx]", multiplier);
+    else
+        snprintf(title, sizeof title, "CHIP-8");
+    SDL_SetWindowTitle(screen, title);
+}
+
+void report_input_latency(void) {
+    if (latency_samples == 0) {
+        printf("[OK] No key presses reached the screen, no input latency to report\n");
+        return;
+    }
+
+    // percentiles off the 1 ms histogram
+    long median = -1, p95 = -1;
+    unsigned long seen = 0;
+    for (long ms = 0; ms < LATENCY_BUCKETS && p95 < 0; ms++) {
+        seen += latency_hist[ms];
+        if (median < 0 && seen * 2 >= latency_samples)
+            median = ms;
+        if (seen * 100 >= latency_samples * 95)
+            p95 = ms;
+    }
+
+    printf("[OK] Input to photon latency over %lu key events: mean %.1f ms, median %ld ms, 95th %ld ms, max %u ms\n",
+           latency_samples, (double)latency_total / (double)latency_samples, median, p95, (unsigned int)latency_max);
+}
+
+// SDL's audio thread: whatever the emulation thread synthesized, silence if it hasn't kept up
+static void audio_callback(void* userdata, Uint8* stream, int len) {
+    chip8_audio_pull(userdata, (int16_t*)stream, (size_t)len / sizeof(int16_t));
+}
+
+int initialize_audio(chip8_audio_t* audio) {
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0)
+        return -1;
+
+    // 512 samples is ~10 ms a callback at 48 kHz, small enough not to add noticeable latency
+    SDL_AudioSpec want, have;
+    SDL_zero(want);
+    want.freq = (int)audio->rate;
+    want.format = AUDIO_S16SYS;
+    want.channels = 1;
+    want.samples = 512;
+    want.callback = audio_callback;
+    want.userdata = audio;
+
+    audio_device = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
+    if (audio_device == 0) {
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+        return -1;
+    }
+    SDL_PauseAudioDevice(audio_device, 0);
+    return 0;
+}
+
+void stop_audio(void) {
+    if (audio_device == 0)
+        return;
+    SDL_CloseAudioDevice(audio_device);
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    audio_device = 0;
+}
+
 void stop_display(void) {
+    SDL_DestroyTexture(texture);
+    SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(screen);
     SDL_Quit();
 }
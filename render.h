@@ -5,10 +5,47 @@
 #ifndef CHIP8_EMU_RENDER_H
 #define CHIP8_EMU_RENDER_H
 
+#include <stdint.h>
+
+#include "audio.h"
+#include "triple.h"
+
 void initialize_display(void);
-void draw(unsigned char* display);
-void sdl_ehandler(unsigned char* keypad);
+// Uploads the rows set in dirty_rows to the screen texture, at the frame's resolution. Presenting is left to
+// present_frame().
+void draw(const chip8_frame_t* frame, uint64_t dirty_rows);
+// Presents the texture if something was drawn since the last present and a host refresh has passed since then,
+// so no matter how often the rom draws there is at most one present per vsync
+void present_frame(void);
+// Sleeps until there is an event to handle, notify_frame() was called or a held back frame can be presented
+void wait_event(void);
+// Wakes wait_event() up, callable from any thread
+void notify_frame(void);
+// Handles every queued event. The keypad follows key down / up events.
+void sdl_ehandler(void);
+// Bit k is set while key k is down
+unsigned int keypad_keys(void);
+// Counts keypad changes, a frame emulated with the keypad from key_events() == n reflects the first n
+unsigned int key_events(void);
+// The frame drawn last was emulated with the first seq keypad changes; the present that shows it closes their
+// input to photon latency samples
+void frame_input(unsigned int seq);
+// Prints the input to photon latency stats
+void report_input_latency(void);
 int should_quit();
+#define HOTKEY_FAST_FORWARD 1  // Tab, toggles
+#define HOTKEY_SAVE_STATE 2    // F5
+#define HOTKEY_LOAD_STATE 4    // F9
+// The HOTKEY_* bits pressed since the last call (fast forward only if it was pressed an odd number of times)
+unsigned int take_hotkeys(void);
+// Backspace is down
+int rewind_held(void);
+// Puts the achieved speed in the window title, 0 goes back to the plain title
+void show_speed(double multiplier);
+// Plays audio's ring on the default device at audio's rate. -1 if there is no device, the caller can fall back to
+// the null sink.
+int initialize_audio(chip8_audio_t* audio);
+void stop_audio(void);
 void stop_display();
 
 #endif //CHIP8_EMU_RENDER_H
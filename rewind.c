@@ -0,0 +1,236 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rewind.h"
+#include "state.h"
+
+// One recorded frame. A keyframe is its state encoded against an all zero state, a delta is encoded against the
+// frame before it. Either way the data is the XOR of two states, so applying it to one gives the other.
+typedef struct rewind_entry {
+    size_t size;
+    int key;
+    unsigned char data[];
+} rewind_entry_t;
+
+struct chip8_rewind {
+    size_t budget;
+    size_t bytes;
+
+    // circular list of entries, oldest first; the oldest is always a keyframe
+    rewind_entry_t** entries;
+    size_t cap;
+    size_t first;
+    size_t count;
+
+    // frames pushed since the last keyframe
+    unsigned int since_key;
+
+    // the state of the newest entry
+    chip8_state_t head;
+
+    // worst case encoding of a frame: every byte a literal, plus the run headers
+    unsigned char scratch[sizeof(chip8_state_t) + sizeof(chip8_state_t) / 64 + 64];
+};
+
+static const chip8_state_t zero_state;
+
+static inline uint64_t load64(const unsigned char* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof v);
+    return v;
+}
+
+static unsigned char* put_varint(unsigned char* p, size_t v) {
+    while (v >= 0x80) {
+        *p++ = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (unsigned char)v;
+    return p;
+}
+
+static size_t get_varint(const unsigned char** p) {
+    size_t v = 0;
+    for (int shift = 0; ; shift += 7) {
+        unsigned char b = *(*p)++;
+        v |= (size_t)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return v;
+    }
+}
+
+// Encodes a ^ b as (bytes that are equal, bytes that differ, the differing bytes XORed) runs. Runs of literals
+// end once 8 equal bytes come along, shorter gaps are cheaper to carry as literals than as a new run.
+static size_t encode(const chip8_state_t* a, const chip8_state_t* b, unsigned char* out) {
+    const unsigned char* pa = (const unsigned char*)a;
+    const unsigned char* pb = (const unsigned char*)b;
+    const size_t size = sizeof(chip8_state_t);
+    unsigned char* p = out;
+    size_t i = 0;
+
+    while (i < size) {
+        size_t start = i;
+
+        // equal run, a word at a time while it lasts (the state is 8 byte aligned and a multiple of 8 long)
+        while (i < size && (i & 7) == 0 && load64(pa + i) == load64(pb + i))
+            i += 8;
+        while (i < size && pa[i] == pb[i])
+            i++;
+        if (i == size)
+            break;
+
+        size_t lit = i;
+        size_t same = 0;
+        while (i < size && same < 8) {
+            same = pa[i] == pb[i] ? same + 1 : 0;
+            i++;
+        }
+        size_t lit_end = i - same;
+
+        p = put_varint(p, lit - start);
+        p = put_varint(p, lit_end - lit);
+        for (size_t k = lit; k < lit_end; k++)
+            *p++ = pa[k] ^ pb[k];
+
+        i = lit_end;
+    }
+
+    return (size_t)(p - out);
+}
+
+static void apply(chip8_state_t* s, const rewind_entry_t* e) {
+    unsigned char* ps = (unsigned char*)s;
+    const unsigned char* p = e->data;
+    const unsigned char* end = e->data + e->size;
+    size_t i = 0;
+
+    while (p < end) {
+        i += get_varint(&p);
+        size_t lit = get_varint(&p);
+        while (lit--)
+            ps[i++] ^= *p++;
+    }
+}
+
+static rewind_entry_t* entry_at(const chip8_rewind_t* r, size_t n) {
+    return r->entries[(r->first + n) % r->cap];
+}
+
+static void drop_oldest(chip8_rewind_t* r) {
+    rewind_entry_t* e = r->entries[r->first];
+
+    r->bytes -= sizeof *e + e->size;
+    free(e);
+    r->first = (r->first + 1) % r->cap;
+    r->count--;
+}
+
+chip8_rewind_t* chip8_rewind_create(size_t budget) {
+    chip8_rewind_t* r = calloc(1, sizeof *r);
+    if (r == NULL) return NULL;
+
+    r->budget = budget;
+    return r;
+}
+
+void chip8_rewind_clear(chip8_rewind_t* r) {
+    while (r->count)
+        drop_oldest(r);
+    r->first = 0;
+    r->since_key = 0;
+}
+
+void chip8_rewind_destroy(chip8_rewind_t* r) {
+    if (r == NULL) return;
+
+    chip8_rewind_clear(r);
+    free(r->entries);
+    free(r);
+}
+
+void chip8_rewind_push(chip8_rewind_t* r, const chip8_t* c) {
+    chip8_state_t s;
+    chip8_state_save(c, &s);
+
+    int key = r->count == 0 || r->since_key >= CHIP8_REWIND_KEY_INTERVAL;
+    size_t size = encode(&s, key ? &zero_state : &r->head, r->scratch);
+
+    // make room by dropping whole seconds off the old end, a delta is useless without the keyframe before it
+    while (r->count && r->bytes + sizeof(rewind_entry_t) + size > r->budget) {
+        drop_oldest(r);
+        while (r->count && !entry_at(r, 0)->key)
+            drop_oldest(r);
+    }
+    if (r->count == 0 && !key) {
+        key = 1;
+        size = encode(&s, &zero_state, r->scratch);
+    }
+
+    if (r->count == r->cap) {
+        size_t cap = r->cap ? r->cap * 2 : 256;
+        rewind_entry_t** entries = malloc(cap * sizeof *entries);
+        if (entries == NULL) return;
+        for (size_t n = 0; n < r->count; n++)
+            entries[n] = entry_at(r, n);
+        free(r->entries);
+        r->entries = entries;
+        r->cap = cap;
+        r->first = 0;
+    }
+
+    rewind_entry_t* e = malloc(sizeof *e + size);
+    if (e == NULL) return;
+    e->size = size;
+    e->key = key;
+    memcpy(e->data, r->scratch, size);
+
+    r->entries[(r->first + r->count) % r->cap] = e;
+    r->count++;
+    r->bytes += sizeof *e + size;
+    r->since_key = key ? 1 : r->since_key + 1;
+    r->head = s;
+}
+
+int chip8_rewind_pop(chip8_rewind_t* r, chip8_t* c) {
+    if (r->count == 0)
+        return -1;
+
+    chip8_state_load(c, &r->head);
+
+    // step head back to the frame before the one just handed out
+    size_t last = r->count - 1;
+    rewind_entry_t* e = entry_at(r, last);
+
+    if (!e->key) {
+        apply(&r->head, e);
+        r->since_key--;
+    } else if (last > 0) {
+        // a keyframe doesn't say anything about the frame before it, rebuild that from the previous keyframe on
+        size_t k = last - 1;
+        while (!entry_at(r, k)->key)
+            k--;
+
+        r->head = zero_state;
+        for (size_t n = k; n < last; n++)
+            apply(&r->head, entry_at(r, n));
+        r->since_key = (unsigned int)(last - k);
+    } else {
+        r->since_key = 0;
+    }
+
+    r->entries[(r->first + last) % r->cap] = NULL;
+    r->bytes -= sizeof *e + e->size;
+    free(e);
+    r->count--;
+
+    return 0;
+}
+
+size_t chip8_rewind_frames(const chip8_rewind_t* r) {
+    return r->count;
+}
+
+size_t chip8_rewind_bytes(const chip8_rewind_t* r) {
+    return r->bytes;
+}
@@ -0,0 +1,34 @@
+//
+// Rewind buffer: the last however-many seconds of frames, kept in memory. Every frame is stored as the XOR of its
+// state with the frame before, run-length encoded (a frame usually touches a few registers and display rows, so
+// that's tens of bytes), and once a second a whole keyframe goes in. Old seconds are dropped whole to stay under
+// the memory budget.
+//
+
+#ifndef CHIP8_EMU_REWIND_H
+#define CHIP8_EMU_REWIND_H
+
+#include <stddef.h>
+
+#include "chip8.h"
+
+// frames between keyframes
+#define CHIP8_REWIND_KEY_INTERVAL CHIP8_FRAME_HZ
+
+typedef struct chip8_rewind chip8_rewind_t;
+
+// budget is the most memory the stored frames may take, in bytes
+chip8_rewind_t* chip8_rewind_create(size_t budget);
+void chip8_rewind_destroy(chip8_rewind_t* rewind);
+
+// Records the machine as it is now, call it once per frame
+void chip8_rewind_push(chip8_rewind_t* rewind, const chip8_t* chip8);
+// Loads the most recently recorded frame into the machine and forgets it. -1 when there is nothing left.
+int chip8_rewind_pop(chip8_rewind_t* rewind, chip8_t* chip8);
+void chip8_rewind_clear(chip8_rewind_t* rewind);
+
+// frames that can still be rewound, and the memory they take
+size_t chip8_rewind_frames(const chip8_rewind_t* rewind);
+size_t chip8_rewind_bytes(const chip8_rewind_t* rewind);
+
+#endif //CHIP8_EMU_REWIND_H
@@ -0,0 +1,76 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <time.h>
+
+#include "chip8.h"
+#include "sched.h"
+
+#define NSEC_PER_SEC 1000000000ULL
+
+unsigned long long chip8_sched_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * NSEC_PER_SEC + (unsigned long long)ts.tv_nsec;
+}
+
+// when frame f starts. Computed from the start every time instead of adding 1/60 s up, so rounding never drifts.
+static unsigned long long frame_deadline(const chip8_sched_t* s, unsigned long long f) {
+    return s->start + f * NSEC_PER_SEC / (CHIP8_FRAME_HZ * s->speed);
+}
+
+void chip8_sched_init(chip8_sched_t* s, unsigned long ips) {
+    s->ips = ips ? ips : CHIP8_DEFAULT_IPS;
+    s->speed = 1;
+    s->frame = 0;
+    s->start = chip8_sched_now();
+}
+
+void chip8_sched_reset(chip8_sched_t* s) {
+    s->frame = 0;
+    s->start = chip8_sched_now();
+}
+
+void chip8_sched_set_speed(chip8_sched_t* s, unsigned int speed) {
+    // the deadlines so far were spaced for the old speed, start counting again from here
+    s->speed = speed;
+    chip8_sched_reset(s);
+}
+
+unsigned long chip8_sched_instructions(const chip8_sched_t* s) {
+    // ips / 60 rarely divides evenly (700 is 11.67 a frame), so hand out the remainder across the second:
+    // frame f of a second gets everything up to its end minus everything up to its start
+    unsigned long long f = s->frame % CHIP8_FRAME_HZ;
+    return (unsigned long)((f + 1) * s->ips / CHIP8_FRAME_HZ - f * s->ips / CHIP8_FRAME_HZ);
+}
+
+void chip8_sched_advance(chip8_sched_t* s) {
+    s->frame++;
+}
+
+void chip8_sched_wait(chip8_sched_t* s) {
+    s->frame++;
+
+    if (s->speed == 0)
+        return;
+
+    unsigned long long deadline = frame_deadline(s, s->frame);
+    unsigned long long now = chip8_sched_now();
+
+    if (now >= deadline) {
+        // a stall (window drag, debugger, swapped out...) shouldn't be made up for by running flat out afterwards
+        if (now - deadline > CHIP8_SCHED_MAX_LAG * NSEC_PER_SEC / (CHIP8_FRAME_HZ * s->speed)) {
+            s->start = now;
+            s->frame = 0;
+        }
+        return;
+    }
+
+    struct timespec ts;
+    ts.tv_sec = (time_t)(deadline / NSEC_PER_SEC);
+    ts.tv_nsec = (long)(deadline % NSEC_PER_SEC);
+
+    // absolute deadline, so a signal waking us up early just goes back to sleep for the rest
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+}
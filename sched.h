@@ -0,0 +1,44 @@
+//
+// Frame scheduler: the CPU and the 60 Hz timers run on separate clocks. Every 60 Hz frame runs a batch of
+// instructions (ips / 60 of them, spread so a second adds up to exactly ips), ticks the timers once, then sleeps
+// on the monotonic clock for whatever is left of the frame.
+//
+
+#ifndef CHIP8_EMU_SCHED_H
+#define CHIP8_EMU_SCHED_H
+
+// Frames the scheduler is allowed to fall behind before it gives up catching up and starts counting from now
+#define CHIP8_SCHED_MAX_LAG 4
+
+typedef struct chip8_sched {
+    unsigned long ips;
+    // emulated frames per 1/60 s of real time: 1 is normal speed, more is fast forward, 0 is as fast as possible
+    unsigned int speed;
+    // frames since chip8_sched_init() (or the last resync)
+    unsigned long long frame;
+    // monotonic time of frame 0, in nanoseconds
+    unsigned long long start;
+} chip8_sched_t;
+
+// ips == 0 means CHIP8_DEFAULT_IPS
+void chip8_sched_init(chip8_sched_t* sched, unsigned long ips);
+
+// Starts counting frames from now, for after the caller slept through some on purpose
+void chip8_sched_reset(chip8_sched_t* sched);
+
+// Changes the speed multiplier (see chip8_sched_t.speed) from the next frame on
+void chip8_sched_set_speed(chip8_sched_t* sched, unsigned int speed);
+
+// Monotonic clock in nanoseconds, what the deadlines are measured in
+unsigned long long chip8_sched_now(void);
+
+// Instructions to run in the current frame
+unsigned long chip8_sched_instructions(const chip8_sched_t* sched);
+
+// Moves on to the next frame without sleeping, for the headless runners
+void chip8_sched_advance(chip8_sched_t* sched);
+
+// Moves on to the next frame and sleeps until it is due. Returns right away when running late.
+void chip8_sched_wait(chip8_sched_t* sched);
+
+#endif //CHIP8_EMU_SCHED_H
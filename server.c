@@ -0,0 +1,383 @@
+//
+// Step server for agents in another process, see gym.h for the protocol. Every connection gets its own set of
+// environments (machines running the rom) and its own thread, so agents never wait on each other. Observations are
+// written into a memfd shared with the client instead of being sent, the socket only carries small requests and
+// status words.
+//
+
+// memfd_create() goes through syscall(): the glibc wrapper needs _GNU_SOURCE, and with that <pthread.h> wants the
+// cpu sets from the system <sched.h>, which sched.h here shadows
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <linux/memfd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "chip8.h"
+#include "gym.h"
+#include "quirks.h"
+#include "sched.h"
+#include "state.h"
+
+typedef struct rom_image {
+    unsigned char data[CHIP8_MAX_ROM_SIZE];
+    size_t size;
+} rom_image_t;
+
+typedef struct server_config {
+    rom_image_t rom;
+    unsigned long ips;
+    chip8_engine_t engine;
+    chip8_platform_t platform;
+} server_config_t;
+
+// one connection
+typedef struct session {
+    const server_config_t* config;
+    int fd;
+
+    size_t count;
+    chip8_t* envs;
+    chip8_sched_t* scheds;
+    chip8_gym_env_t* shared;    // the memfd mapping, count slots
+    size_t shared_size;
+    chip8_state_t** slots;      // saved states, allocated on first use
+} session_t;
+
+static const char* socket_path = CHIP8_GYM_DEFAULT_SOCKET;
+
+static void usage(void) {
+    printf("usage: chip8-server rom.ch8 [-s socket] [-i ips] [-e engine] [-q platform]\n");
+    printf("  -s F   Unix socket to listen on (default %s)\n", CHIP8_GYM_DEFAULT_SOCKET);
+    printf("  -i N   instructions per second of emulated time, a step frame runs ips / 60 of them (default %d)\n",
+           CHIP8_DEFAULT_IPS);
+    printf("  -e E   engine the environments run on (switch, table, threaded, cached, jit, aot), default threaded\n");
+    printf("  -q P   quirks of platform P (default, vip, chip48, schip, xochip), default is default\n");
+}
+
+static void on_signal(int sig) {
+    unlink(socket_path);
+    _exit(128 + sig);
+}
+
+// Power on: a fresh machine with the rom loaded, like the frontend starts. The machine is either zeroed or was
+// set up before.
+static void reset_env(session_t* s, size_t i, uint64_t seed) {
+    chip8_t* c = &s->envs[i];
+
+    chip8_destroy(c);
+    chip8_init(c);
+    c->engine = s->config->engine;
+    chip8_load_rom_data(c, s->config->rom.data, s->config->rom.size);
+    chip8_set_platform(c, s->config->platform);
+    chip8_seed(c, seed);
+    c->dirty_rows = UINT64_MAX;
+    chip8_sched_init(&s->scheds[i], s->config->ips);
+}
+
+// Copies env i out to the client
+static void publish(session_t* s, size_t i, uint32_t frames) {
+    chip8_gym_env_t* obs = &s->shared[i];
+
+    chip8_state_save(&s->envs[i], &obs->state);
+    obs->dirty_rows = s->envs[i].dirty_rows;
+    obs->frames = frames;
+}
+
+static void send_status(session_t* s, chip8_gym_status_t status) {
+    chip8_gym_response_t response = {status, CHIP8_GYM_VERSION, 0, 0};
+    send(s->fd, &response, sizeof response, MSG_NOSIGNAL);
+}
+
+// Sets up count environments and hands the client the memfd with their observations
+static chip8_gym_status_t open_envs(session_t* s, size_t count, uint64_t seed) {
+    size_t shared_size = count * sizeof(chip8_gym_env_t);
+    chip8_t* envs = calloc(count, sizeof *envs);
+    chip8_sched_t* scheds = calloc(count, sizeof *scheds);
+    chip8_state_t** slots = calloc(CHIP8_GYM_MAX_SLOTS, sizeof *slots);
+    int mfd = (int)syscall(SYS_memfd_create, "chip8-gym", MFD_CLOEXEC);
+    void* shared = MAP_FAILED;
+
+    if (mfd >= 0 && ftruncate(mfd, (off_t)shared_size) == 0)
+        shared = mmap(NULL, shared_size, PROT_READ | PROT_WRITE, MAP_SHARED, mfd, 0);
+    if (envs == NULL || scheds == NULL || slots == NULL || shared == MAP_FAILED) {
+        if (shared != MAP_FAILED)
+            munmap(shared, shared_size);
+        if (mfd >= 0)
+            close(mfd);
+        free(envs);
+        free(scheds);
+        free(slots);
+        return CHIP8_GYM_NO_MEMORY;
+    }
+
+    s->count = count;
+    s->envs = envs;
+    s->scheds = scheds;
+    s->slots = slots;
+    s->shared = shared;
+    s->shared_size = shared_size;
+    for (size_t i = 0; i < count; i++) {
+        reset_env(s, i, seed + i);
+        publish(s, i, 0);
+    }
+
+    // the answer and the fd go out together, after that the server's copy of the fd isn't needed
+    chip8_gym_response_t response = {CHIP8_GYM_OK, CHIP8_GYM_VERSION, s->shared_size, sizeof(chip8_gym_env_t)};
+    struct iovec iov = {&response, sizeof response};
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof control.buf;
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &mfd, sizeof(int));
+
+    sendmsg(s->fd, &msg, MSG_NOSIGNAL);
+    close(mfd);
+    return CHIP8_GYM_OK;
+}
+
+static chip8_gym_status_t step_envs(session_t* s, const chip8_gym_request_t* req, const uint16_t* keys) {
+    for (size_t i = req->env; i < (size_t)req->env + req->count; i++) {
+        chip8_t* c = &s->envs[i];
+        uint16_t down = keys[i - req->env];
+
+        for (int k = 0; k < 16; k++)
+            c->keypad[k] = (down >> k) & 1;
+
+        // same frame loop as the frontend, the keys held for all the frames (action repeat)
+        c->dirty_rows = 0;
+        for (uint32_t f = 0; f < req->frames; f++) {
+            chip8_run_frame(c, chip8_sched_instructions(&s->scheds[i]));
+            chip8_sched_advance(&s->scheds[i]);
+        }
+        publish(s, i, req->frames);
+    }
+    return CHIP8_GYM_OK;
+}
+
+static chip8_gym_status_t save_envs(session_t* s, const chip8_gym_request_t* req) {
+    for (size_t k = 0; k < req->count; k++) {
+        chip8_state_t** slot = &s->slots[req->arg + k];
+        if (*slot == NULL && (*slot = malloc(sizeof **slot)) == NULL)
+            return CHIP8_GYM_NO_MEMORY;
+        chip8_state_save(&s->envs[req->env + k], *slot);
+    }
+    return CHIP8_GYM_OK;
+}
+
+static chip8_gym_status_t load_envs(session_t* s, const chip8_gym_request_t* req) {
+    for (size_t k = 0; k < req->count; k++)
+        if (s->slots[req->arg + k] == NULL)
+            return CHIP8_GYM_EMPTY_SLOT;
+
+    for (size_t k = 0; k < req->count; k++) {
+        size_t i = req->env + k;
+        chip8_state_load(&s->envs[i], s->slots[req->arg + k]);
+        // the frame counter came back with the state, the schedule has to follow it or the instructions per
+        // frame would drift from a run that never rewound
+        chip8_sched_init(&s->scheds[i], s->config->ips);
+        s->scheds[i].frame = s->envs[i].frame_count;
+        publish(s, i, 0);
+    }
+    return CHIP8_GYM_OK;
+}
+
+static chip8_gym_status_t handle(session_t* s, const chip8_gym_request_t* req, size_t size) {
+    size_t expected = sizeof *req + (req->op == CHIP8_GYM_STEP ? req->count * sizeof(uint16_t) : 0);
+
+    if (req->count > CHIP8_GYM_MAX_ENVS || size != expected)
+        return CHIP8_GYM_BAD_REQUEST;
+
+    if (req->op == CHIP8_GYM_OPEN) {
+        if (s->count)
+            return CHIP8_GYM_OUT_OF_ORDER;
+        if (req->env != 0 || req->count == 0)
+            return CHIP8_GYM_BAD_REQUEST;
+        return open_envs(s, req->count, req->arg);
+    }
+
+    if (s->count == 0)
+        return CHIP8_GYM_OUT_OF_ORDER;
+    if ((size_t)req->env + req->count > s->count)
+        return CHIP8_GYM_BAD_REQUEST;
+    if ((req->op == CHIP8_GYM_SAVE || req->op == CHIP8_GYM_LOAD) &&
+        (req->arg > CHIP8_GYM_MAX_SLOTS || req->count > CHIP8_GYM_MAX_SLOTS - req->arg))
+        return CHIP8_GYM_BAD_REQUEST;
+
+    switch (req->op) {
+        case CHIP8_GYM_RESET:
+            for (size_t k = 0; k < req->count; k++) {
+                reset_env(s, req->env + k, req->arg + k);
+                publish(s, req->env + k, 0);
+            }
+            return CHIP8_GYM_OK;
+        case CHIP8_GYM_STEP:
+            return step_envs(s, req, (const uint16_t*)(req + 1));
+        case CHIP8_GYM_SAVE:
+            return save_envs(s, req);
+        case CHIP8_GYM_LOAD:
+            return load_envs(s, req);
+        default:
+            return CHIP8_GYM_BAD_REQUEST;
+    }
+}
+
+static void* session_main(void* arg) {
+    session_t* s = arg;
+    // a request and the keypads of the biggest batch, one word over so an oversized message shows up as such
+    uint64_t buf[(sizeof(chip8_gym_request_t) + CHIP8_GYM_MAX_ENVS * sizeof(uint16_t)) / 8 + 1];
+
+    for (;;) {
+        ssize_t n = recv(s->fd, buf, sizeof buf, 0);
+        if (n <= 0)
+            break;
+
+        chip8_gym_status_t status = CHIP8_GYM_BAD_REQUEST;
+        if ((size_t)n >= sizeof(chip8_gym_request_t))
+            status = handle(s, (const chip8_gym_request_t*)buf, (size_t)n);
+
+        // OPEN answers with the fd itself when it works
+        const chip8_gym_request_t* req = (const chip8_gym_request_t*)buf;
+        if (!((size_t)n >= sizeof *req && req->op == CHIP8_GYM_OPEN && status == CHIP8_GYM_OK))
+            send_status(s, status);
+    }
+
+    printf("[OK] Client %d went away (%zu environments)\n", s->fd, s->count);
+    fflush(stdout);
+    close(s->fd);
+    for (size_t i = 0; i < s->count; i++)
+        chip8_destroy(&s->envs[i]);
+    for (size_t k = 0; s->slots && k < CHIP8_GYM_MAX_SLOTS; k++)
+        free(s->slots[k]);
+    if (s->shared)
+        munmap(s->shared, s->shared_size);
+    free(s->slots);
+    free(s->scheds);
+    free(s->envs);
+    free(s);
+    return NULL;
+}
+
+int main(int argc, char** argv) {
+    static server_config_t config;
+    config.ips = CHIP8_DEFAULT_IPS;
+    config.engine = CHIP8_ENGINE_THREADED;
+
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            config.ips = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            int engine = chip8_engine_from_name(argv[++i]);
+            if (engine < 0) {
+                usage();
+                return 1;
+            }
+            config.engine = (chip8_engine_t)engine;
+        } else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+            int platform = chip8_platform_from_name(argv[++i]);
+            if (platform < 0) {
+                usage();
+                return 1;
+            }
+            config.platform = (chip8_platform_t)platform;
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    if (config.ips == 0) {
+        usage();
+        return 1;
+    }
+
+    DEBUG = 0;
+
+    int status = chip8_read_rom(argv[1], config.rom.data, &config.rom.size);
+    if (status != 0) {
+        fprintf(stderr, "[FAILED] %s: %s\n", argv[1], status == -1 ? "too big for memory" : strerror(status));
+        return 1;
+    }
+
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof addr.sun_path) {
+        fprintf(stderr, "[FAILED] Socket path %s is too long\n", socket_path);
+        return 1;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    // a socket left over from a server that didn't get to clean up would fail the bind
+    struct stat st;
+    if (stat(socket_path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(socket_path);
+
+    int listener = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (listener < 0 || bind(listener, (struct sockaddr*)&addr, sizeof addr) != 0 || listen(listener, 64) != 0) {
+        perror(socket_path);
+        return 1;
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    printf("[OK] Serving %s (%zu bytes) on %s\n", argv[1], config.rom.size, socket_path);
+    fflush(stdout);
+
+    for (;;) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            perror("accept");
+            break;
+        }
+
+        session_t* s = calloc(1, sizeof *s);
+        pthread_t thread;
+        if (s == NULL) {
+            close(fd);
+            continue;
+        }
+        s->config = &config;
+        s->fd = fd;
+        if (pthread_create(&thread, NULL, session_main, s) != 0) {
+            fprintf(stderr, "[FAILED] Couldn't start a thread for client %d\n", fd);
+            close(fd);
+            free(s);
+            continue;
+        }
+        pthread_detach(thread);
+        printf("[OK] Client %d connected\n", fd);
+        fflush(stdout);
+    }
+
+    close(listener);
+    unlink(socket_path);
+    return 1;
+}
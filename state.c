@@ -0,0 +1,199 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "state.h"
+#include "ops.h"
+
+// chip8_state_load() compares memory in chunks this big and only invalidates the chunks that changed
+#define STATE_CHUNK 64
+
+void chip8_state_save(const chip8_t* c, chip8_state_t* s) {
+    memcpy(s->memory, c->memory, sizeof s->memory);
+    memcpy(s->display, c->display, sizeof s->display);
+    s->frame_count = c->frame_count;
+    s->rng = c->rng;
+    memcpy(s->stack, c->stack, sizeof s->stack);
+    s->I = c->I;
+    s->pc = c->pc;
+    memcpy(s->V, c->V, sizeof s->V);
+    s->sp = c->sp;
+    s->delayTimer = c->delayTimer;
+    s->soundTimer = c->soundTimer;
+    s->hires = c->hires;
+    s->planes = c->planes;
+    memset(s->reserved, 0, sizeof s->reserved);
+    s->cycles = (int32_t)c->cycles;
+}
+
+void chip8_state_load(chip8_t* c, const chip8_state_t* s) {
+    // a checkpoint usually has the same code as the running machine, so keep the decoded and compiled code for
+    // everything that didn't change rather than flushing it all
+    int changed = 0;
+    for (unsigned int addr = 0; addr < sizeof c->memory; addr += STATE_CHUNK) {
+        if (memcmp(c->memory + addr, s->memory + addr, STATE_CHUNK) != 0) {
+            memcpy(c->memory + addr, s->memory + addr, STATE_CHUNK);
+            chip8_icache_invalidate(c, addr, STATE_CHUNK);
+            changed = 1;
+        }
+    }
+    // the state may well be of another rom, or of the same one before it overwrote its code
+    if (changed)
+        chip8_aot_attach(c);
+
+    memcpy(c->display, s->display, sizeof c->display);
+    c->frame_count = s->frame_count;
+    c->rng = s->rng ? s->rng : 1;
+    memcpy(c->stack, s->stack, sizeof c->stack);
+    c->I = s->I;
+    c->pc = s->pc;
+    memcpy(c->V, s->V, sizeof c->V);
+    c->sp = s->sp & 0xF;
+    c->delayTimer = s->delayTimer;
+    c->soundTimer = s->soundTimer;
+    c->hires = s->hires != 0;
+    c->planes = s->planes & 3;
+    c->cycles = s->cycles;
+
+    c->dirty_rows = UINT64_MAX;
+    c->draw_flag = 1;
+}
+
+static unsigned char* put16(unsigned char* p, unsigned int v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    return p + 2;
+}
+
+static unsigned char* put64(unsigned char* p, unsigned long long v) {
+    for (int i = 0; i < 8; i++)
+        p[i] = (unsigned char)(v >> (8 * i));
+    return p + 8;
+}
+
+static unsigned char* put32(unsigned char* p, unsigned long v) {
+    for (int i = 0; i < 4; i++)
+        p[i] = (unsigned char)(v >> (8 * i));
+    return p + 4;
+}
+
+static unsigned int get16(const unsigned char** p) {
+    unsigned int v = (*p)[0] | (*p)[1] << 8;
+    *p += 2;
+    return v;
+}
+
+static unsigned long get32(const unsigned char** p) {
+    unsigned long v = 0;
+    for (int i = 0; i < 4; i++)
+        v |= (unsigned long)(*p)[i] << (8 * i);
+    *p += 4;
+    return v;
+}
+
+static unsigned long long get64(const unsigned char** p) {
+    unsigned long long v = 0;
+    for (int i = 0; i < 8; i++)
+        v |= (unsigned long long)(*p)[i] << (8 * i);
+    *p += 8;
+    return v;
+}
+
+void chip8_state_serialize(const chip8_state_t* s, unsigned char* buf) {
+    unsigned char* p = buf;
+
+    memcpy(p, "C8ST", 4);
+    p = put16(p + 4, CHIP8_STATE_VERSION);
+    p = put16(p, 0);
+
+    memcpy(p, s->memory, sizeof s->memory);
+    p += sizeof s->memory;
+    for (int plane = 0; plane < CHIP8_PLANES; plane++)
+        for (int w = 0; w < 2; w++)
+            for (int y = 0; y < CHIP8_MAX_HEIGHT; y++)
+                p = put64(p, s->display[plane][w][y]);
+    p = put64(p, s->frame_count);
+    p = put64(p, s->rng);
+    for (int i = 0; i < 16; i++)
+        p = put16(p, s->stack[i]);
+    p = put16(p, s->I);
+    p = put16(p, s->pc);
+    memcpy(p, s->V, sizeof s->V);
+    p += sizeof s->V;
+    *p++ = s->sp;
+    *p++ = s->delayTimer;
+    *p++ = s->soundTimer;
+    *p++ = s->hires;
+    *p++ = s->planes;
+    put32(p, (uint32_t)s->cycles);
+}
+
+int chip8_state_deserialize(chip8_state_t* s, const unsigned char* buf, size_t size) {
+    const unsigned char* p = buf;
+
+    if (size != CHIP8_STATE_FILE_SIZE || memcmp(p, "C8ST", 4) != 0)
+        return -1;
+    p += 4;
+    if (get16(&p) != CHIP8_STATE_VERSION)
+        return -1;
+    get16(&p);
+
+    memcpy(s->memory, p, sizeof s->memory);
+    p += sizeof s->memory;
+    for (int plane = 0; plane < CHIP8_PLANES; plane++)
+        for (int w = 0; w < 2; w++)
+            for (int y = 0; y < CHIP8_MAX_HEIGHT; y++)
+                s->display[plane][w][y] = get64(&p);
+    s->frame_count = get64(&p);
+    s->rng = get64(&p);
+    for (int i = 0; i < 16; i++)
+        s->stack[i] = (unsigned short)get16(&p);
+    s->I = (unsigned short)get16(&p);
+    s->pc = (unsigned short)get16(&p);
+    memcpy(s->V, p, sizeof s->V);
+    p += sizeof s->V;
+    s->sp = *p++ & 0xF;
+    s->delayTimer = *p++;
+    s->soundTimer = *p++;
+    s->hires = *p++ != 0;
+    s->planes = *p++ & 3;
+    memset(s->reserved, 0, sizeof s->reserved);
+    s->cycles = (int32_t)(uint32_t)get32(&p);
+
+    return 0;
+}
+
+int chip8_state_write_file(const chip8_t* c, const char* filename) {
+    chip8_state_t s;
+    unsigned char buf[CHIP8_STATE_FILE_SIZE];
+
+    chip8_state_save(c, &s);
+    chip8_state_serialize(&s, buf);
+
+    FILE* fp = fopen(filename, "wb");
+    if (fp == NULL) return errno;
+
+    size_t written = fwrite(buf, 1, sizeof buf, fp);
+    if (fclose(fp) != 0 || written != sizeof buf)
+        return errno ? errno : EIO;
+
+    return 0;
+}
+
+int chip8_state_read_file(chip8_t* c, const char* filename) {
+    chip8_state_t s;
+    unsigned char buf[CHIP8_STATE_FILE_SIZE + 1];
+
+    FILE* fp = fopen(filename, "rb");
+    if (fp == NULL) return errno;
+
+    // one byte more than a state, so a longer file is caught as well
+    size_t size = fread(buf, 1, sizeof buf, fp);
+    fclose(fp);
+
+    if (chip8_state_deserialize(&s, buf, size) != 0)
+        return -1;
+
+    chip8_state_load(c, &s);
+    return 0;
+}
@@ -0,0 +1,58 @@
+//
+// Save states. chip8_state_t is a plain snapshot of everything that makes up the machine, taking one or putting one
+// back is a handful of memcpys so a bot can restore a checkpoint thousands of times a second. The serialized form is
+// a small versioned little-endian file for keeping states around between runs.
+//
+
+#ifndef CHIP8_EMU_STATE_H
+#define CHIP8_EMU_STATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+// 2: the random generator state
+// 3: both bit planes at hi-res, the resolution and the selected planes
+// 4: the cycles the VIP timing model carries into the next frame
+#define CHIP8_STATE_VERSION 4
+// "C8ST" magic, u16 version, u16 reserved, then the fields in the order of chip8_state_t
+#define CHIP8_STATE_FILE_SIZE (8 + 4096 + CHIP8_PLANES * 2 * CHIP8_MAX_HEIGHT * 8 + 8 + 8 + 16 * 2 + 2 + 2 + 16 + \
+                               1 + 1 + 1 + 1 + 1 + 4)
+
+// Ordered biggest alignment first and padded out by hand, so there are no padding bytes: two states of the same
+// machine compare (and delta) byte for byte. The host side (keypad, engine, caches, flags) isn't part of it.
+typedef struct chip8_state {
+    unsigned char memory[4096];
+    uint64_t display[CHIP8_PLANES][2][CHIP8_MAX_HEIGHT];
+    unsigned long long frame_count;
+    uint64_t rng;
+    unsigned short stack[16];
+    unsigned short I;
+    unsigned short pc;
+    unsigned char V[16];
+    unsigned char sp;
+    unsigned char delayTimer;
+    unsigned char soundTimer;
+    unsigned char hires;
+    unsigned char planes;
+    unsigned char reserved[3];
+    // chip8_t.cycles, what chip8_run_timed_frame() carries over. 0 unless running on the VIP timing model.
+    int32_t cycles;
+} chip8_state_t;
+
+void chip8_state_save(const chip8_t* chip8, chip8_state_t* state);
+// Puts a state back. Only the decode cache / jit blocks over memory that actually differs get dropped, and every
+// display row is marked dirty so the frontend redraws.
+void chip8_state_load(chip8_t* chip8, const chip8_state_t* state);
+
+// buf has to hold CHIP8_STATE_FILE_SIZE bytes
+void chip8_state_serialize(const chip8_state_t* state, unsigned char* buf);
+// -1 if buf isn't a state this version can read
+int chip8_state_deserialize(chip8_state_t* state, const unsigned char* buf, size_t size);
+
+// 0 on success, errno if the file couldn't be opened or written, -1 if it isn't a valid state
+int chip8_state_write_file(const chip8_t* chip8, const char* filename);
+int chip8_state_read_file(chip8_t* chip8, const char* filename);
+
+#endif //CHIP8_EMU_STATE_H
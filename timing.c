@@ -0,0 +1,109 @@
+#include "decode.h"
+#include "idle.h"
+#include "timing.h"
+
+// What each instruction takes past the fetch, in machine cycles. Approximate, after the published timings of the
+// VIP interpreter; where the real time depends on the data (BCD of different values, a skip taken or not) this is
+// the average. DXYN and FX55/FX65 depend on their operands and are worked out in chip8_vip_cycles(). The
+// SUPER-CHIP / XO-CHIP instructions never ran on a VIP, they get what the closest VIP instruction takes.
+static const unsigned short op_cycles[CHIP8_OP_COUNT] = {
+        [CHIP8_OP_UNKNOWN] = 23,    // 0NNN, a machine code routine nobody knows the length of
+        [CHIP8_OP_CLS] = 24,
+        [CHIP8_OP_RET] = 23,
+        [CHIP8_OP_JP] = 23,
+        [CHIP8_OP_CALL] = 23,
+        [CHIP8_OP_SE_VX_NN] = 12,
+        [CHIP8_OP_SNE_VX_NN] = 12,
+        [CHIP8_OP_SE_VX_VY] = 16,
+        [CHIP8_OP_LD_VX_NN] = 6,
+        [CHIP8_OP_ADD_VX_NN] = 10,
+        // 8XYN all go through the same patched-in 1802 ALU instruction
+        [CHIP8_OP_LD_VX_VY] = 44,
+        [CHIP8_OP_OR] = 44,
+        [CHIP8_OP_AND] = 44,
+        [CHIP8_OP_XOR] = 44,
+        [CHIP8_OP_ADD_VX_VY] = 44,
+        [CHIP8_OP_SUB] = 44,
+        [CHIP8_OP_SHR] = 44,
+        [CHIP8_OP_SUBN] = 44,
+        [CHIP8_OP_SHL] = 44,
+        [CHIP8_OP_SNE_VX_VY] = 16,
+        [CHIP8_OP_LD_I] = 12,
+        [CHIP8_OP_JP_V0] = 23,
+        [CHIP8_OP_RND] = 36,
+        [CHIP8_OP_DRW] = 26,
+        [CHIP8_OP_SKP] = 16,
+        [CHIP8_OP_SKNP] = 16,
+        [CHIP8_OP_LD_VX_DT] = 10,
+        [CHIP8_OP_LD_VX_K] = 10,    // per time round while no key is down
+        [CHIP8_OP_LD_DT_VX] = 10,
+        [CHIP8_OP_LD_ST_VX] = 10,
+        [CHIP8_OP_ADD_I_VX] = 19,
+        [CHIP8_OP_LD_F_VX] = 20,
+        [CHIP8_OP_LD_B_VX] = 204,
+        [CHIP8_OP_LD_MEM_VX] = 14,
+        [CHIP8_OP_LD_VX_MEM] = 14,
+        [CHIP8_OP_SCD] = 24,
+        [CHIP8_OP_SCU] = 24,
+        [CHIP8_OP_SCR] = 24,
+        [CHIP8_OP_SCL] = 24,
+        [CHIP8_OP_LOW] = 24,
+        [CHIP8_OP_HIGH] = 24,
+        [CHIP8_OP_PLANE] = 6,
+};
+
+// per byte of sprite written to the screen, and per register FX55 / FX65 move
+#define DRW_BYTE_CYCLES 12
+#define MEM_REG_CYCLES 14
+
+unsigned int chip8_vip_cycles(const chip8_t* c, const chip8_decoded_t* d) {
+    unsigned int cycles = CHIP8_VIP_FETCH_CYCLES + op_cycles[d->op];
+
+    switch (d->op) {
+        case CHIP8_OP_DRW: {
+            // a sprite row that doesn't start on a byte boundary straddles two screen bytes
+            unsigned int rows = d->n ? d->n : 16;
+            unsigned int bytes = (d->n ? 1 : 2) + (c->V[d->x] % 8 != 0);
+            cycles += rows * bytes * DRW_BYTE_CYCLES;
+            break;
+        }
+        case CHIP8_OP_LD_MEM_VX:
+        case CHIP8_OP_LD_VX_MEM:
+            cycles += (d->x + 1) * MEM_REG_CYCLES;
+            break;
+    }
+    return cycles;
+}
+
+unsigned long chip8_run_timed_frame(chip8_t* c) {
+    long cycles = c->cycles + CHIP8_VIP_FRAME_BUDGET;
+    unsigned long ran = 0;
+    unsigned char draw = 0;
+    unsigned char sound = 0;
+
+    // only for chip8_t.idle, an idle loop still has to spend the frame's cycles going round
+    chip8_idle_probe(c, 0);
+
+    while (cycles > 0) {
+        const chip8_decoded_t* d = &chip8_decoded[c->memory[c->pc & 0xFFF] << 8 | c->memory[(c->pc + 1) & 0xFFF]];
+
+        // waiting for the vertical blank: the rest of the frame goes by, the draw is the next frame's first thing
+        if (d->op == CHIP8_OP_DRW && ran > 0) {
+            cycles = 0;
+            break;
+        }
+
+        cycles -= chip8_vip_cycles(c, d);
+        chip8_step(c, 1);
+        draw |= c->draw_flag;
+        sound |= c->sound_flag;
+        ran++;
+    }
+    c->cycles = cycles;
+
+    c->draw_flag = draw;
+    c->sound_flag = sound;
+    chip8_tick_timers(c);
+    c->frame_count++;
+    return ran;
+}
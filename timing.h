@@ -0,0 +1,37 @@
+//
+// COSMAC VIP timing model. Instead of a flat number of instructions per frame, every instruction costs what it
+// took the original interpreter in 1802 machine cycles (8 clocks of the 1.76 MHz CPU, about 4.5 us), and a frame
+// runs instructions until its cycles are used up. A frame of 00E0s and FX55s gets far fewer instructions than one
+// of 6XNNs, like on the real thing.
+//
+// DXYN waits for the vertical blank before it draws: a DXYN the frame comes to after having run something else
+// ends the frame there, and runs first thing in the next one. So there is at most one draw per frame.
+//
+
+#ifndef CHIP8_EMU_TIMING_H
+#define CHIP8_EMU_TIMING_H
+
+#include "chip8.h"
+
+// 1760900 Hz / 8 clocks a machine cycle / 60 Hz
+#define CHIP8_VIP_CYCLES_PER_FRAME 3668
+// the display DMA steals a machine cycle for every byte it shows: 32 rows of 8 bytes, each row shown 4 times
+#define CHIP8_VIP_DMA_CYCLES 1024
+// what the interpreter gets of a frame
+#define CHIP8_VIP_FRAME_BUDGET (CHIP8_VIP_CYCLES_PER_FRAME - CHIP8_VIP_DMA_CYCLES)
+// fetching and decoding, every instruction pays this on top of its own cost
+#define CHIP8_VIP_FETCH_CYCLES 40
+
+// Machine cycles the instruction d is going to take on c, fetch included
+unsigned int chip8_vip_cycles(const chip8_t* chip8, const chip8_decoded_t* d);
+
+// One frame paced by chip8_vip_cycles(): as many instructions as fit in CHIP8_VIP_FRAME_BUDGET, then one timer
+// tick. A frame that overran its budget takes it out of the next one (chip8_t.cycles). Sets chip8->idle like
+// chip8_run_frame(). Returns the number of instructions run.
+//
+// The cost of an instruction depends on the registers it runs with, so it goes one chip8_step(chip8, 1) at a
+// time. That is cheap on the interpreters but the jit and aot engines pay their entry and exit on every
+// instruction, and run timed frames slower than the cached engine does.
+unsigned long chip8_run_timed_frame(chip8_t* chip8);
+
+#endif //CHIP8_EMU_TIMING_H
@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "chip8.h"
+#include "trace.h"
+
+int chip8_trace_open(chip8_trace_t* trace, size_t capacity) {
+    size_t cap = 1;
+    while (cap < capacity)
+        cap <<= 1;
+
+    trace->records = malloc(cap * sizeof *trace->records);
+    if (trace->records == NULL) return -1;
+
+    trace->count = 0;
+    trace->mask = cap - 1;
+
+    return 0;
+}
+
+void chip8_trace_close(chip8_trace_t* trace) {
+    free(trace->records);
+    trace->records = NULL;
+}
+
+void chip8_trace_write(chip8_trace_t* trace, const chip8_t* c, unsigned short pc, unsigned short opcode) {
+    chip8_trace_record_t* r = &trace->records[trace->count++ & trace->mask];
+    unsigned char reg = chip8_trace_dest(opcode);
+
+    r->pc = pc;
+    r->opcode = opcode;
+    r->I = c->I;
+    r->reg = reg;
+    r->value = reg == CHIP8_TRACE_NO_REG ? 0 : c->V[reg];
+}
+
+static void put16(unsigned char* p, unsigned int v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+static void put32(unsigned char* p, unsigned long v) {
+    put16(p, v & 0xFFFF);
+    put16(p + 2, (v >> 16) & 0xFFFF);
+}
+
+int chip8_trace_dump(const chip8_trace_t* trace, const char* filename) {
+    FILE* fp = fopen(filename, "wb");
+    if (fp == NULL) return -1;
+
+    size_t cap = trace->mask + 1;
+    size_t n = trace->count < cap ? (size_t)trace->count : cap;
+    unsigned long long first = trace->count - n;
+
+    unsigned char header[20];
+    header[0] = CHIP8_TRACE_MAGIC[0];
+    header[1] = CHIP8_TRACE_MAGIC[1];
+    header[2] = CHIP8_TRACE_MAGIC[2];
+    header[3] = CHIP8_TRACE_MAGIC[3];
+    put16(header + 4, CHIP8_TRACE_VERSION);
+    put16(header + 6, 8);
+    put32(header + 8, (unsigned long)n);
+    put32(header + 12, (unsigned long)(trace->count & 0xFFFFFFFFUL));
+    put32(header + 16, (unsigned long)(trace->count >> 32));
+    fwrite(header, 1, sizeof header, fp);
+
+    for (size_t i = 0; i < n; i++) {
+        const chip8_trace_record_t* r = &trace->records[(first + i) & trace->mask];
+        unsigned char out[8];
+
+        put16(out, r->pc);
+        put16(out + 2, r->opcode);
+        put16(out + 4, r->I);
+        out[6] = r->reg;
+        out[7] = r->value;
+        fwrite(out, 1, sizeof out, fp);
+    }
+
+    int failed = ferror(fp);
+    fclose(fp);
+
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,76 @@
+//
+// Binary instruction trace. Only does anything in builds with CHIP8_TRACE defined.
+//
+
+#ifndef CHIP8_EMU_TRACE_H
+#define CHIP8_EMU_TRACE_H
+
+#include <stddef.h>
+
+struct chip8;
+
+#define CHIP8_TRACE_MAGIC "C8TR"
+#define CHIP8_TRACE_VERSION 1
+
+// reg value for instructions that don't write a V register
+#define CHIP8_TRACE_NO_REG 0xFF
+
+// One executed instruction: where it was, the opcode, then I and the V register it wrote (and its new value) as
+// they were after it ran. Fixed size so writing one is just a few stores.
+typedef struct chip8_trace_record {
+    unsigned short pc;
+    unsigned short opcode;
+    unsigned short I;
+    unsigned char reg;
+    unsigned char value;
+} chip8_trace_record_t;
+
+// Ring of the most recent records. capacity is a power of two so the index is a mask, and count keeps going up
+// forever so we know how much got dropped.
+typedef struct chip8_trace {
+    chip8_trace_record_t* records;
+    unsigned long long count;
+    size_t mask;
+} chip8_trace_t;
+
+// capacity gets rounded up to a power of two
+int chip8_trace_open(chip8_trace_t* trace, size_t capacity);
+void chip8_trace_close(chip8_trace_t* trace);
+
+// Writes the buffered records, oldest first. The file is a 20 byte header ("C8TR", version, record size, record
+// count, total instructions traced) followed by the records, all little endian.
+int chip8_trace_dump(const chip8_trace_t* trace, const char* filename);
+
+// Which V register an opcode writes, CHIP8_TRACE_NO_REG if none. VF written as a flag doesn't count,
+// except for DXYN where it is the only register written.
+static inline unsigned char chip8_trace_dest(unsigned short opcode) {
+    switch (opcode >> 12) {
+        case 0x6: case 0x7: case 0x8: case 0xC:
+            return (opcode >> 8) & 0xF;
+        case 0xD:
+            return 0xF;
+        case 0xF:
+            switch (opcode & 0xFF) {
+                case 0x07: case 0x0A: case 0x65:
+                    return (opcode >> 8) & 0xF;
+            }
+            break;
+    }
+    return CHIP8_TRACE_NO_REG;
+}
+
+void chip8_trace_write(chip8_trace_t* trace, const struct chip8* chip8, unsigned short pc, unsigned short opcode);
+
+// Tracing is compiled in with -DCHIP8_TRACE (the CHIP8_TRACE cmake option). It used to be a runtime DEBUG check
+// plus an fprintf per opcode, which cost more than the emulation. Now a release build has nothing left of it, and
+// a tracing build writes one record per instruction into the ring. Every engine calls this once per instruction.
+#ifdef CHIP8_TRACE
+#define chip8_trace_op(c, op_pc, opcode)                                  \
+    do {                                                                  \
+        if ((c)->trace) chip8_trace_write((c)->trace, c, op_pc, opcode); \
+    } while (0)
+#else
+#define chip8_trace_op(c, op_pc, opcode) do { } while (0)
+#endif
+
+#endif //CHIP8_EMU_TRACE_H
@@ -0,0 +1,72 @@
+//
+// Offline decoder for the binary traces written by chip8_trace_dump(). Prints one disassembled line per record.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "disasm.h"
+#include "trace.h"
+
+static unsigned int get16(const unsigned char* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static unsigned long get32(const unsigned char* p) {
+    return get16(p) | ((unsigned long)get16(p + 2) << 16);
+}
+
+int main(int argc, char** argv) {
+    unsigned long last = 0;
+
+    if (argc != 2 && !(argc == 4 && strcmp(argv[2], "-n") == 0)) {
+        printf("usage: chip8-tracedump file.trace [-n last]\n");
+        return 1;
+    }
+    if (argc == 4)
+        last = strtoul(argv[3], NULL, 10);
+
+    FILE* fp = fopen(argv[1], "rb");
+    if (fp == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    unsigned char header[20];
+    if (fread(header, 1, sizeof header, fp) != sizeof header || memcmp(header, CHIP8_TRACE_MAGIC, 4) != 0) {
+        printf("[FAILED] %s is not a chip8 trace\n", argv[1]);
+        fclose(fp);
+        return 1;
+    }
+    if (get16(header + 4) != CHIP8_TRACE_VERSION || get16(header + 6) != 8) {
+        printf("[FAILED] unsupported trace version %u\n", get16(header + 4));
+        fclose(fp);
+        return 1;
+    }
+
+    unsigned long n = get32(header + 8);
+    unsigned long long total = get32(header + 12) | ((unsigned long long)get32(header + 16) << 32);
+    unsigned long long first = total - n;
+
+    printf("; %llu instructions traced, %lu kept (from #%llu)\n", total, n, first);
+
+    unsigned long skip = (last && last < n) ? n - last : 0;
+    if (skip)
+        fseek(fp, (long)skip * 8, SEEK_CUR);
+
+    unsigned char rec[8];
+    char text[32];
+    for (unsigned long i = skip; i < n && fread(rec, 1, sizeof rec, fp) == sizeof rec; i++) {
+        unsigned int opcode = get16(rec + 2);
+        chip8_disasm((unsigned short)opcode, text, sizeof text);
+
+        printf("%10llu  %03X  %04X  %-16s I=%03X", first + i, get16(rec), opcode, text, get16(rec + 4));
+        if (rec[6] != CHIP8_TRACE_NO_REG)
+            printf("  V%X=%02X", rec[6], rec[7]);
+        printf("\n");
+    }
+
+    fclose(fp);
+    return 0;
+}
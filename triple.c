@@ -0,0 +1,40 @@
+#include <string.h>
+
+#include "triple.h"
+
+void chip8_triple_init(chip8_triple_t* t) {
+    memset(t->slots, 0, sizeof t->slots);
+    t->back = 0;
+    atomic_init(&t->middle, 1);
+    t->front = 2;
+}
+
+chip8_frame_t* chip8_triple_back(chip8_triple_t* t) {
+    return &t->slots[t->back];
+}
+
+void chip8_triple_publish(chip8_triple_t* t) {
+    // release: the reader that picks this slot up sees everything written to it
+    unsigned int old = atomic_exchange_explicit(&t->middle, t->back | CHIP8_TRIPLE_FRESH, memory_order_acq_rel);
+    t->back = old & 3;
+}
+
+void chip8_triple_publish_machine(chip8_triple_t* t, const chip8_t* c) {
+    chip8_frame_t* f = chip8_triple_back(t);
+
+    memcpy(f->display, c->display, sizeof f->display);
+    f->hires = c->hires;
+    f->frame_count = c->frame_count;
+    f->sound = c->soundTimer > 0;
+    chip8_triple_publish(t);
+}
+
+const chip8_frame_t* chip8_triple_take(chip8_triple_t* t) {
+    if (!(atomic_load_explicit(&t->middle, memory_order_relaxed) & CHIP8_TRIPLE_FRESH))
+        return NULL;
+
+    // acquire: pairs with the release in publish
+    unsigned int old = atomic_exchange_explicit(&t->middle, t->front, memory_order_acq_rel);
+    t->front = old & 3;
+    return &t->slots[t->front];
+}
@@ -0,0 +1,49 @@
+//
+// Lock-free triple buffer for handing finished frames from the emulation thread to whoever shows them. The writer
+// always has a slot of its own to fill, the reader always has one of its own to read, and the third is swapped
+// between them with one atomic exchange. Neither side ever waits for the other; a reader that falls behind just
+// gets the newest frame and never sees the ones in between.
+//
+
+#ifndef CHIP8_EMU_TRIPLE_H
+#define CHIP8_EMU_TRIPLE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+// What a frame looks like to the outside
+typedef struct chip8_frame {
+    uint64_t display[CHIP8_PLANES][2][CHIP8_MAX_HEIGHT];
+    unsigned char hires;
+    unsigned long long frame_count;
+    unsigned char sound;
+    // which input the frame was emulated with, up to the frontend (publish_machine leaves it alone)
+    unsigned int input_seq;
+} chip8_frame_t;
+
+typedef struct chip8_triple {
+    chip8_frame_t slots[3];
+    // index of the shared slot, plus CHIP8_TRIPLE_FRESH when the writer put a frame there the reader hasn't taken
+    atomic_uint middle;
+    // only ever touched by the writer / the reader
+    unsigned int back;
+    unsigned int front;
+} chip8_triple_t;
+
+#define CHIP8_TRIPLE_FRESH 4u
+
+void chip8_triple_init(chip8_triple_t* triple);
+
+// Writer: fill the back slot, then publish it
+chip8_frame_t* chip8_triple_back(chip8_triple_t* triple);
+void chip8_triple_publish(chip8_triple_t* triple);
+// Fills the back slot from the machine and publishes it, input_seq is whatever the caller put in the back slot
+void chip8_triple_publish_machine(chip8_triple_t* triple, const chip8_t* chip8);
+
+// Reader: the newest published frame, NULL if nothing was published since the last call. The frame stays valid
+// until the next call.
+const chip8_frame_t* chip8_triple_take(chip8_triple_t* triple);
+
+#endif //CHIP8_EMU_TRIPLE_H
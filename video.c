@@ -0,0 +1,306 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "video.h"
+
+// stdio buffer for raw / y4m, big enough that a pipe into ffmpeg sees few, large writes
+#define VIDEO_BUFFER_SIZE (1 << 20)
+
+// y4m is limited range: black is 16, white 235
+#define LUMA_OFF 16
+#define LUMA_ON 235
+
+static int io_error(void) {
+    return errno ? errno : EIO;
+}
+
+int chip8_video_format_from_name(const char* name) {
+    if (strcmp(name, "raw") == 0) return CHIP8_VIDEO_RAW;
+    if (strcmp(name, "y4m") == 0) return CHIP8_VIDEO_Y4M;
+    if (strcmp(name, "png") == 0) return CHIP8_VIDEO_PNG;
+    return -1;
+}
+
+int chip8_video_open(chip8_video_t* v, chip8_video_format_t format, const char* path, unsigned int scale,
+                     int hires) {
+    memset(v, 0, sizeof *v);
+    v->format = format;
+    v->scale = scale ? scale : 1;
+    v->words = hires ? 2 : 1;
+    v->height = hires ? 64 : 32;
+    // raw is 1 bit a pixel as is, there is nothing to scale
+    if (format == CHIP8_VIDEO_RAW)
+        v->scale = 1;
+
+    if (format == CHIP8_VIDEO_PNG) {
+        v->prefix = path;
+        return 0;
+    }
+
+    if (format == CHIP8_VIDEO_Y4M) {
+        size_t span = 8 * (size_t)v->scale;
+        v->lut = malloc(256 * span);
+        v->line = malloc(64 * v->words * (size_t)v->scale);
+        if (v->lut == NULL || v->line == NULL) {
+            chip8_video_close(v);
+            return -1;
+        }
+        for (int b = 0; b < 256; b++)
+            for (size_t i = 0; i < span; i++)
+                v->lut[b * span + i] = (b >> (7 - i / v->scale)) & 1 ? LUMA_ON : LUMA_OFF;
+    }
+
+    // stdout gets a stream of its own, so it can have the big buffer and be closed like a file
+    errno = 0;
+    if (strcmp(path, "-") == 0) {
+        int fd = dup(STDOUT_FILENO);
+        v->out = fd < 0 ? NULL : fdopen(fd, "wb");
+        if (v->out == NULL && fd >= 0)
+            close(fd);
+    } else {
+        v->out = fopen(path, "wb");
+    }
+    if (v->out == NULL) {
+        int err = io_error();
+        chip8_video_close(v);
+        return err;
+    }
+    v->buffer = malloc(VIDEO_BUFFER_SIZE);
+    if (v->buffer)
+        setvbuf(v->out, v->buffer, _IOFBF, VIDEO_BUFFER_SIZE);
+
+    if (format == CHIP8_VIDEO_Y4M) {
+        if (fprintf(v->out, "YUV4MPEG2 W%u H%u F%d:1 Ip A1:1 Cmono\n", 64 * v->words * v->scale,
+                    v->height * v->scale, CHIP8_FRAME_HZ) < 0) {
+            int err = io_error();
+            chip8_video_close(v);
+            return err;
+        }
+    }
+    return 0;
+}
+
+// The 32 pixels of x each twice, 0b1011 -> 0b11001111
+static uint64_t double_pixels(uint32_t x) {
+    uint64_t s = x;
+    s = (s | s << 16) & 0x0000FFFF0000FFFFULL;
+    s = (s | s << 8) & 0x00FF00FF00FF00FFULL;
+    s = (s | s << 4) & 0x0F0F0F0F0F0F0F0FULL;
+    s = (s | s << 2) & 0x3333333333333333ULL;
+    s = (s | s << 1) & 0x5555555555555555ULL;
+    return s | s << 1;
+}
+
+// Row y of the stream as v->words words: the bit planes or'ed together, and scaled to the stream's resolution
+// when the machine is at the other one
+static void stream_row(const chip8_video_t* v, const chip8_t* c, unsigned int y, uint64_t row[2]) {
+    if (c->hires == (v->words == 2)) {
+        row[0] = c->display[0][0][y] | c->display[1][0][y];
+        row[1] = c->display[0][1][y] | c->display[1][1][y];
+    } else if (c->hires) {
+        // every other pixel of every other row
+        uint64_t left = c->display[0][0][2 * y] | c->display[1][0][2 * y];
+        uint64_t right = c->display[0][1][2 * y] | c->display[1][1][2 * y];
+        row[0] = 0;
+        for (int x = 0; x < 32; x++) {
+            row[0] |= (left >> (63 - 2 * x) & 1) << (63 - x);
+            row[0] |= (right >> (63 - 2 * x) & 1) << (31 - x);
+        }
+        row[1] = 0;
+    } else {
+        uint64_t lo = c->display[0][0][y / 2] | c->display[1][0][y / 2];
+        row[0] = double_pixels((uint32_t)(lo >> 32));
+        row[1] = double_pixels((uint32_t)lo);
+    }
+}
+
+static int write_raw(chip8_video_t* v, const chip8_t* c) {
+    // the rows are already 1 bit a pixel, they only need to go out big-endian
+    unsigned char frame[64 * 16];
+    size_t stride = 8 * v->words;
+    for (unsigned int y = 0; y < v->height; y++) {
+        uint64_t row[2];
+        stream_row(v, c, y, row);
+        for (unsigned int w = 0; w < v->words; w++)
+            for (int i = 0; i < 8; i++)
+                frame[y * stride + w * 8 + i] = (unsigned char)(row[w] >> (56 - 8 * i));
+    }
+    return fwrite(frame, v->height * stride, 1, v->out) == 1 ? 0 : io_error();
+}
+
+static int write_y4m(chip8_video_t* v, const chip8_t* c) {
+    size_t span = 8 * (size_t)v->scale;
+    size_t width = 64 * v->words * (size_t)v->scale;
+
+    if (fputs("FRAME\n", v->out) == EOF)
+        return io_error();
+
+    // one scaled line per row, eight pixels at a time out of the table, then written scale times
+    for (unsigned int y = 0; y < v->height; y++) {
+        uint64_t row[2];
+        stream_row(v, c, y, row);
+        for (unsigned int w = 0; w < v->words; w++)
+            for (int i = 0; i < 8; i++)
+                memcpy(v->line + (w * 8 + i) * span, v->lut + ((row[w] >> (56 - 8 * i)) & 0xFF) * span, span);
+        for (unsigned int r = 0; r < v->scale; r++)
+            if (fwrite(v->line, width, 1, v->out) != 1)
+                return io_error();
+    }
+    return 0;
+}
+
+// bit at a time: it only runs for the odd snapshot, and without a table there is nothing to set up or share
+// between threads
+static uint32_t crc32_update(uint32_t crc, const unsigned char* p, size_t n) {
+    crc = ~crc;
+    while (n--) {
+        crc ^= *p++;
+        for (int b = 0; b < 8; b++)
+            crc = crc & 1 ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+    }
+    return ~crc;
+}
+
+static void put_be32(unsigned char* p, uint32_t x) {
+    p[0] = (unsigned char)(x >> 24);
+    p[1] = (unsigned char)(x >> 16);
+    p[2] = (unsigned char)(x >> 8);
+    p[3] = (unsigned char)x;
+}
+
+static int write_chunk(FILE* f, const char* type, const unsigned char* data, size_t n) {
+    unsigned char head[8];
+    unsigned char tail[4];
+
+    put_be32(head, (uint32_t)n);
+    memcpy(head + 4, type, 4);
+    uint32_t crc = crc32_update(crc32_update(0, head + 4, 4), data, n);
+    put_be32(tail, crc);
+
+    if (fwrite(head, sizeof head, 1, f) != 1 || (n && fwrite(data, n, 1, f) != 1) || fwrite(tail, sizeof tail, 1, f) != 1)
+        return io_error();
+    return 0;
+}
+
+// A 1-bit grayscale png. The image data goes into stored (uncompressed) deflate blocks, a snapshot now and then
+// doesn't need zlib for that.
+static int write_png(chip8_video_t* v, const chip8_t* c) {
+    unsigned int s = v->scale;
+    unsigned int width = 64 * v->words;
+    size_t stride = 1 + width / 8 * (size_t)s;  // filter byte + the scaled row
+    size_t raw_size = v->height * (size_t)s * stride;
+    size_t blocks = (raw_size + 65534) / 65535;
+    size_t idat_size = 2 + raw_size + 5 * blocks + 4;
+
+    unsigned char* raw = calloc(1, raw_size);
+    unsigned char* idat = malloc(idat_size);
+    if (raw == NULL || idat == NULL) {
+        free(raw);
+        free(idat);
+        return -1;
+    }
+
+    // scanlines, every pixel widened to s bits and every row repeated s times
+    for (unsigned int y = 0; y < v->height; y++) {
+        unsigned char* line = raw + (size_t)y * s * stride;
+        uint64_t row[2];
+        stream_row(v, c, y, row);
+        for (unsigned int x = 0; x < width * s; x++)
+            if ((row[x / s / 64] >> (63 - x / s % 64)) & 1)
+                line[1 + x / 8] |= (unsigned char)(0x80 >> (x % 8));
+        for (unsigned int r = 1; r < s; r++)
+            memcpy(line + r * stride, line, stride);
+    }
+
+    // zlib stream: header, stored blocks of at most 65535 bytes, adler32 of the data
+    unsigned char* p = idat;
+    *p++ = 0x78;
+    *p++ = 0x01;
+    for (size_t off = 0; off < raw_size; off += 65535) {
+        size_t n = raw_size - off < 65535 ? raw_size - off : 65535;
+        *p++ = off + n == raw_size;
+        *p++ = (unsigned char)n;
+        *p++ = (unsigned char)(n >> 8);
+        *p++ = (unsigned char)~n;
+        *p++ = (unsigned char)(~n >> 8);
+        memcpy(p, raw + off, n);
+        p += n;
+    }
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < raw_size; i++) {
+        a = (a + raw[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    put_be32(p, b << 16 | a);
+
+    unsigned char ihdr[13];
+    put_be32(ihdr, width * s);
+    put_be32(ihdr + 4, v->height * s);
+    ihdr[8] = 1;    // bit depth
+    ihdr[9] = 0;    // grayscale
+    ihdr[10] = 0;   // deflate
+    ihdr[11] = 0;   // adaptive filtering, every line uses none
+    ihdr[12] = 0;   // not interlaced
+
+    char name[4096];
+    snprintf(name, sizeof name, "%s%08llu.png", v->prefix, c->frame_count);
+
+    errno = 0;
+    int status = 0;
+    FILE* f = fopen(name, "wb");
+    if (f == NULL) {
+        status = io_error();
+    } else {
+        static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+        if (fwrite(signature, sizeof signature, 1, f) != 1)
+            status = io_error();
+        if (status == 0)
+            status = write_chunk(f, "IHDR", ihdr, sizeof ihdr);
+        if (status == 0)
+            status = write_chunk(f, "IDAT", idat, idat_size);
+        if (status == 0)
+            status = write_chunk(f, "IEND", NULL, 0);
+        if (fclose(f) != 0 && status == 0)
+            status = io_error();
+    }
+
+    free(raw);
+    free(idat);
+    return status;
+}
+
+int chip8_video_frame(chip8_video_t* v, const chip8_t* c) {
+    int status;
+
+    errno = 0;
+    switch (v->format) {
+        case CHIP8_VIDEO_RAW: status = write_raw(v, c); break;
+        case CHIP8_VIDEO_Y4M: status = write_y4m(v, c); break;
+        default: status = write_png(v, c); break;
+    }
+    if (status == 0)
+        v->frames++;
+    return status;
+}
+
+int chip8_video_close(chip8_video_t* v) {
+    int status = 0;
+
+    errno = 0;
+    if (v->out && fclose(v->out) != 0)
+        status = io_error();
+
+    free(v->buffer);
+    free(v->lut);
+    free(v->line);
+    v->out = NULL;
+    v->buffer = NULL;
+    v->lut = NULL;
+    v->line = NULL;
+    return status;
+}
@@ -0,0 +1,58 @@
+//
+// Headless video: writes the display straight out of chip8_t.display, no window involved. The video is 1 bit a
+// pixel, a pixel lit in any bit plane is white. A stream is either 64x32 or 128x64 from start to end: a 128x64
+// stream shows lo-res frames with every pixel doubled, a 64x32 one shows hi-res frames with every other pixel of
+// every other row. Three formats:
+//  - raw: every frame is the rows as 8 bytes per 64 pixels, leftmost pixel in the top bit, 256 bytes a 64x32
+//    frame. That is ffmpeg's monob: -f rawvideo -pix_fmt monob -s 64x32 -r 60 -i -
+//  - y4m: YUV4MPEG2 in mono (luma only), scaled up by a whole factor, which ffmpeg and most players take as is
+//  - png: 1-bit grayscale snapshots, one file per snapshot named prefix + frame_count + ".png"
+// Raw and y4m go through one big stdio buffer, to a file or to stdout.
+//
+
+#ifndef CHIP8_EMU_VIDEO_H
+#define CHIP8_EMU_VIDEO_H
+
+#include <stdio.h>
+
+#include "chip8.h"
+
+typedef enum chip8_video_format {
+    CHIP8_VIDEO_RAW,
+    CHIP8_VIDEO_Y4M,
+    CHIP8_VIDEO_PNG,
+} chip8_video_format_t;
+
+typedef struct chip8_video {
+    chip8_video_format_t format;
+    unsigned int scale;
+    // 64-bit words per row (1 or 2) and rows of the stream, before scaling
+    unsigned int words;
+    unsigned int height;
+
+    // raw / y4m
+    FILE* out;
+    char* buffer;
+    // png
+    const char* prefix;
+
+    // y4m: luma for each of the 256 possible bytes of a row (8 pixels), 8 * scale bytes each, and one scaled line
+    unsigned char* lut;
+    unsigned char* line;
+
+    unsigned long long frames;
+} chip8_video_t;
+
+// -1 if name isn't a format
+int chip8_video_format_from_name(const char* name);
+
+// path is the file to write ("-" for stdout), or the file name prefix for png. hires makes it a 128x64 stream.
+// 0 on success, errno on i/o errors, -1 if out of memory.
+int chip8_video_open(chip8_video_t* video, chip8_video_format_t format, const char* path, unsigned int scale,
+                     int hires);
+// Writes the machine's display as the next frame (the next snapshot for png). 0 or errno.
+int chip8_video_frame(chip8_video_t* video, const chip8_t* chip8);
+// Flushes and closes, 0 or errno
+int chip8_video_close(chip8_video_t* video);
+
+#endif //CHIP8_EMU_VIDEO_H